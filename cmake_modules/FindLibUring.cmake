@@ -0,0 +1,41 @@
+# Try pkg-config first
+find_package(PkgConfig)
+pkg_check_modules(PKGC_LIBURING QUIET liburing)
+
+if(PKGC_LIBURING_FOUND)
+  # Found lib using pkg-config.
+  if(CMAKE_DEBUG)
+    message(STATUS "\${PKGC_LIBURING_LIBRARIES} = ${PKGC_LIBURING_LIBRARIES}")
+    message(STATUS "\${PKGC_LIBURING_LIBRARY_DIRS} = ${PKGC_LIBURING_LIBRARY_DIRS}")
+    message(STATUS "\${PKGC_LIBURING_LDFLAGS} = ${PKGC_LIBURING_LDFLAGS}")
+    message(STATUS "\${PKGC_LIBURING_LDFLAGS_OTHER} = ${PKGC_LIBURING_LDFLAGS_OTHER}")
+    message(STATUS "\${PKGC_LIBURING_INCLUDE_DIRS} = ${PKGC_LIBURING_INCLUDE_DIRS}")
+    message(STATUS "\${PKGC_LIBURING_CFLAGS} = ${PKGC_LIBURING_CFLAGS}")
+    message(STATUS "\${PKGC_LIBURING_CFLAGS_OTHER} = ${PKGC_LIBURING_CFLAGS_OTHER}")
+  endif(CMAKE_DEBUG)
+
+  set(LIBURING_LIBRARIES ${PKGC_LIBURING_LIBRARIES})
+  set(LIBURING_INCLUDE_DIRS ${PKGC_LIBURING_INCLUDE_DIRS})
+  #set(LIBURING_DEFINITIONS ${PKGC_LIBURING_CFLAGS_OTHER})
+else(PKGC_LIBURING_FOUND)
+  # Didn't find lib using pkg-config. Try to find it manually
+  message(STATUS "Unable to find LibUring using pkg-config! Trying to find it manually")
+
+  find_path(LIBURING_INCLUDE_DIR liburing.h
+            PATH_SUFFIXES liburing)
+  find_library(LIBURING_LIBRARY NAMES uring liburing)
+
+  if(CMAKE_DEBUG)
+    message(STATUS "\${LIBURING_LIBRARY} = ${LIBURING_LIBRARY}")
+    message(STATUS "\${LIBURING_INCLUDE_DIR} = ${LIBURING_INCLUDE_DIR}")
+  endif(CMAKE_DEBUG)
+
+  set(LIBURING_LIBRARIES ${LIBURING_LIBRARY})
+  set(LIBURING_INCLUDE_DIRS ${LIBURING_INCLUDE_DIR})
+endif(PKGC_LIBURING_FOUND)
+
+include(FindPackageHandleStandardArgs)
+# Handle the QUIETLY and REQUIRED arguments and set <PREFIX>_FOUND to TRUE if
+# all listed variables are TRUE
+find_package_handle_standard_args(LibUring DEFAULT_MSG LIBURING_LIBRARIES)
+
@@ -0,0 +1,41 @@
+# Try pkg-config first
+find_package(PkgConfig)
+pkg_check_modules(PKGC_LIBZSTD QUIET libzstd)
+
+if(PKGC_LIBZSTD_FOUND)
+  # Found lib using pkg-config.
+  if(CMAKE_DEBUG)
+    message(STATUS "\${PKGC_LIBZSTD_LIBRARIES} = ${PKGC_LIBZSTD_LIBRARIES}")
+    message(STATUS "\${PKGC_LIBZSTD_LIBRARY_DIRS} = ${PKGC_LIBZSTD_LIBRARY_DIRS}")
+    message(STATUS "\${PKGC_LIBZSTD_LDFLAGS} = ${PKGC_LIBZSTD_LDFLAGS}")
+    message(STATUS "\${PKGC_LIBZSTD_LDFLAGS_OTHER} = ${PKGC_LIBZSTD_LDFLAGS_OTHER}")
+    message(STATUS "\${PKGC_LIBZSTD_INCLUDE_DIRS} = ${PKGC_LIBZSTD_INCLUDE_DIRS}")
+    message(STATUS "\${PKGC_LIBZSTD_CFLAGS} = ${PKGC_LIBZSTD_CFLAGS}")
+    message(STATUS "\${PKGC_LIBZSTD_CFLAGS_OTHER} = ${PKGC_LIBZSTD_CFLAGS_OTHER}")
+  endif(CMAKE_DEBUG)
+
+  set(LIBZSTD_LIBRARIES ${PKGC_LIBZSTD_LIBRARIES})
+  set(LIBZSTD_INCLUDE_DIRS ${PKGC_LIBZSTD_INCLUDE_DIRS})
+  #set(LIBZSTD_DEFINITIONS ${PKGC_LIBZSTD_CFLAGS_OTHER})
+else(PKGC_LIBZSTD_FOUND)
+  # Didn't find lib using pkg-config. Try to find it manually
+  message(STATUS "Unable to find LibZstd using pkg-config! Trying to find it manually")
+
+  find_path(LIBZSTD_INCLUDE_DIR zstd.h
+            PATH_SUFFIXES zstd)
+  find_library(LIBZSTD_LIBRARY NAMES zstd libzstd)
+
+  if(CMAKE_DEBUG)
+    message(STATUS "\${LIBZSTD_LIBRARY} = ${LIBZSTD_LIBRARY}")
+    message(STATUS "\${LIBZSTD_INCLUDE_DIR} = ${LIBZSTD_INCLUDE_DIR}")
+  endif(CMAKE_DEBUG)
+
+  set(LIBZSTD_LIBRARIES ${LIBZSTD_LIBRARY})
+  set(LIBZSTD_INCLUDE_DIRS ${LIBZSTD_INCLUDE_DIR})
+endif(PKGC_LIBZSTD_FOUND)
+
+include(FindPackageHandleStandardArgs)
+# Handle the QUIETLY and REQUIRED arguments and set <PREFIX>_FOUND to TRUE if
+# all listed variables are TRUE
+find_package_handle_standard_args(LibZstd DEFAULT_MSG LIBZSTD_LIBRARIES)
+
@@ -127,3 +127,64 @@ uint64_t StrToUint64(const char *p_value, int *p_ok) {
   return (uint64_t)num;
 }
 
+
+/*
+ * AddExtent
+ */
+int AddExtent(pts_LibXmountExtent *pp_extents,
+              uint64_t *p_count,
+              uint64_t offset,
+              uint64_t length,
+              uint8_t type)
+{
+  pts_LibXmountExtent p_extents=*pp_extents;
+  pts_LibXmountExtent p_last;
+
+  if(length==0) return 0;
+
+  // Merge with last extent if possible
+  if(*p_count!=0) {
+    p_last=&(p_extents[(*p_count)-1]);
+    if(p_last->type==type && p_last->offset+p_last->length==offset) {
+      p_last->length+=length;
+      return 0;
+    }
+  }
+
+  // Grow array in powers of two
+  if(((*p_count) & ((*p_count)-1))==0) {
+    p_extents=realloc(p_extents,
+                      ((*p_count)==0 ? 1 : (*p_count)*2)*
+                        sizeof(ts_LibXmountExtent));
+    if(p_extents==NULL) return ENOMEM;
+    *pp_extents=p_extents;
+  }
+
+  p_extents[*p_count].offset=offset;
+  p_extents[*p_count].length=length;
+  p_extents[*p_count].type=type;
+  (*p_count)++;
+
+  return 0;
+}
+
+/*
+ * AddStat
+ */
+int AddStat(pts_LibXmountStat *pp_stats,
+            uint32_t *p_count,
+            const char *p_key,
+            uint64_t value)
+{
+  pts_LibXmountStat p_stats;
+
+  p_stats=realloc(*pp_stats,((*p_count)+1)*sizeof(ts_LibXmountStat));
+  if(p_stats==NULL) return ENOMEM;
+  *pp_stats=p_stats;
+
+  p_stats[*p_count].p_key=p_key;
+  p_stats[*p_count].value=value;
+  (*p_count)++;
+
+  return 0;
+}
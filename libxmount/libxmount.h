@@ -54,6 +54,32 @@ typedef struct s_LibXmountOptions {
   uint8_t valid;
 } ts_LibXmountOptions, *pts_LibXmountOptions;
 
+//! Extent types
+typedef enum e_LibXmountExtentType {
+  //! Extent contains data that must be read
+  LibXmountExtentType_Data=0,
+  //! Extent is known to read as zeroes (hole, unallocated, zero block, ...)
+  LibXmountExtentType_Zero
+} te_LibXmountExtentType;
+
+//! Struct describing a range of an image
+typedef struct s_LibXmountExtent {
+  //! Offset of the extent
+  uint64_t offset;
+  //! Length of the extent
+  uint64_t length;
+  //! Extent type (One of te_LibXmountExtentType)
+  uint8_t type;
+} ts_LibXmountExtent, *pts_LibXmountExtent;
+
+//! Struct containing a statistics counter
+typedef struct s_LibXmountStat {
+  //! Counter name (constant string that stays valid as long as the handle)
+  const char *p_key;
+  //! Counter value
+  uint64_t value;
+} ts_LibXmountStat, *pts_LibXmountStat;
+
 //! Log messages
 /*!
  * \param p_msg_type "ERROR", "DEBUG", etc...
@@ -73,5 +99,40 @@ uint32_t StrToUint32(const char *p_value, int *p_ok);
 int64_t StrToInt64(const char *p_value, int *p_ok);
 uint64_t StrToUint64(const char *p_value, int *p_ok);
 
+//! Append a range to an extent array
+/*!
+ * Appends the given range to the array pointed to by pp_extents, growing it as
+ * needed. If the range directly follows the last extent in the array and is of
+ * the same type, the last extent is extended instead. The array must be freed
+ * using free().
+ *
+ * \param pp_extents Pointer to extent array (*pp_extents may be NULL)
+ * \param p_count Pointer to amount of extents in array
+ * \param offset Offset of range
+ * \param length Length of range
+ * \param type Type of range (One of te_LibXmountExtentType)
+ * \return 0 on success or ENOMEM
+ */
+int AddExtent(pts_LibXmountExtent *pp_extents,
+              uint64_t *p_count,
+              uint64_t offset,
+              uint64_t length,
+              uint8_t type);
+
+//! Append a counter to a statistics array
+/*!
+ * The array must be freed using free().
+ *
+ * \param pp_stats Pointer to statistics array (*pp_stats may be NULL)
+ * \param p_count Pointer to amount of counters in array
+ * \param p_key Counter name (must be a constant string)
+ * \param value Counter value
+ * \return 0 on success or ENOMEM
+ */
+int AddStat(pts_LibXmountStat *pp_stats,
+            uint32_t *p_count,
+            const char *p_key,
+            uint64_t value);
+
 #endif // LIBXMOUNT_H
 
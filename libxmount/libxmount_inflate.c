@@ -0,0 +1,362 @@
+/*******************************************************************************
+* xmount Copyright (c) 2024 by SITS Sarl                                       *
+*                                                                              *
+* Author(s):                                                                   *
+*   Gillen Daniel <development@sits.lu>                                        *
+*                                                                              *
+* This program is free software: you can redistribute it and/or modify it      *
+* under the terms of the GNU General Public License as published by the Free   *
+* Software Foundation, either version 3 of the License, or (at your option)    *
+* any later version.                                                           *
+*                                                                              *
+* This program is distributed in the hope that it will be useful, but WITHOUT  *
+* ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or        *
+* FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for     *
+* more details.                                                                *
+*                                                                              *
+* You should have received a copy of the GNU General Public License along with *
+* this program. If not, see <http://www.gnu.org/licenses/>.                    *
+*******************************************************************************/
+
+
+#include <config.h>
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <zlib.h>
+#ifdef HAVE_LIBDEFLATE
+  #include <libdeflate.h>
+#endif
+
+// Without libdeflate, Adler-32 is computed using SSSE3 on x86 if the CPU
+// supports it (checked at runtime)
+#if !defined(HAVE_LIBDEFLATE) && defined(__GNUC__) && \
+    (defined(__x86_64__) || defined(__i386__))
+  #define XMOUNT_ADLER32_SSSE3
+  #include <tmmintrin.h>
+#endif
+
+#define XMOUNT_ADLER32_BASE 65521
+// Largest n such that 255n(n+1)/2 + (n+1)(BASE-1) fits into 32 bits
+#define XMOUNT_ADLER32_NMAX 5552
+
+#include "libxmount_inflate.h"
+
+/*
+ * XmountInflateInit
+ */
+void XmountInflateInit(pts_XmountInflate p_inflate) {
+  memset(p_inflate,0,sizeof(ts_XmountInflate));
+}
+
+/*
+ * XmountInflateDeInit
+ */
+void XmountInflateDeInit(pts_XmountInflate p_inflate) {
+#ifdef HAVE_LIBDEFLATE
+  if(p_inflate->p_decompressor!=NULL) {
+    libdeflate_free_decompressor(
+      (struct libdeflate_decompressor*)p_inflate->p_decompressor);
+  }
+#endif
+  if(p_inflate->p_zstream!=NULL) {
+    inflateEnd((z_stream*)p_inflate->p_zstream);
+    free(p_inflate->p_zstream);
+  }
+  memset(p_inflate,0,sizeof(ts_XmountInflate));
+}
+
+/*
+ * XmountInflateZlib
+ */
+static int XmountInflateZlib(pts_XmountInflate p_inflate,
+                             te_XmountInflateFormat format,
+                             void *p_dst,
+                             uint64_t *p_dst_len,
+                             const void *p_src,
+                             uint64_t src_len)
+{
+  z_stream *p_zstream;
+  int window_bits;
+  int ret;
+
+  // Negative window bits select raw deflate, 15 accepts all window sizes
+  window_bits=(format==XmountInflateFormat_Raw) ? -15 : 15;
+
+  if(src_len>UINT_MAX || *p_dst_len>UINT_MAX) return Z_BUF_ERROR;
+
+  if(p_inflate->p_zstream==NULL) {
+    p_zstream=(z_stream*)calloc(1,sizeof(z_stream));
+    if(p_zstream==NULL) return Z_MEM_ERROR;
+    ret=inflateInit2(p_zstream,window_bits);
+    if(ret!=Z_OK) {
+      free(p_zstream);
+      return ret;
+    }
+    p_inflate->p_zstream=p_zstream;
+  } else {
+    p_zstream=(z_stream*)p_inflate->p_zstream;
+    ret=inflateReset2(p_zstream,window_bits);
+    if(ret!=Z_OK) return ret;
+  }
+
+  p_zstream->next_in=(Bytef*)p_src;
+  p_zstream->avail_in=(uInt)src_len;
+  p_zstream->next_out=(Bytef*)p_dst;
+  p_zstream->avail_out=(uInt)*p_dst_len;
+
+  ret=inflate(p_zstream,Z_FINISH);
+  *p_dst_len=p_zstream->total_out;
+
+  // Map return values the same way zlib's uncompress does
+  switch(ret) {
+    case Z_STREAM_END:
+      return Z_OK;
+    case Z_NEED_DICT:
+      return Z_DATA_ERROR;
+    case Z_BUF_ERROR:
+      return (p_zstream->avail_out==0) ? Z_BUF_ERROR : Z_DATA_ERROR;
+    default:
+      return ret;
+  }
+}
+
+/*
+ * XmountInflateDecode
+ */
+static int XmountInflateDecode(pts_XmountInflate p_inflate,
+                               te_XmountInflateFormat format,
+                               void *p_dst,
+                               uint64_t *p_dst_len,
+                               const void *p_src,
+                               uint64_t src_len)
+{
+#ifdef HAVE_LIBDEFLATE
+  struct libdeflate_decompressor *p_decompressor;
+  enum libdeflate_result ret;
+  size_t in_len;
+  size_t out_len;
+
+  if(p_inflate->p_decompressor==NULL) {
+    p_inflate->p_decompressor=(void*)libdeflate_alloc_decompressor();
+  }
+  p_decompressor=(struct libdeflate_decompressor*)p_inflate->p_decompressor;
+  if(p_decompressor!=NULL) {
+    // The _ex variants accept trailing data after the end of the stream, as
+    // zlib does
+    if(format==XmountInflateFormat_Raw) {
+      ret=libdeflate_deflate_decompress_ex(p_decompressor,
+                                           p_src,
+                                           src_len,
+                                           p_dst,
+                                           *p_dst_len,
+                                           &in_len,
+                                           &out_len);
+    } else {
+      ret=libdeflate_zlib_decompress_ex(p_decompressor,
+                                        p_src,
+                                        src_len,
+                                        p_dst,
+                                        *p_dst_len,
+                                        &in_len,
+                                        &out_len);
+    }
+    if(ret==LIBDEFLATE_SUCCESS) {
+      *p_dst_len=out_len;
+      return Z_OK;
+    }
+    // Let zlib have a go at it
+  }
+#endif
+  return XmountInflateZlib(p_inflate,format,p_dst,p_dst_len,p_src,src_len);
+}
+
+/*
+ * XmountInflateUnchecked
+ */
+static int XmountInflateUnchecked(pts_XmountInflate p_inflate,
+                                  void *p_dst,
+                                  uint64_t *p_dst_len,
+                                  const uint8_t *p_src,
+                                  uint64_t src_len)
+{
+  // Check the 2 byte zlib header (deflate, valid check bits, no preset
+  // dictionary) and decode the deflate data behind it. The Adler-32 trailer
+  // is never looked at.
+  if(src_len<2 ||
+     (p_src[0] & 0x0f)!=Z_DEFLATED ||
+     (p_src[0] >> 4)>7 ||
+     ((p_src[0] << 8) | p_src[1])%31!=0 ||
+     (p_src[1] & 0x20)!=0)
+  {
+    return Z_DATA_ERROR;
+  }
+  return XmountInflateDecode(p_inflate,
+                             XmountInflateFormat_Raw,
+                             p_dst,
+                             p_dst_len,
+                             p_src+2,
+                             src_len-2);
+}
+
+/*
+ * XmountInflate
+ */
+int XmountInflate(pts_XmountInflate p_inflate,
+                  te_XmountInflateFormat format,
+                  void *p_dst,
+                  uint64_t *p_dst_len,
+                  const void *p_src,
+                  uint64_t src_len)
+{
+  if(format==XmountInflateFormat_ZlibUnchecked) {
+    return XmountInflateUnchecked(p_inflate,
+                                  p_dst,
+                                  p_dst_len,
+                                  (const uint8_t*)p_src,
+                                  src_len);
+  }
+  return XmountInflateDecode(p_inflate,format,p_dst,p_dst_len,p_src,src_len);
+}
+
+/*
+ * XmountInflateBackend
+ */
+const char* XmountInflateBackend() {
+#ifdef HAVE_LIBDEFLATE
+  return "libdeflate";
+#else
+  return "zlib";
+#endif
+}
+
+
+#ifdef XMOUNT_ADLER32_SSSE3
+/*
+ * XmountAdler32Ssse3
+ */
+__attribute__((target("ssse3")))
+static uint32_t XmountAdler32Ssse3(uint32_t adler,
+                                   const uint8_t *p_buf,
+                                   uint64_t len)
+{
+  uint32_t s1=adler & 0xffff;
+  uint32_t s2=adler >> 16;
+  uint64_t blocks=len/32;
+  const __m128i taps1=_mm_setr_epi8(32,31,30,29,28,27,26,25,
+                                    24,23,22,21,20,19,18,17);
+  const __m128i taps2=_mm_setr_epi8(16,15,14,13,12,11,10,9,
+                                    8,7,6,5,4,3,2,1);
+  const __m128i zero=_mm_setzero_si128();
+  const __m128i ones=_mm_set1_epi16(1);
+
+  // Process blocks of 32 bytes. Each byte is added to s1 (sum of absolute
+  // differences against zero) and, weighted by its distance to the end of the
+  // block, to s2 (multiply-add). s1 of the previous blocks contributes 32
+  // times to s2 per block, this is accumulated in v_ps and added at the end.
+  len-=blocks*32;
+  while(blocks>0) {
+    uint32_t n=XMOUNT_ADLER32_NMAX/32;
+    __m128i v_s1;
+    __m128i v_s2;
+    __m128i v_ps;
+
+    if(n>blocks) n=(uint32_t)blocks;
+    blocks-=n;
+
+    v_ps=_mm_set_epi32(0,0,0,(int)(s1*n));
+    v_s2=_mm_set_epi32(0,0,0,(int)s2);
+    v_s1=_mm_setzero_si128();
+    do {
+      const __m128i bytes1=_mm_loadu_si128((const __m128i*)p_buf);
+      const __m128i bytes2=_mm_loadu_si128((const __m128i*)(p_buf+16));
+
+      v_ps=_mm_add_epi32(v_ps,v_s1);
+      v_s1=_mm_add_epi32(v_s1,_mm_sad_epu8(bytes1,zero));
+      v_s2=_mm_add_epi32(v_s2,
+                         _mm_madd_epi16(_mm_maddubs_epi16(bytes1,taps1),ones));
+      v_s1=_mm_add_epi32(v_s1,_mm_sad_epu8(bytes2,zero));
+      v_s2=_mm_add_epi32(v_s2,
+                         _mm_madd_epi16(_mm_maddubs_epi16(bytes2,taps2),ones));
+      p_buf+=32;
+    } while(--n);
+    v_s2=_mm_add_epi32(v_s2,_mm_slli_epi32(v_ps,5));
+
+    // Horizontal sums
+    v_s1=_mm_add_epi32(v_s1,_mm_shuffle_epi32(v_s1,_MM_SHUFFLE(2,3,0,1)));
+    v_s1=_mm_add_epi32(v_s1,_mm_shuffle_epi32(v_s1,_MM_SHUFFLE(1,0,3,2)));
+    s1+=(uint32_t)_mm_cvtsi128_si32(v_s1);
+    v_s2=_mm_add_epi32(v_s2,_mm_shuffle_epi32(v_s2,_MM_SHUFFLE(2,3,0,1)));
+    v_s2=_mm_add_epi32(v_s2,_mm_shuffle_epi32(v_s2,_MM_SHUFFLE(1,0,3,2)));
+    s2=(uint32_t)_mm_cvtsi128_si32(v_s2);
+
+    s1%=XMOUNT_ADLER32_BASE;
+    s2%=XMOUNT_ADLER32_BASE;
+  }
+
+  // Remaining bytes (less than 32)
+  while(len>0) {
+    s1+=*p_buf++;
+    s2+=s1;
+    len--;
+  }
+  s1%=XMOUNT_ADLER32_BASE;
+  s2%=XMOUNT_ADLER32_BASE;
+
+  return (s2 << 16) | s1;
+}
+
+/*
+ * XmountAdler32HaveSsse3
+ */
+static int XmountAdler32HaveSsse3() {
+  static int have_ssse3=-1;
+
+  // Benign race: all threads compute the same value
+  if(have_ssse3<0) {
+    __builtin_cpu_init();
+    have_ssse3=__builtin_cpu_supports("ssse3") ? 1 : 0;
+  }
+  return have_ssse3;
+}
+#endif
+
+/*
+ * XmountAdler32
+ */
+uint32_t XmountAdler32(uint32_t adler, const void *p_buf, uint64_t len) {
+  const uint8_t *p_data=(const uint8_t*)p_buf;
+  uint64_t block_len;
+
+#ifdef XMOUNT_ADLER32_SSSE3
+  if(XmountAdler32HaveSsse3()) return XmountAdler32Ssse3(adler,p_data,len);
+#endif
+
+  // libdeflate's and zlib's length parameters may be smaller than 64 bits
+  do {
+    block_len=(len>UINT_MAX) ? UINT_MAX : len;
+#ifdef HAVE_LIBDEFLATE
+    adler=libdeflate_adler32(adler,p_data,(size_t)block_len);
+#else
+    adler=(uint32_t)adler32(adler,(const Bytef*)p_data,(uInt)block_len);
+#endif
+    p_data+=block_len;
+    len-=block_len;
+  } while(len>0);
+
+  return adler;
+}
+
+/*
+ * XmountAdler32Backend
+ */
+const char* XmountAdler32Backend() {
+#if defined(HAVE_LIBDEFLATE)
+  return "libdeflate";
+#elif defined(XMOUNT_ADLER32_SSSE3)
+  return XmountAdler32HaveSsse3() ? "ssse3" : "zlib";
+#else
+  return "zlib";
+#endif
+}
@@ -0,0 +1,87 @@
+/*******************************************************************************
+* xmount Copyright (c) 2024 by SITS Sarl                                       *
+*                                                                              *
+* Author(s):                                                                   *
+*   Gillen Daniel <development@sits.lu>                                        *
+*                                                                              *
+* This program is free software: you can redistribute it and/or modify it      *
+* under the terms of the GNU General Public License as published by the Free   *
+* Software Foundation, either version 3 of the License, or (at your option)    *
+* any later version.                                                           *
+*                                                                              *
+* This program is distributed in the hope that it will be useful, but WITHOUT  *
+* ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or        *
+* FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for     *
+* more details.                                                                *
+*                                                                              *
+* You should have received a copy of the GNU General Public License along with *
+* this program. If not, see <http://www.gnu.org/licenses/>.                    *
+*******************************************************************************/
+
+
+#ifndef LIBXMOUNT_INFLATE_H
+#define LIBXMOUNT_INFLATE_H
+
+#include <stdint.h>
+
+/*
+ * Common inflate (deflate decompression) backend for the input libraries.
+ *
+ * If xmount was built with libdeflate (HAVE_LIBDEFLATE), it is used as the
+ * primary decoder. zlib always stays available as fallback: it is used when
+ * libdeflate is missing, when its decompressor can't be allocated and when
+ * it rejects a stream (zlib is more tolerant and returns exact error codes).
+ *
+ * zlib-ng in zlib compatible mode is a drop-in replacement for zlib and needs
+ * no special support here.
+ */
+
+//! Stream formats understood by XmountInflate
+typedef enum e_XmountInflateFormat {
+  //! zlib stream (RFC 1950, header and Adler-32 trailer), as used by EWF and AFF
+  XmountInflateFormat_Zlib=0,
+  //! Raw deflate stream (RFC 1951), as used by QCOW
+  XmountInflateFormat_Raw,
+  //! zlib stream whose Adler-32 trailer is not verified
+  XmountInflateFormat_ZlibUnchecked
+} te_XmountInflateFormat;
+
+//! Decompressor state
+/*!
+ * The state is reused between calls in order to avoid allocations per
+ * compressed block. It must not be used by several threads at the same time,
+ * threads decompressing in parallel need their own state each.
+ * A zeroed structure is a valid, initialised state.
+ */
+typedef struct s_XmountInflate {
+  //! libdeflate decompressor (allocated on first use)
+  void *p_decompressor;
+  //! zlib stream (allocated on first use)
+  void *p_zstream;
+} ts_XmountInflate, *pts_XmountInflate;
+
+//! Initialise decompressor state
+void XmountInflateInit(pts_XmountInflate p_inflate);
+
+//! Free everything allocated by XmountInflate
+void XmountInflateDeInit(pts_XmountInflate p_inflate);
+
+//! Decompress a complete stream
+int XmountInflate(pts_XmountInflate p_inflate,
+                  te_XmountInflateFormat format,
+                  void *p_dst,
+                  uint64_t *p_dst_len,
+                  const void *p_src,
+                  uint64_t src_len);
+
+//! Get name of the primary inflate backend
+const char* XmountInflateBackend();
+
+//! Update Adler-32 checksum (as zlib's adler32, but vectorised if possible)
+uint32_t XmountAdler32(uint32_t adler, const void *p_buf, uint64_t len);
+
+//! Get name of the Adler-32 implementation used by XmountAdler32
+const char* XmountAdler32Backend();
+
+#endif // LIBXMOUNT_INFLATE_H
+
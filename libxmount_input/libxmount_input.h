@@ -225,6 +225,64 @@ typedef struct s_LibXmountInputFunctions {
 
   //! Library initialization flag
   uint8_t is_initialized;
+
+  //! Function to get the allocation map of a range of the input image
+  /*!
+   * Describes the range of count bytes starting at offset as a sorted,
+   * gap-free array of extents. Extents of type LibXmountExtentType_Zero are
+   * known to read as zeroes and can be skipped by the caller without calling
+   * Read(). The returned array will be freed by the caller using FreeBuffer().
+   *
+   * This function is optional and may be set to NULL if the lib has no way of
+   * knowing which parts of the image are unallocated. In this case, the whole
+   * image is considered to contain data.
+   *
+   * \param p_handle Handle
+   * \param offset Position of the range to describe
+   * \param count Length of the range to describe
+   * \param pp_extents Pointer to store extent array to
+   * \param p_extents_count Pointer to store amount of extents to
+   * \return 0 on success or error code
+   */
+  int (*GetExtents)(void *p_handle,
+                    uint64_t offset,
+                    uint64_t count,
+                    pts_LibXmountExtent *pp_extents,
+                    uint64_t *p_extents_count);
+
+  //! Function to get statistics counters
+  /*!
+   * Returns an array of named counters (cache hits, bytes read from disk,
+   * ...). Unlike GetInfofileContent, this function may be called at any time
+   * while the image is open. The returned array will be freed by the caller
+   * using FreeBuffer(). The counter names are not freed and must stay valid as
+   * long as the handle.
+   *
+   * This function is optional and may be set to NULL if the lib doesn't keep
+   * any statistics.
+   *
+   * \param p_handle Handle
+   * \param pp_stats Pointer to store counter array to
+   * \param p_stats_count Pointer to store amount of counters to
+   * \return 0 on success or error code
+   */
+  int (*GetStats)(void *p_handle,
+                  pts_LibXmountStat *pp_stats,
+                  uint32_t *p_stats_count);
+
+  //! Function to check whether Read may be called concurrently
+  /*!
+   * If this function returns 1, xmount may call Read, GetExtents and GetStats
+   * on the same opened handle from multiple threads at the same time. The lib
+   * is then responsible for protecting any state shared between these calls.
+   *
+   * This function is optional and may be set to NULL, in which case all calls
+   * are serialized.
+   *
+   * \param p_handle Handle
+   * \return 1 if Read is reentrant, 0 otherwise
+   */
+  uint8_t (*IsReentrant)(void *p_handle);
 } ts_LibXmountInputFunctions, *pts_LibXmountInputFunctions;
 
 //! Get library API version
@@ -254,7 +312,8 @@ typedef const char* (*t_LibXmount_Input_GetSupportedFormats)();
 //! Get the lib's s_LibXmountInputFunctions structure
 /*!
  * This function should set the members of the given s_LibXmountInputFunctions
- * structure to the internal lib functions. All members have to be set.
+ * structure to the internal lib functions. All members except GetExtents,
+ * IsReentrant and GetStats have to be set.
  *
  * \param p_functions s_LibXmountInputFunctions structure to fill
  */
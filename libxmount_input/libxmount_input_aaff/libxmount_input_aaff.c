@@ -41,8 +41,12 @@
 #include <zlib.h>
 #include <time.h>
 #include <errno.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/stat.h>
 
 #include "../libxmount_input.h"
+#include "../../libxmount/libxmount_inflate.h"
 
 #include "libxmount_input_aaff.h"
 
@@ -51,6 +55,10 @@ static const char* AaffGetErrorMessage (int ErrNum);
 
 #define AAFF_OPTION_MAXPAGEARRMEM   "aaffmaxmem"
 #define AAFF_OPTION_LOG             "aafflog"
+#define AAFF_OPTION_INDEX           "aaffindex"
+#define AAFF_OPTION_PAGECACHE       "aaffpagecache"
+#define AAFF_OPTION_READAHEAD       "aaffreadahead"
+#define AAFF_OPTION_THREADS         "aaffthreads"
 
 #define SAFE_FREE(pBuf) \
 {                       \
@@ -168,6 +176,16 @@ int LogEntry (const char *pLogFileName, uint8_t LogStdout, const char *pFileName
    }                                                                            \
 }
 
+#define CHK_LEAVE(ChkVal)                 \
+{                                         \
+   int ChkValRc;                          \
+   if ((ChkValRc=(ChkVal)) != AAFF_OK)    \
+   {                                      \
+      rc = ChkValRc;                      \
+      goto Leave;                         \
+   }                                      \
+}
+
 #define LOG(...) \
    LogEntry (pAaff->pLogFilename, pAaff->LogStdout, __FILE__, __FUNCTION__, __LINE__, __VA_ARGS__);
 
@@ -280,141 +298,623 @@ static int AaffReadSegment (t_pAaff pAaff, char **ppName, uint32_t *pArg, char *
    return AAFF_OK;
 }
 
-static int AaffReadSegmentPage (t_pAaff pAaff, uint64_t SearchPage, uint64_t *pFoundPage, char **ppData, uint32_t *pDataLen)
+// AaffScanPages builds the page index. Starting at the first page segment, it only reads the
+// header and the name of each segment and seeks over the data, so the AFF file is walked through
+// with one small read per segment. Segments other than pages (hashes, bad sector lists, ...) are
+// skipped. Pages not found in the file keep an entry with Offset 0 and produce an error when read.
+
+static int AaffScanPages (t_pAaff pAaff, uint64_t Seek)
 {
    t_AffSegmentHeader Header;
-   t_AffSegmentFooter Footer;
-   int                rc = AAFF_OK;
+   t_pAaffPageIndex   pEntry;
+   uint64_t           Page;
+   uint64_t           SegmentLen;
+   const uint64_t     HeaderLen = offsetof(t_AffSegmentHeader, Name);
+
+   pAaff->PageIndexEntries = 0;
+   pAaff->ZeroPages        = 0;
+   while (Seek + HeaderLen <= pAaff->FileSize)
+   {
+      CHK (AaffSetCurrentSeekPos (pAaff, Seek, SEEK_SET))
+      CHK (AaffReadFile (pAaff, &Header, HeaderLen))
+      if (strcmp (&Header.Magic[0], AFF_SEGMENT_HEADER_MAGIC) != 0)
+         return AAFF_INVALID_HEADER;
+      Header.NameLen  = ntohl (Header.NameLen );
+      Header.DataLen  = ntohl (Header.DataLen );
+      Header.Argument = ntohl (Header.Argument);
+      SegmentLen = HeaderLen + Header.NameLen + Header.DataLen + sizeof(t_AffSegmentFooter);
+      if (Seek + SegmentLen > pAaff->FileSize)
+      {
+         LOG ("Segment at offset %" PRIu64 " is truncated", Seek);
+         break;
+      }
+      CHK (AaffRealloc ((void**)&pAaff->pNameBuff, &pAaff->NameBuffLen, Header.NameLen+1))
+      CHK (AaffReadFile (pAaff, pAaff->pNameBuff, Header.NameLen))
+      pAaff->pNameBuff[Header.NameLen] = '\0';
 
-   *ppData   = NULL;
-   *pDataLen = 0;
+      if ((strncmp (pAaff->pNameBuff, AFF_SEGNAME_PAGE, strlen(AFF_SEGNAME_PAGE)) == 0) &&
+          (AaffPageNumberFromSegmentName (pAaff->pNameBuff, &Page) == AAFF_OK) &&
+          (Page < pAaff->TotalPages))
+      {
+         pEntry = &pAaff->pPageIndexArr[Page];
+         if (pEntry->Offset == 0)
+            pAaff->PageIndexEntries++;
+         else if (pEntry->Flags == AFF_PAGEFLAGS_COMPRESSED_ZERO)
+            pAaff->ZeroPages--;
+         if (Header.Argument == AFF_PAGEFLAGS_COMPRESSED_ZERO)
+            pAaff->ZeroPages++;
+         pEntry->Offset  = Seek + HeaderLen + Header.NameLen;
+         pEntry->DataLen = Header.DataLen;
+         pEntry->Flags   = Header.Argument;
+      }
+      Seek += SegmentLen;
+   }
+   LOG ("%" PRIu64 " of %" PRIu64 " pages found, %" PRIu64 " zero pages", pAaff->PageIndexEntries, pAaff->TotalPages, pAaff->ZeroPages);
 
-   CHK (AaffReadFile (pAaff, &Header, offsetof(t_AffSegmentHeader, Name)))
-   if (strcmp (&Header.Magic[0], AFF_SEGMENT_HEADER_MAGIC) != 0)
-      return AAFF_INVALID_HEADER;
-   Header.NameLen  = ntohl (Header.NameLen );
-   Header.DataLen  = ntohl (Header.DataLen );
-   Header.Argument = ntohl (Header.Argument);
-   CHK (AaffRealloc ((void**)&pAaff->pNameBuff, &pAaff->NameBuffLen, Header.NameLen+1))
-   CHK (AaffReadFile (pAaff, pAaff->pNameBuff, Header.NameLen))
-   pAaff->pNameBuff[Header.NameLen] = '\0';
+   return AAFF_OK;
+}
+
+// AaffIndexLoad reads the page index from the index file. It fails if the index file doesn't
+// belong to the AFF file or if the AFF file has changed since the index file was written; AaffOpen
+// then falls back to scanning the AFF file.
+
+static int AaffIndexLoad (t_pAaff pAaff, const struct stat *pStat)
+{
+   t_AaffIndexHeader Hdr;
+   FILE            *pFile = NULL;
+   uint64_t          ArrBytes = pAaff->TotalPages * sizeof(t_AaffPageIndex);
+   int               rc;
+
+   pFile = fopen (pAaff->pIndexFilename, "r");
+   if (pFile == NULL)
+      CHK_LEAVE (AAFF_FILE_OPEN_FAILED)
+   if (fread (&Hdr, sizeof(Hdr), 1, pFile) != 1)
+      CHK_LEAVE (AAFF_INDEX_INVALID)
+   if ((Hdr.Magic      != AAFF_INDEX_MAGIC  ) ||
+       (Hdr.Version    != AAFF_INDEX_VERSION) ||
+       (Hdr.TotalPages != pAaff->TotalPages ) ||
+       (Hdr.PageSize   != pAaff->PageSize   ))
+      CHK_LEAVE (AAFF_INDEX_INVALID)
+   if ((Hdr.FileSize != (uint64_t) pStat->st_size ) ||
+       (Hdr.MTime    != (int64_t)  pStat->st_mtime))
+      CHK_LEAVE (AAFF_INDEX_FILE_CHANGED)
+   if (fread (pAaff->pPageIndexArr, ArrBytes, 1, pFile) != 1)
+      CHK_LEAVE (AAFF_INDEX_INVALID)
+   if (XmountAdler32 (1, pAaff->pPageIndexArr, ArrBytes) != Hdr.Checksum)
+      CHK_LEAVE (AAFF_INDEX_INVALID)
+
+   pAaff->PageIndexEntries = 0;
+   pAaff->ZeroPages        = 0;
+   for (uint64_t i=0; i<pAaff->TotalPages; i++)
+   {
+      if (pAaff->pPageIndexArr[i].Offset == 0)
+         continue;
+      if (pAaff->pPageIndexArr[i].Offset + pAaff->pPageIndexArr[i].DataLen > pAaff->FileSize)
+         CHK_LEAVE (AAFF_INDEX_INVALID)
+      pAaff->PageIndexEntries++;
+      if (pAaff->pPageIndexArr[i].Flags == AFF_PAGEFLAGS_COMPRESSED_ZERO)
+         pAaff->ZeroPages++;
+   }
+   LOG ("Page index %s loaded", pAaff->pIndexFilename);
+   rc = AAFF_OK;
 
-   if (strncmp (pAaff->pNameBuff, AFF_SEGNAME_PAGE, strlen(AFF_SEGNAME_PAGE)) != 0)
-      return AAFF_WRONG_SEGMENT;
+Leave:
+   if (pFile)
+      (void) fclose (pFile);
+   if (rc != AAFF_OK)
+      memset (pAaff->pPageIndexArr, 0, ArrBytes);
+   return rc;
+}
 
-   CHK (AaffPageNumberFromSegmentName (pAaff->pNameBuff, pFoundPage))
-   if (*pFoundPage == SearchPage)
+static int AaffIndexWrite (t_pAaff pAaff, const struct stat *pStat)
+{
+   t_AaffIndexHeader Hdr;
+   FILE            *pFile    = NULL;
+   char            *pTmpName = NULL;
+   uint64_t          ArrBytes = pAaff->TotalPages * sizeof(t_AaffPageIndex);
+   int               rc;
+
+   memset (&Hdr, 0, sizeof (Hdr));
+   Hdr.Magic      = AAFF_INDEX_MAGIC;
+   Hdr.Version    = AAFF_INDEX_VERSION;
+   Hdr.Checksum   = XmountAdler32 (1, pAaff->pPageIndexArr, ArrBytes);
+   Hdr.FileSize   = pStat->st_size;
+   Hdr.MTime      = pStat->st_mtime;
+   Hdr.TotalPages = pAaff->TotalPages;
+   Hdr.PageSize   = pAaff->PageSize;
+
+   if (asprintf (&pTmpName, "%s.tmp_%d", pAaff->pIndexFilename, getpid()) < 0)
    {
-      unsigned int Len;
-      uLongf       ZLen;
-      int          zrc;
+      pTmpName = NULL;
+      CHK_LEAVE (AAFF_MEMALLOC_FAILED)
+   }
+   pFile = fopen (pTmpName, "w");
+   if (pFile == NULL)
+      CHK_LEAVE (AAFF_INDEX_WRITE_FAILED)
+   if ((fwrite (&Hdr, sizeof(Hdr), 1, pFile) != 1) ||
+       (fwrite (pAaff->pPageIndexArr, ArrBytes, 1, pFile) != 1))
+      CHK_LEAVE (AAFF_INDEX_WRITE_FAILED)
+   rc = fclose (pFile);
+   pFile = NULL;
+   if (rc != 0)
+      CHK_LEAVE (AAFF_INDEX_WRITE_FAILED)
+   if (rename (pTmpName, pAaff->pIndexFilename) != 0)
+      CHK_LEAVE (AAFF_INDEX_WRITE_FAILED)
+   LOG ("Page index %s written", pAaff->pIndexFilename);
+   rc = AAFF_OK;
 
-      switch (Header.Argument)
+Leave:
+   if (pFile)
+   {
+      (void) fclose (pFile);
+      (void) unlink (pTmpName);
+   }
+   SAFE_FREE (pTmpName);
+
+   return rc;
+}
+
+// The length of a page's data. All pages are PageSize bytes long, except possibly the last one.
+
+static inline uint32_t AaffPageLen (t_pAaff pAaff, uint64_t Page)
+{
+   return (uint32_t) GETMIN ((uint64_t) pAaff->PageSize, pAaff->ImageSize - Page * pAaff->PageSize);
+}
+
+// Pages flagged AFF_PAGEFLAGS_COMPRESSED_ZERO only contain zeroes. Their data in the AFF file
+// merely is the page length, so they can be served without any file I/O.
+
+static inline int AaffIsZeroPage (t_pAaff pAaff, uint64_t Page)
+{
+   return (pAaff->pPageIndexArr[Page].Offset != 0) &&
+          (pAaff->pPageIndexArr[Page].Flags  == AFF_PAGEFLAGS_COMPRESSED_ZERO);
+}
+
+static int AaffReadFilePos (t_pAaff pAaff, void *pData, uint32_t DataLen, uint64_t Pos)
+{
+   char    *pDst = (char *) pData;
+   ssize_t  Read;
+
+   while (DataLen)
+   {
+      Read = pread (pAaff->Fd, pDst, DataLen, (off_t) Pos);
+      if ((Read < 0) && (errno == EINTR))
+         continue;
+      if (Read <= 0)
+         return AAFF_CANNOT_READ_DATA;
+      pDst    += Read;
+      Pos     += Read;
+      DataLen -= Read;
+   }
+   return AAFF_OK;
+}
+
+// AaffDecodePage reads the given page and decompresses it into pDst, which must be PageSize bytes
+// long. Thanks to the page index, this is a single read. The function is called by the reading
+// thread as well as by the workers; each caller passes its own decompressor state and buffer
+// for the compressed data.
+
+static int AaffDecodePage (t_pAaff pAaff, uint64_t Page, char *pDst, uint32_t *pDstLen, ts_XmountInflate *pInflate, char **ppDataBuff, uint32_t *pDataBuffLen)
+{
+   t_pAaffPageIndex pEntry = &pAaff->pPageIndexArr[Page];
+   unsigned int     Len;
+   uint64_t         ZLen;
+   int              zrc;
+
+   if (pEntry->Offset == 0)
+      return AAFF_PAGE_NOT_FOUND;
+
+   switch (pEntry->Flags)
+   {
+      case AFF_PAGEFLAGS_UNCOMPRESSED:
+         if (pEntry->DataLen > pAaff->PageSize)
+            return AAFF_PAGE_TOO_LARGE;
+         CHK (AaffReadFilePos (pAaff, pDst, pEntry->DataLen, pEntry->Offset))
+         *pDstLen = pEntry->DataLen;
+         break;
+      case AFF_PAGEFLAGS_COMPRESSED_ZERO:  // Normally served by AaffRead directly
+         Len = AaffPageLen (pAaff, Page);
+         memset (pDst, 0, Len);
+         *pDstLen = Len;
+         break;
+      case AFF_PAGEFLAGS_COMPRESSED_ZLIB:
+         CHK (AaffRealloc ((void**)ppDataBuff, pDataBuffLen, pEntry->DataLen));
+         CHK (AaffReadFilePos (pAaff, *ppDataBuff, pEntry->DataLen, pEntry->Offset))   // read into data buffer
+         ZLen = pAaff->PageSize;                                                        // size of pDst
+         zrc = XmountInflate (pInflate, XmountInflateFormat_Zlib, pDst, &ZLen, *ppDataBuff, pEntry->DataLen);    // uncompress into pDst
+         if (zrc != Z_OK)
+            return AAFF_UNCOMPRESS_FAILED;
+         *pDstLen = ZLen;
+         break;
+      default:
+         return AAFF_INVALID_PAGE_ARGUMENT;
+   }
+   __atomic_fetch_add (&pAaff->PagesDecompressed, 1, __ATOMIC_RELAXED);
+
+   return AAFF_OK;
+}
+
+// -----------------------------------------------------
+//  Page cache - Only accessed by the thread in AaffRead
+// -----------------------------------------------------
+
+static int AaffPageCacheInit (t_pAaff pAaff)
+{
+   t_pAaffPageCache pCache = &pAaff->PageCache;
+   uint64_t         Entries;
+
+   Entries = (pAaff->MaxPageCache * 1024 * 1024) / pAaff->PageSize;
+   Entries = GETMAX (Entries, pAaff->Threads + 1);  // Every worker may be busy with an entry, the reading thread needs one more
+   Entries = GETMIN (Entries, pAaff->TotalPages);
+
+   pCache->Entries   = Entries;
+   pCache->HashSize  = Entries;
+   pCache->pEntryArr = (t_pAaffCacheEntry)  calloc (Entries         , sizeof(t_AaffCacheEntry ));
+   pCache->ppHashArr = (t_pAaffCacheEntry *)calloc (pCache->HashSize, sizeof(t_pAaffCacheEntry));
+   if ((pCache->pEntryArr == NULL) || (pCache->ppHashArr == NULL))
+      return AAFF_MEMALLOC_FAILED;
+
+   pCache->pHead = NULL;
+   pCache->pTail = NULL;
+   for (uint64_t i=0; i<Entries; i++)  // Link all entries into the LRU list
+   {
+      t_pAaffCacheEntry pEntry = &pCache->pEntryArr[i];
+
+      pEntry->State = AAFF_PAGE_EMPTY;
+      pEntry->pPrev = pCache->pTail;
+      if (pCache->pTail)
+           pCache->pTail->pNext = pEntry;
+      else pCache->pHead        = pEntry;
+      pCache->pTail = pEntry;
+   }
+   LOG ("Page cache with %" PRIu64 " entries", Entries);
+
+   return AAFF_OK;
+}
+
+static void AaffPageCacheDeInit (t_pAaffPageCache pCache)
+{
+   if (pCache->pEntryArr)
+   {
+      for (uint64_t i=0; i<pCache->Entries; i++)
+         SAFE_FREE (pCache->pEntryArr[i].pData);
+      SAFE_FREE (pCache->pEntryArr);
+   }
+   SAFE_FREE (pCache->ppHashArr);
+   pCache->Entries = 0;
+}
+
+static inline void AaffPageCacheUnlink (t_pAaffPageCache pCache, t_pAaffCacheEntry pEntry)
+{
+   if (pEntry->pPrev) pEntry->pPrev->pNext = pEntry->pNext; else pCache->pHead = pEntry->pNext;
+   if (pEntry->pNext) pEntry->pNext->pPrev = pEntry->pPrev; else pCache->pTail = pEntry->pPrev;
+   pEntry->pPrev = NULL;
+   pEntry->pNext = NULL;
+}
+
+static inline void AaffPageCachePushFront (t_pAaffPageCache pCache, t_pAaffCacheEntry pEntry)
+{
+   pEntry->pPrev = NULL;
+   pEntry->pNext = pCache->pHead;
+   if (pCache->pHead)
+        pCache->pHead->pPrev = pEntry;
+   else pCache->pTail        = pEntry;
+   pCache->pHead = pEntry;
+}
+
+static t_pAaffCacheEntry AaffPageCacheLookup (t_pAaffPageCache pCache, uint64_t Page)
+{
+   t_pAaffCacheEntry pEntry;
+
+   for (pEntry = pCache->ppHashArr[Page % pCache->HashSize]; pEntry; pEntry = pEntry->pHashNext)
+   {
+      if (pEntry->Page == Page)
       {
-         case AFF_PAGEFLAGS_UNCOMPRESSED:
-            CHK (AaffReadFile (pAaff, pAaff->pPageBuff, Header.DataLen))
-            pAaff->PageBuffDataLen = Header.DataLen;
-            break;
-         case AFF_PAGEFLAGS_COMPRESSED_ZERO:
-            CHK (AaffReadFile (pAaff, &Len, sizeof(Len)))
-            Len = ntohl (Len);
-            memset (pAaff->pPageBuff, 0, Len);
-            pAaff->PageBuffDataLen = Len;
-            break;
-         case AFF_PAGEFLAGS_COMPRESSED_ZLIB:
-            CHK (AaffRealloc ((void**)&pAaff->pDataBuff, &pAaff->DataBuffLen, Header.DataLen));
-            CHK (AaffReadFile (pAaff, pAaff->pDataBuff, Header.DataLen))                     // read into pDataBuff
-            ZLen = pAaff->PageSize;                                                          // size of pPageBuff
-            zrc = uncompress ((unsigned char*)(pAaff->pPageBuff), &ZLen, (unsigned char*)(pAaff->pDataBuff), Header.DataLen);    // uncompress into pPageBuff
-            pAaff->PageBuffDataLen = ZLen;
-            if (zrc != Z_OK)
-               return AAFF_UNCOMPRESS_FAILED;
-            break;
-         default:
-            return AAFF_INVALID_PAGE_ARGUMENT;
+         AaffPageCacheUnlink    (pCache, pEntry);
+         AaffPageCachePushFront (pCache, pEntry);
+         return pEntry;
       }
-      *ppData   = pAaff->pPageBuff;
-      *pDataLen = pAaff->PageBuffDataLen;
-      pAaff->CurrentPage = *pFoundPage;
-      rc = AAFF_FOUND;
    }
-   else
+   return NULL;
+}
+
+// AaffPageCacheDrop empties an entry and moves it to the LRU tail, so that it is recycled first
+
+static void AaffPageCacheDrop (t_pAaffPageCache pCache, t_pAaffCacheEntry pEntry)
+{
+   t_pAaffCacheEntry *ppLink;
+
+   for (ppLink = &pCache->ppHashArr[pEntry->Page % pCache->HashSize]; *ppLink; ppLink = &(*ppLink)->pHashNext)
    {
-      CHK (AaffSetCurrentSeekPos (pAaff, Header.DataLen, SEEK_CUR))
+      if (*ppLink == pEntry)
+      {
+         *ppLink = pEntry->pHashNext;
+         break;
+      }
    }
+   pEntry->pHashNext = NULL;
+   pEntry->State     = AAFF_PAGE_EMPTY;
+   AaffPageCacheUnlink (pCache, pEntry);
+   pEntry->pPrev = pCache->pTail;
+   if (pCache->pTail)
+        pCache->pTail->pNext = pEntry;
+   else pCache->pHead        = pEntry;
+   pCache->pTail = pEntry;
+}
 
-   // Read footer and position file pointer to next segment at the same time
-   // ----------------------------------------------------------------------
-   CHK (AaffReadFile (pAaff, &Footer, sizeof(Footer)))
-   if (strcmp (&Footer.Magic[0], AFF_SEGMENT_FOOTER_MAGIC) != 0)
-      return AAFF_INVALID_FOOTER;
+// AaffPageCacheAlloc recycles the least recently used entry for the given page. Entries being
+// decompressed by a worker and valid entries for pages between PinFrom and PinTo (the pages
+// of the current read request) are left alone. Returns NULL if there's no such entry.
 
-   return rc;
+static int AaffPageCacheAlloc (t_pAaff pAaff, uint64_t Page, uint64_t PinFrom, uint64_t PinTo, t_pAaffCacheEntry *ppEntry)
+{
+   t_pAaffPageCache  pCache = &pAaff->PageCache;
+   t_pAaffCacheEntry pEntry;
+   uint64_t          Bucket;
+
+   *ppEntry = NULL;
+   for (pEntry = pCache->pTail; pEntry; pEntry = pEntry->pPrev)
+   {
+      if (pEntry->State == AAFF_PAGE_EMPTY)
+         break;
+      if ((pEntry->State == AAFF_PAGE_VALID) && ((pEntry->Page < PinFrom) || (pEntry->Page > PinTo)))
+         break;
+   }
+   if (pEntry == NULL)
+      return AAFF_OK;
+
+   if (pEntry->State != AAFF_PAGE_EMPTY)
+      AaffPageCacheDrop (pCache, pEntry);
+   if (pEntry->pData == NULL)
+   {
+      pEntry->pData = (char *) malloc (pAaff->PageSize);
+      if (pEntry->pData == NULL)
+         return AAFF_MEMALLOC_FAILED;
+   }
+   pEntry->Page      = Page;
+   Bucket            = Page % pCache->HashSize;
+   pEntry->pHashNext = pCache->ppHashArr[Bucket];
+   pCache->ppHashArr[Bucket] = pEntry;
+   AaffPageCacheUnlink    (pCache, pEntry);
+   AaffPageCachePushFront (pCache, pEntry);
+   *ppEntry = pEntry;
+
+   return AAFF_OK;
 }
 
-static int AaffReadPage (t_pAaff pAaff, uint64_t Page, char **ppBuffer, uint32_t *pLen)
+// ------------------------------------------------------------
+//  Worker threads - Decompress several pages at the same time
+// ------------------------------------------------------------
+
+static void* AaffWorker (void *pArg)
 {
-    if (Page >= pAaff->TotalPages)
-       return AAFF_READ_BEYOND_LAST_PAGE;
+   t_pAaffThread pThread = (t_pAaffThread) pArg;
+   t_pAaffPool   pPool   = pThread->pPool;
 
-   // Check if it's the current page
-   // ------------------------------
-   if (Page == pAaff->CurrentPage)
+   (void) pthread_mutex_lock (&pPool->Mutex);
+   for (;;)
    {
-      *ppBuffer = pAaff->pPageBuff;
-      *pLen     = pAaff->PageBuffDataLen;
+      while (!pThread->JobPending && !pPool->Shutdown)
+         (void) pthread_cond_wait (&pThread->CondJob, &pPool->Mutex);
+      if (!pThread->JobPending)  // Shutdown, but only after the last job has been done
+         break;
+      (void) pthread_mutex_unlock (&pPool->Mutex);
+
+      pThread->ReturnCode = AaffDecodePage (pThread->pAaff, pThread->pEntry->Page, pThread->pEntry->pData, &pThread->pEntry->DataLen,
+                                            &pThread->Inflate, &pThread->pDataBuff, &pThread->DataBuffLen);
+
+      (void) pthread_mutex_lock (&pPool->Mutex);
+      pThread->JobPending = FALSE;
+      (void) pthread_cond_broadcast (&pPool->CondDone);
+   }
+   (void) pthread_mutex_unlock (&pPool->Mutex);
+
+   return NULL;
+}
+
+static int AaffThreadsInit (t_pAaff pAaff)
+{
+   t_pAaffThread pThread;
+
+   pAaff->pThreadArr    = NULL;
+   pAaff->Pool.Shutdown = FALSE;
+   if (pAaff->Threads <= 1)
       return AAFF_OK;
+
+   if (pthread_mutex_init (&pAaff->Pool.Mutex   , NULL) != 0) return AAFF_ERROR_PTHREAD;
+   if (pthread_cond_init  (&pAaff->Pool.CondDone, NULL) != 0) return AAFF_ERROR_PTHREAD;
+   pAaff->pThreadArr = (t_pAaffThread) calloc (pAaff->Threads, sizeof(t_AaffThread));
+   if (pAaff->pThreadArr == NULL)
+      return AAFF_MEMALLOC_FAILED;
+   for (uint64_t i=0; i<pAaff->Threads; i++)
+   {
+      pThread = &pAaff->pThreadArr[i];
+      pThread->pAaff = pAaff;
+      pThread->pPool = &pAaff->Pool;
+      XmountInflateInit (&pThread->Inflate);
+      if (pthread_cond_init (&pThread->CondJob, NULL) != 0)
+         return AAFF_ERROR_PTHREAD;
+      if (pthread_create (&pThread->ID, NULL, AaffWorker, pThread) != 0)
+      {
+         (void) pthread_cond_destroy (&pThread->CondJob);
+         return AAFF_ERROR_PTHREAD;
+      }
+      pThread->Running = TRUE;
    }
+   LOG ("%" PRIu64 " decompression threads started", pAaff->Threads);
 
-   // Set the seek position for starting the search
-   // ---------------------------------------------
-   int MaxHops;
+   return AAFF_OK;
+}
+
+static void AaffThreadsDeInit (t_pAaff pAaff)
+{
+   t_pAaffThread pThread;
 
-   if ((pAaff->CurrentPage   != AAFF_CURRENTPAGE_NOTSET) &&
-       (pAaff->CurrentPage+1 == Page))             // The current seek pos already is the correct one
+   if (pAaff->pThreadArr == NULL)
+      return;
+
+   (void) pthread_mutex_lock (&pAaff->Pool.Mutex);
+   pAaff->Pool.Shutdown = TRUE;
+   for (uint64_t i=0; i<pAaff->Threads; i++)
    {
-      MaxHops = 1;
+      if (pAaff->pThreadArr[i].Running)
+         (void) pthread_cond_signal (&pAaff->pThreadArr[i].CondJob);
    }
-   else                                            // Find the closest entry in PageSeekArr
+   (void) pthread_mutex_unlock (&pAaff->Pool.Mutex);
+
+   for (uint64_t i=0; i<pAaff->Threads; i++)
    {
-      int64_t Entry;
+      pThread = &pAaff->pThreadArr[i];
+      if (pThread->Running)
+      {
+         (void) pthread_join (pThread->ID, NULL);
+         (void) pthread_cond_destroy (&pThread->CondJob);
+      }
+      XmountInflateDeInit (&pThread->Inflate);
+      SAFE_FREE (pThread->pDataBuff);
+   }
+   SAFE_FREE (pAaff->pThreadArr);
+   (void) pthread_cond_destroy  (&pAaff->Pool.CondDone);
+   (void) pthread_mutex_destroy (&pAaff->Pool.Mutex);
+}
+
+// AaffThreadCollect takes the result of the job of the given worker, waiting for it if
+// necessary. A successfully decompressed page becomes valid in the cache, the entry of a
+// page that couldn't be decompressed is dropped. If Wait is not set and the job still is
+// running, nothing is done.
+
+static int AaffThreadCollect (t_pAaff pAaff, t_pAaffThread pThread, int Wait)
+{
+   t_pAaffCacheEntry pEntry = pThread->pEntry;
+   int               Done;
+   int               rc;
+
+   (void) pthread_mutex_lock (&pAaff->Pool.Mutex);
+   while (Wait && pThread->JobPending)
+      (void) pthread_cond_wait (&pAaff->Pool.CondDone, &pAaff->Pool.Mutex);
+   Done = !pThread->JobPending;
+   (void) pthread_mutex_unlock (&pAaff->Pool.Mutex);
+   if (!Done)
+      return AAFF_OK;
+
+   rc = pThread->ReturnCode;
+   if (rc == AAFF_OK)
+        pEntry->State = AAFF_PAGE_VALID;
+   else AaffPageCacheDrop (&pAaff->PageCache, pEntry);
+   pEntry ->pThread = NULL;
+   pThread->pEntry  = NULL;
+
+   return rc;
+}
 
-      Entry = Page / pAaff->Interleave;
-      while (pAaff->pPageSeekArr[Entry] == 0)
+// AaffLaunchPages hands the pages From to To which are not yet in the cache to idle workers.
+// It stops when there's no idle worker or no cache entry left that may be recycled. Pages are
+// only launched in advance, so errors are not reported here but when the page actually is read.
+
+static void AaffLaunchPages (t_pAaff pAaff, uint64_t From, uint64_t To, uint64_t RequestTo)
+{
+   t_pAaffThread     pThread;
+   t_pAaffCacheEntry pEntry;
+   uint64_t          Page;
+   uint64_t          t = 0;
+   int               rc;
+
+   for (uint64_t i=0; i<pAaff->Threads; i++)  // Free the workers whose jobs are done
+   {
+      pThread = &pAaff->pThreadArr[i];
+      if (pThread->pEntry)
       {
-         Entry--;
-         if (Entry<0)
-            return AAFF_SEEKARR_CORRUPT;
+         rc = AaffThreadCollect (pAaff, pThread, FALSE);
+         if (rc != AAFF_OK)
+            LOG ("Decompressing a page in advance failed (%s)", AaffGetErrorMessage (rc));
       }
-      AaffSetCurrentSeekPos (pAaff, pAaff->pPageSeekArr[Entry], SEEK_SET);
-      MaxHops = Page - (Entry * pAaff->Interleave) +1;
    }
 
-   // Run through segment list until page is found
-   // --------------------------------------------
-   uint64_t Seek;
-   uint64_t FoundPage=0;
-   int                rc;
+   for (Page=From; Page<=To; Page++)
+   {
+      if (AaffPageCacheLookup (&pAaff->PageCache, Page))
+         continue;
+      if (pAaff->pPageIndexArr[Page].Offset == 0)  // Missing page, the error will show up when reading it
+         continue;
+      if (AaffIsZeroPage (pAaff, Page))
+         continue;
+      while ((t < pAaff->Threads) && pAaff->pThreadArr[t].pEntry)
+         t++;
+      if (t >= pAaff->Threads)
+         break;
+      if ((AaffPageCacheAlloc (pAaff, Page, From, To, &pEntry) != AAFF_OK) || (pEntry == NULL))
+         break;
+      pThread = &pAaff->pThreadArr[t];
+      pEntry ->State   = AAFF_PAGE_LOADING;
+      pEntry ->pThread = pThread;
+      pThread->pEntry  = pEntry;
+      if (Page > RequestTo)
+         pAaff->ReadaheadPages++;
+
+      (void) pthread_mutex_lock (&pAaff->Pool.Mutex);
+      pThread->JobPending = TRUE;
+      (void) pthread_cond_signal  (&pThread->CondJob);
+      (void) pthread_mutex_unlock (&pAaff->Pool.Mutex);
+   }
+}
+
+// AaffReadPage gets the given page from the cache. If it isn't there, it is decompressed by
+// the calling thread, or, if a worker is about to decompress it, its job result is waited for.
+// The cache entry for it preferably isn't taken from the pages Page to PinTo, which still are
+// to be read by the current request or have been launched in advance for it.
+// The returned buffer stays valid until the next call to AaffReadPage or AaffLaunchPages.
+
+static int AaffReadPage (t_pAaff pAaff, uint64_t Page, uint64_t PinTo, char **ppBuffer, uint32_t *pLen)
+{
+   t_pAaffCacheEntry pEntry;
+   int               rc;
+
+   if (Page >= pAaff->TotalPages)
+      return AAFF_READ_BEYOND_LAST_PAGE;
 
-   LOG ("Searching for page %" PRIu64 ", MaxHops=%d", Page, MaxHops);
-   while (MaxHops--)
+   pEntry = AaffPageCacheLookup (&pAaff->PageCache, Page);
+   if (pEntry)
    {
-      Seek = AaffGetCurrentSeekPos (pAaff);
-      rc   = AaffReadSegmentPage   (pAaff, Page, &FoundPage, ppBuffer, pLen);
-      if (rc != AAFF_FOUND)
+      pAaff->PageCacheHits++;
+      if (pEntry->State == AAFF_PAGE_LOADING)
+         CHK (AaffThreadCollect (pAaff, pEntry->pThread, TRUE))
+   }
+   else
+   {
+      pAaff->PageCacheMisses++;
+      CHK (AaffPageCacheAlloc (pAaff, Page, Page, PinTo, &pEntry))
+      if (pEntry == NULL)    // All valid entries belong to the request, give up one of them
+         CHK (AaffPageCacheAlloc (pAaff, Page, Page, Page, &pEntry))
+      if (pEntry == NULL)    // Cannot happen, as there always are more entries than workers
+         return AAFF_MEMALLOC_FAILED;
+      rc = AaffDecodePage (pAaff, Page, pEntry->pData, &pEntry->DataLen, &pAaff->Inflate, &pAaff->pDataBuff, &pAaff->DataBuffLen);
+      if (rc != AAFF_OK)
+      {
+         AaffPageCacheDrop (&pAaff->PageCache, pEntry);
          CHK (rc)
-      LOG ("   %" PRIu64 " (%d)", FoundPage, rc);
-      if ((FoundPage % pAaff->Interleave) == 0)
-         pAaff->pPageSeekArr[FoundPage/pAaff->Interleave] = Seek;
-      if (rc == AAFF_FOUND)
-         break;
+      }
+      pEntry->State = AAFF_PAGE_VALID;
    }
-   if (MaxHops < 0)
-      return AAFF_PAGE_NOT_FOUND;
+   *ppBuffer = pEntry->pData;
+   *pLen     = pEntry->DataLen;
 
    return AAFF_OK;
 }
 
+static uint64_t GetCPUs (t_pAaff pAaff)
+{
+   long CPUs;
+
+   CPUs = sysconf (_SC_NPROCESSORS_ONLN);
+   if (CPUs < 1)
+   {
+      if (pAaff)
+         LOG ("Number of CPUs could not be determined, assume 4 CPUs");
+      CPUs = 4;
+   }
+   return (uint64_t) CPUs;
+}
+
 // ---------------
 //  API functions
 // ---------------
@@ -444,10 +944,14 @@ static int AaffCreateHandle (void **ppHandle, void *p_init_handle, const char *p
    memset (pAaff, 0, sizeof(t_Aaff));
 
 
-   pAaff->LogStdout     = Debug;
+   pAaff->LogStdout      = Debug;
    // Values below may be overwritten by AaffOptionsParse
-   pAaff->MaxPageArrMem = AAFF_DEFAULT_MAX_PAGE_ARR_MEM;
-   pAaff->pLogFilename  = NULL;
+   pAaff->pLogFilename   = NULL;
+   pAaff->pIndexFilename = NULL;
+   pAaff->MaxPageCache   = AAFF_DEFAULT_PAGECACHE;
+   pAaff->Readahead      = AAFF_DEFAULT_READAHEAD;
+   pAaff->Threads        = GetCPUs (pAaff);
+   pAaff->Fd             = -1;
 
    *ppHandle = (void*) pAaff;
 
@@ -460,6 +964,7 @@ static int AaffDestroyHandle (void **ppHandle)
 
    CHK (AaffClose (pAaff))
    SAFE_FREE (pAaff->pLogFilename);
+   SAFE_FREE (pAaff->pIndexFilename);
    memset (pAaff, 0, sizeof(t_Aaff));
    SAFE_FREE (pAaff);
 
@@ -472,6 +977,7 @@ int AaffOpen (void *pHandle, const char **ppFilenameArr, uint64_t FilenameArrLen
    t_pAaff  pAaff = (t_pAaff) pHandle;
    char      Signature[strlen(AFF_HEADER)+1]; // 8 bytes, see definition of AFF_HEADER
    uint64_t  Seek;
+   struct stat Stat;
 
    LOG ("Called - Files=%" PRIu64, FilenameArrLen);
 
@@ -485,6 +991,13 @@ int AaffOpen (void *pHandle, const char **ppFilenameArr, uint64_t FilenameArrLen
       (void) AaffClose (pAaff);
       CHK (AAFF_FILE_OPEN_FAILED)
    }
+   if (fstat (fileno (pAaff->pFile), &Stat) != 0)
+   {
+      (void) AaffClose (pAaff);
+      CHK (AAFF_FILE_OPEN_FAILED)
+   }
+   pAaff->FileSize = Stat.st_size;
+   pAaff->Fd       = fileno (pAaff->pFile);
 
    // Check signature
    // ---------------
@@ -569,38 +1082,66 @@ int AaffOpen (void *pHandle, const char **ppFilenameArr, uint64_t FilenameArrLen
       CHK (AAFF_NOT_CREATED_BY_GUYMAGER)
    }
 
-   // Prepare page seek array
-   // -----------------------
-   uint64_t MaxEntries;
-   int      ArrBytes;
+   // Build page index
+   // ----------------
+   uint64_t FirstPage;
+   int      rc;
+
+   CHK (AaffPageNumberFromSegmentName (pName, &FirstPage));
+   if (FirstPage != 0)
+   {
+      (void) AaffClose (pAaff);
+      CHK (AAFF_UNEXPECTED_PAGE_NUMBER)
+   }
 
    pAaff->TotalPages = pAaff->ImageSize / pAaff->PageSize;
    if (pAaff->ImageSize % pAaff->PageSize)
       pAaff->TotalPages++;
 
-   MaxEntries = (pAaff->MaxPageArrMem*1024*1024) / (sizeof (unsigned long long *) + 1); // +1 in order not to risk a result of 0
-   MaxEntries = GETMIN (MaxEntries, pAaff->TotalPages);
-
-   pAaff->Interleave = pAaff->TotalPages / MaxEntries;
-   if (pAaff->TotalPages % MaxEntries)
-      pAaff->Interleave++;
-
-   pAaff->PageSeekArrLen = pAaff->TotalPages / pAaff->Interleave;
-   ArrBytes              = pAaff->PageSeekArrLen * sizeof(uint64_t *);
-   pAaff->pPageSeekArr   = (uint64_t*)malloc (ArrBytes);
-   memset (pAaff->pPageSeekArr, 0, ArrBytes);
-   CHK (AaffPageNumberFromSegmentName (pName, &pAaff->CurrentPage));
-   if (pAaff->CurrentPage != 0)
+   pAaff->pPageIndexArr = (t_pAaffPageIndex) calloc (pAaff->TotalPages, sizeof(t_AaffPageIndex));
+   if (pAaff->pPageIndexArr == NULL)
    {
       (void) AaffClose (pAaff);
-      CHK (AAFF_UNEXPECTED_PAGE_NUMBER)
+      CHK (AAFF_MEMALLOC_FAILED)
+   }
+   pAaff->PageIndexLoaded = FALSE;
+   if (pAaff->pIndexFilename)
+   {
+      rc = AaffIndexLoad (pAaff, &Stat);
+      if (rc == AAFF_OK)
+           pAaff->PageIndexLoaded = TRUE;
+      else LOG ("Page index %s not used (%s), scanning AFF file", pAaff->pIndexFilename, AaffGetErrorMessage (rc));
+   }
+   if (!pAaff->PageIndexLoaded)
+   {
+      rc = AaffScanPages (pAaff, Seek);
+      if (rc != AAFF_OK)
+      {
+         (void) AaffClose (pAaff);
+         CHK (rc)
+      }
+      if (pAaff->pIndexFilename)
+      {
+         rc = AaffIndexWrite (pAaff, &Stat);   // Not fatal, the image can be used anyway
+         if (rc != AAFF_OK)
+            LOG ("Writing page index %s failed (%s)", pAaff->pIndexFilename, AaffGetErrorMessage (rc));
+      }
    }
-   pAaff->pPageSeekArr[0] = Seek;
 
-   // Alloc Buffers
-   // -------------
-   pAaff->pPageBuff   = (char *) malloc (pAaff->PageSize);
-   pAaff->CurrentPage = AAFF_CURRENTPAGE_NOTSET;
+   // Page cache and decompression workers
+   // ------------------------------------
+   XmountInflateInit (&pAaff->Inflate);
+   LOG ("Inflate backend: %s", XmountInflateBackend());
+   pAaff->Threads    = GETMAX (pAaff->Threads, 1);
+   pAaff->NextSeqPos = UINT64_MAX;
+   rc = AaffPageCacheInit (pAaff);
+   if (rc == AAFF_OK)
+      rc = AaffThreadsInit (pAaff);
+   if (rc != AAFF_OK)
+   {
+      (void) AaffClose (pAaff);
+      CHK (rc)
+   }
 
    LOG ("Ret");
    return AAFF_OK;
@@ -613,20 +1154,23 @@ static int AaffClose (void *pHandle)
 
    LOG ("Called");
 
+   AaffThreadsDeInit (pAaff);    // Must be done first, the workers still might be using the page cache
+   AaffPageCacheDeInit (&pAaff->PageCache);
    if (pAaff->pFilename)       SAFE_FREE (pAaff->pFilename);
-   if (pAaff->pPageSeekArr)    SAFE_FREE (pAaff->pPageSeekArr);
+   if (pAaff->pPageIndexArr)   SAFE_FREE (pAaff->pPageIndexArr);
    if (pAaff->pLibVersion)     SAFE_FREE (pAaff->pLibVersion);
    if (pAaff->pFileType)       SAFE_FREE (pAaff->pFileType);
    if (pAaff->pNameBuff)       SAFE_FREE (pAaff->pNameBuff);
    if (pAaff->pDataBuff)       SAFE_FREE (pAaff->pDataBuff);
-   if (pAaff->pPageBuff)       SAFE_FREE (pAaff->pPageBuff);
    if (pAaff->pInfoBuffConst)  SAFE_FREE (pAaff->pInfoBuffConst);
    if (pAaff->pInfoBuff)       SAFE_FREE (pAaff->pInfoBuff);
+   XmountInflateDeInit (&pAaff->Inflate);
 
    if (pAaff->pFile)
       if (fclose (pAaff->pFile))
          rc = AAFF_CANNOT_CLOSE_FILE;
    pAaff->pFile = NULL;
+   pAaff->Fd    = -1;
 
    LOG ("Ret");
    return rc;
@@ -650,6 +1194,8 @@ static int AaffRead (void *pHandle, char *pBuf, off_t Seek, size_t Count, size_t
    uint64_t   Page;
    uint64_t   Seek64;
    uint64_t   Remaining;
+   uint64_t   LastPage;
+   uint64_t   LaunchTo;
    uint32_t   PageLen=0, Ofs, ToCopy;
    int        Ret = AAFF_OK;
 
@@ -672,19 +1218,46 @@ static int AaffRead (void *pHandle, char *pBuf, off_t Seek, size_t Count, size_t
    Page      = Seek64 / pAaff->PageSize;
    Ofs       = Seek64 % pAaff->PageSize;
    Remaining = Count;
+   pAaff->ReadOperations++;
+   if (Count == 0)
+      goto Leave;
 
-   while (Count)
+   // Let the workers decompress the pages of this request in parallel and, when reading
+   // sequentially, the pages following it. The loop below then finds them in the cache.
+   LastPage = (Seek64 + Count - 1) / pAaff->PageSize;
+   LaunchTo = LastPage;
+   if (pAaff->pThreadArr)
    {
-      Ret = AaffReadPage (pAaff, Page, &pPageBuffer, &PageLen);
-      if (Ret)
-         goto Leave;
+      if (Seek64 == pAaff->NextSeqPos)
+         LaunchTo = GETMIN (LastPage + pAaff->Readahead, pAaff->TotalPages - 1);
+      if (LaunchTo > Page)  // Not worth it for a single page, it is decompressed by the loop below
+         AaffLaunchPages (pAaff, Page, LaunchTo, LastPage);
+   }
+   pAaff->NextSeqPos = Seek64 + Count;
+
+   while (Remaining)
+   {
+      if (AaffIsZeroPage (pAaff, Page))
+      {
+         pPageBuffer = NULL;
+         PageLen     = AaffPageLen (pAaff, Page);
+         pAaff->ZeroPageReads++;
+      }
+      else
+      {
+         Ret = AaffReadPage (pAaff, Page, LaunchTo, &pPageBuffer, &PageLen);
+         if (Ret)
+            goto Leave;
+      }
       if (PageLen == 0)
       {
          Ret = AAFF_PAGE_LENGTH_ZERO;
          goto Leave;
       }
       ToCopy = GETMIN (PageLen-Ofs, Remaining);
-      memcpy (pBuf, pPageBuffer+Ofs, ToCopy);
+      if (pPageBuffer)
+           memcpy (pBuf, pPageBuffer+Ofs, ToCopy);
+      else memset (pBuf, 0, ToCopy);
       Remaining -= ToCopy;
       pBuf      += ToCopy;
       *pRead    += ToCopy;
@@ -698,16 +1271,66 @@ Leave:
    return Ret;
 }
 
+// AaffGetExtents reports the zero pages as zero extents, everything else as data
+
+static int AaffGetExtents (void *pHandle, uint64_t Offset, uint64_t Count, pts_LibXmountExtent *ppExtents, uint64_t *pExtentsCount)
+{
+   t_pAaff              pAaff      = (t_pAaff) pHandle;
+   pts_LibXmountExtent pExtentArr = NULL;
+   uint64_t             Extents    = 0;
+   uint64_t             Page;
+   uint64_t             End;
+   uint64_t             PageEnd;
+
+   LOG ("Called - Offset=%'" PRIu64 ",Count=%'" PRIu64, Offset, Count);
+
+   *ppExtents     = NULL;
+   *pExtentsCount = 0;
+   if (Offset >= pAaff->ImageSize)
+      return AAFF_OK;
+   End = GETMIN (Offset + Count, pAaff->ImageSize);
+
+   Page = Offset / pAaff->PageSize;
+   while (Offset < End)
+   {
+      PageEnd = GETMIN ((Page+1) * pAaff->PageSize, End);
+      if (AddExtent (&pExtentArr, &Extents, Offset, PageEnd - Offset, AaffIsZeroPage (pAaff, Page) ? LibXmountExtentType_Zero : LibXmountExtentType_Data) != 0)
+      {
+         SAFE_FREE (pExtentArr);
+         CHK (AAFF_MEMALLOC_FAILED)
+      }
+      Offset = PageEnd;
+      Page++;
+   }
+   *ppExtents     = pExtentArr;
+   *pExtentsCount = Extents;
+
+   LOG ("Ret - %" PRIu64 " extents", Extents);
+   return AAFF_OK;
+}
+
 static int AaffOptionsHelp (const char **ppHelp)
 {
    char *pHelp=NULL;
    int    wr;
 
-   wr = asprintf (&pHelp, "    %-12s : Maximum amount of RAM cache, in MiB, for image seek offsets. Default: %"PRIu64" MiB\n"
+   wr = asprintf (&pHelp, "    %-12s : Maximum amount of RAM, in MiB, for caching decompressed pages. Default: %"PRIu64" MiB\n"
+                          "                   At least one page per thread plus one is cached in any case.\n"
+                          "    %-12s : Number of pages decompressed in advance when reading sequentially. Default: %"PRIu64"\n"
+                          "    %-12s : Number of threads for decompressing several pages in parallel. Default: %"PRIu64"\n"
+                          "                   A value of 1 switches parallel decompression off.\n"
+                          "    %-12s : Page index file. The page index is built when opening the image by reading all segment\n"
+                          "                   headers. With this option, it is written to the given file and loaded from there the next\n"
+                          "                   time the same image is opened. The file is rebuilt if the image has changed.\n"
+                          "    %-12s : Obsolete, the page index always covers all pages. Accepted for compatibility.\n"
                           "    %-12s : Log file name.\n"
                           "    Specify full path for %s. The given file name is extended by _<pid>.\n"
                           "    The AFF format has been declared as deprecated by its inventor!\n",
-                          AAFF_OPTION_MAXPAGEARRMEM, AAFF_DEFAULT_MAX_PAGE_ARR_MEM,
+                          AAFF_OPTION_PAGECACHE, AAFF_DEFAULT_PAGECACHE,
+                          AAFF_OPTION_READAHEAD, AAFF_DEFAULT_READAHEAD,
+                          AAFF_OPTION_THREADS, GetCPUs (NULL),
+                          AAFF_OPTION_INDEX,
+                          AAFF_OPTION_MAXPAGEARRMEM,
                           AAFF_OPTION_LOG,
                           AAFF_OPTION_LOG);
    if ((pHelp == NULL) || (wr<=0))
@@ -755,7 +1378,22 @@ static int AaffOptionsParse (void *pHandle, uint32_t OptionCount, const pts_LibX
          pOption->valid = TRUE;
          LOG ("Option %s set to %s", AAFF_OPTION_LOG, pAaff->pLogFilename);
       }
+      else if (strcmp (pOption->p_key, AAFF_OPTION_INDEX) == 0)
+      {
+         SAFE_FREE (pAaff->pIndexFilename);
+         pAaff->pIndexFilename = strdup (pOption->p_value);  // The file itself needn't exist yet
+         if (pAaff->pIndexFilename == NULL)
+         {
+            rc = AAFF_MEMALLOC_FAILED;
+            break;
+         }
+         pOption->valid = TRUE;
+         LOG ("Option %s set to %s", AAFF_OPTION_INDEX, pAaff->pIndexFilename);
+      }
       else TEST_OPTION_UINT64 (AAFF_OPTION_MAXPAGEARRMEM, MaxPageArrMem)
+      else TEST_OPTION_UINT64 (AAFF_OPTION_PAGECACHE    , MaxPageCache )
+      else TEST_OPTION_UINT64 (AAFF_OPTION_READAHEAD    , Readahead    )
+      else TEST_OPTION_UINT64 (AAFF_OPTION_THREADS      , Threads      )
    }
    #undef TEST_OPTION_UINT64
 
@@ -768,8 +1406,6 @@ static int AaffOptionsParse (void *pHandle, uint32_t OptionCount, const pts_LibX
 static int AaffGetInfofileContent (void *pHandle, const char **ppInfoBuf)
 {
    t_pAaff  pAaff  = (t_pAaff) pHandle;
-   uint64_t i;
-   uint64_t Entries = 0;
    int      Pos     = 0;
 
    LOG ("Called");
@@ -788,21 +1424,13 @@ static int AaffGetInfofileContent (void *pHandle, const char **ppInfoBuf)
    Pos += snprintf (&pAaff->pInfoBuff[Pos], REM, "\n");
    Pos += snprintf (&pAaff->pInfoBuff[Pos], REM, "\n%s", pAaff->pInfoBuffConst);
    Pos += snprintf (&pAaff->pInfoBuff[Pos], REM, "\n");
-   Pos += snprintf (&pAaff->pInfoBuff[Pos], REM, "\nCurrent page       ");
-   if (pAaff->CurrentPage == AAFF_CURRENTPAGE_NOTSET)
-        Pos += snprintf (&pAaff->pInfoBuff[Pos], REM, "not set");
-   else Pos += snprintf (&pAaff->pInfoBuff[Pos], REM, "%" PRIu64, pAaff->CurrentPage);
-   Pos += snprintf (&pAaff->pInfoBuff[Pos], REM, "\nSeek array length  %" PRIu64, pAaff->PageSeekArrLen);
-   Pos += snprintf (&pAaff->pInfoBuff[Pos], REM, "\nSeek interleave    %" PRIu64, pAaff->Interleave);
+   Pos += snprintf (&pAaff->pInfoBuff[Pos], REM, "\nPage cache entries %" PRIu64, pAaff->PageCache.Entries);
+   Pos += snprintf (&pAaff->pInfoBuff[Pos], REM, "\nThreads            %" PRIu64, pAaff->Threads);
+   Pos += snprintf (&pAaff->pInfoBuff[Pos], REM, "\nPage index entries %" PRIu64, pAaff->PageIndexEntries);
+   Pos += snprintf (&pAaff->pInfoBuff[Pos], REM, "\nZero pages         %" PRIu64, pAaff->ZeroPages);
+   Pos += snprintf (&pAaff->pInfoBuff[Pos], REM, "\nPage index source  %s", pAaff->PageIndexLoaded ? pAaff->pIndexFilename : "scanned");
    Pos += snprintf (&pAaff->pInfoBuff[Pos], REM, "\n");
    Pos += snprintf (&pAaff->pInfoBuff[Pos], REM, "\nThe AFF format has been declared as deprecated by its inventor!");
-
-   for (i=0; i<pAaff->PageSeekArrLen; i++)
-   {
-      if (pAaff->pPageSeekArr[i])
-         Entries++;
-   }
-   Pos += snprintf (&pAaff->pInfoBuff[Pos], REM, "\nSeek array entries %" PRIu64, Entries);
    Pos += snprintf (&pAaff->pInfoBuff[Pos], REM, "\n");
    #undef REM
 
@@ -814,6 +1442,39 @@ static int AaffGetInfofileContent (void *pHandle, const char **ppInfoBuf)
    return AAFF_OK;
 }
 
+static int AaffGetStats (void *pHandle, pts_LibXmountStat *ppStats, uint32_t *pStatsCount)
+{
+   t_pAaff           pAaff  = (t_pAaff) pHandle;
+   pts_LibXmountStat pStats = NULL;
+   uint32_t          Count  = 0;
+
+   LOG ("Called");
+
+   #define ADD_STAT(Key,Value)                                 \
+      if (AddStat (&pStats, &Count, Key, Value) != 0)          \
+      {                                                        \
+         free (pStats);                                        \
+         return AAFF_MEMALLOC_FAILED;                          \
+      }
+
+   ADD_STAT ("Read operations"          , pAaff->ReadOperations   )
+   ADD_STAT ("Page cache hits"          , pAaff->PageCacheHits    )
+   ADD_STAT ("Page cache misses"        , pAaff->PageCacheMisses  )
+   ADD_STAT ("Page cache entries"       , pAaff->PageCache.Entries)
+   ADD_STAT ("Pages decompressed"       , __atomic_load_n (&pAaff->PagesDecompressed, __ATOMIC_RELAXED))
+   ADD_STAT ("Readahead pages"          , pAaff->ReadaheadPages   )
+   ADD_STAT ("Zero pages"               , pAaff->ZeroPages        )
+   ADD_STAT ("Zero page reads"          , pAaff->ZeroPageReads    )
+   ADD_STAT ("Decompression threads"    , pAaff->Threads          )
+   #undef ADD_STAT
+
+   *ppStats     = pStats;
+   *pStatsCount = Count;
+
+   LOG ("Ret - %u counters", Count);
+   return AAFF_OK;
+}
+
 static const char* AaffGetErrorMessage (int ErrNum)
 {
    const char *pMsg;
@@ -855,6 +1516,11 @@ static const char* AaffGetErrorMessage (int ErrNum)
       ADD_ERR (AAFF_READ_BEYOND_LAST_PAGE)
       ADD_ERR (AAFF_PAGE_LENGTH_ZERO)
       ADD_ERR (AAFF_NEGATIVE_SEEK)
+      ADD_ERR (AAFF_PAGE_TOO_LARGE)
+      ADD_ERR (AAFF_INDEX_INVALID)
+      ADD_ERR (AAFF_INDEX_FILE_CHANGED)
+      ADD_ERR (AAFF_INDEX_WRITE_FAILED)
+      ADD_ERR (AAFF_ERROR_PTHREAD)
 
       default:
          pMsg = "Unknown error";
@@ -894,9 +1560,11 @@ void LibXmount_Input_GetFunctions(ts_LibXmountInputFunctions *pFunctions)
   pFunctions->Close              = &AaffClose;
   pFunctions->Size               = &AaffSize;
   pFunctions->Read               = &AaffRead;
+  pFunctions->GetExtents         = &AaffGetExtents;
   pFunctions->OptionsHelp        = &AaffOptionsHelp;
   pFunctions->OptionsParse       = &AaffOptionsParse;
   pFunctions->GetInfofileContent = &AaffGetInfofileContent;
+  pFunctions->GetStats           = &AaffGetStats;
   pFunctions->GetErrorMessage    = &AaffGetErrorMessage;
   pFunctions->FreeBuffer         = &AaffFreeBuffer;
 }
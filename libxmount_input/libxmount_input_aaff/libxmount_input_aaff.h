@@ -35,8 +35,8 @@ typedef struct _t_Aaff *t_pAaff;
 #define FALSE 0
 #define TRUE  1
 
-const uint64_t AAFF_DEFAULT_MAX_PAGE_ARR_MEM = 10;  // Default max. memory for caching seek points for fast page access (MiB)
-const uint64_t AAFF_CURRENTPAGE_NOTSET       = UINT64_MAX;
+const uint64_t AAFF_DEFAULT_PAGECACHE        = 128;  // Default max. memory for the cache of decompressed pages (MiB)
+const uint64_t AAFF_DEFAULT_READAHEAD         = 2;    // Default number of pages decompressed in advance when reading sequentially
 
 // -----------------
 //  AFF definitions
@@ -100,10 +100,99 @@ typedef struct
 
 const int AaffInfoBuffLen = 1024*1024;
 
+// Cache of decompressed pages. Its entries are kept in an LRU list and found by means of a small
+// hash table. The cache is only accessed by the thread calling AaffRead; a worker decompressing a
+// page only writes to the data buffer of the entry it has been handed.
+
+typedef enum
+{
+   AAFF_PAGE_EMPTY = 0,
+   AAFF_PAGE_LOADING,              // A worker is decompressing the page, the entry must not be recycled
+   AAFF_PAGE_VALID
+} t_AaffPageState;
+
+typedef struct _t_AaffCacheEntry
+{
+   uint64_t                   Page;
+   t_AaffPageState            State;
+   uint32_t                   DataLen;    // Length of the page data (the last page might be shorter than the page size)
+   char                     *pData;       // PageSize bytes, allocated on first use
+   struct _t_AaffThread     *pThread;     // The worker decompressing the page while State is AAFF_PAGE_LOADING
+   struct _t_AaffCacheEntry *pPrev;       // LRU list: Towards the most recently used entry
+   struct _t_AaffCacheEntry *pNext;       // LRU list: Towards the least recently used entry
+   struct _t_AaffCacheEntry *pHashNext;
+} t_AaffCacheEntry, *t_pAaffCacheEntry;
+
+typedef struct
+{
+   t_pAaffCacheEntry  pEntryArr;
+   uint64_t            Entries;
+   t_pAaffCacheEntry *ppHashArr;
+   uint64_t            HashSize;
+   t_pAaffCacheEntry  pHead;              // Most recently used entry
+   t_pAaffCacheEntry  pTail;              // Least recently used entry, first to be recycled
+} t_AaffPageCache, *t_pAaffPageCache;
+
+typedef struct
+{
+   pthread_mutex_t    Mutex;               // Protects the JobPending fields of all workers and Shutdown
+   pthread_cond_t     CondDone;            // Broadcast whenever a worker has finished a job
+   uint8_t            Shutdown;            // Set by AaffClose in order to terminate the workers
+} t_AaffPool, *t_pAaffPool;
+
+typedef struct _t_AaffThread
+{
+   t_pAaff            pAaff;               // The workers only have read access to the handle
+   t_pAaffPool        pPool;
+   pthread_t          ID;
+   uint8_t            Running;             // The worker thread has been created and waits for jobs
+   pthread_cond_t     CondJob;             // Signalled when a job has been handed to this worker
+   uint8_t            JobPending;          // Set when launching a job, cleared by the worker when the job is done
+   ts_XmountInflate   Inflate;             // Decompressor state of this worker
+   char             *pDataBuff;            // Compressed page data
+   uint32_t           DataBuffLen;
+   t_pAaffCacheEntry pEntry;               // Job: Decompress page pEntry->Page into pEntry->pData; NULL if the worker is free
+   int                ReturnCode;
+} t_AaffThread, *t_pAaffThread;
+
+// The page index contains one entry per page. It is built at open time by a pass that only reads
+// the segment headers and names and seeks over the data.
+
+typedef struct
+{
+   uint64_t     Offset;            // File position of the page data (behind segment header and name), 0 if the page wasn't found
+   uint32_t     DataLen;           // Length of the page data in the file
+   uint32_t     Flags;             // The segment argument, see AFF_PAGEFLAGS_xxx; zero pages are read without any file I/O
+} __attribute__ ((packed)) t_AaffPageIndex, *t_pAaffPageIndex;
+
+// Page index file. If option aaffindex is given, the page index is written to that file after
+// it has been built and loaded from it on subsequent opens, as long as the AFF file hasn't changed.
+// Layout:
+//    t_AaffIndexHeader
+//    t_AaffPageIndex [TotalPages]
+// The file is written in host byte order; files from other architectures are rejected by the
+// magic check.
+
+#define AAFF_INDEX_MAGIC   0x5844495f46464141ULL   // AAFF_IDX
+#define AAFF_INDEX_VERSION 1
+
+typedef struct
+{
+   uint64_t     Magic;
+   uint32_t     Version;
+   uint32_t     Checksum;          // Adler-32 of the page index entries
+   uint64_t     FileSize;          // Size and modification time are used for checking
+   int64_t      MTime;             // if the AFF file is still the same
+   uint64_t     TotalPages;
+   uint32_t     PageSize;
+} __attribute__ ((packed)) t_AaffIndexHeader, *t_pAaffIndexHeader;
+
 typedef struct _t_Aaff
 {
    char         *pFilename;
    FILE         *pFile;
+   int            Fd;              // File descriptor of pFile, for reading pages with pread
+   uint64_t       FileSize;
 
    char         *pLibVersion;  // AFF File Header info
    char         *pFileType;
@@ -118,20 +207,34 @@ typedef struct _t_Aaff
    unsigned int   NameBuffLen;
    unsigned int   DataBuffLen;
 
-   uint64_t       CurrentPage;
-   char         *pPageBuff;        // Length is PageSize, contains data of CurrentPage
-   unsigned int   PageBuffDataLen; // Length of current data in PageBuff (the same for all pages, but the last one might contain less data)
+   t_AaffPageCache PageCache;
+   ts_XmountInflate Inflate;       // Decompressor state for pages decompressed by the reading thread itself
+   t_AaffPool     Pool;
+   t_pAaffThread pThreadArr;       // Decompression workers, NULL if running single-threaded
+   uint64_t       NextSeqPos;      // Image position following the previous read request, for detecting sequential reads
+
+   uint64_t       PageCacheHits;   // Statistics
+   uint64_t       PageCacheMisses;
+   uint64_t       PagesDecompressed;
+   uint64_t       ReadaheadPages;
+   uint64_t       ZeroPageReads;
+   uint64_t       ReadOperations;
 
    char         *pInfoBuff;
    char         *pInfoBuffConst;
 
-   uint64_t     *pPageSeekArr;
-   uint64_t       PageSeekArrLen;
-   uint64_t       Interleave;      // The number of pages lying between 2 entries in the PageSeekArr
+   t_pAaffPageIndex pPageIndexArr; // TotalPages entries
+   uint64_t       PageIndexEntries;// Number of pages found in the AFF file
+   uint64_t       ZeroPages;       // Number of pages flagged AFF_PAGEFLAGS_COMPRESSED_ZERO
+   uint8_t        PageIndexLoaded; // Page index has been read from the index file
 
    // Options
    char         *pLogFilename;
-   uint64_t       MaxPageArrMem;   // Maximum amount of memory (in MiB) for storing page pointers
+   char         *pIndexFilename;   // Path of the page index file (NULL if not used)
+   uint64_t       MaxPageArrMem;   // Obsolete, only accepted for compatibility
+   uint64_t       MaxPageCache;    // Maximum amount of RAM for the cache of decompressed pages, in MiB
+   uint64_t       Readahead;       // Number of pages decompressed in advance when reading sequentially
+   uint64_t       Threads;         // Number of threads for decompressing pages in parallel
    uint8_t        LogStdout;
 } t_Aaff;
 
@@ -179,6 +282,11 @@ enum
    AAFF_READ_BEYOND_LAST_PAGE,
    AAFF_PAGE_LENGTH_ZERO,
    AAFF_NEGATIVE_SEEK,
+   AAFF_PAGE_TOO_LARGE,
+   AAFF_INDEX_INVALID,
+   AAFF_INDEX_FILE_CHANGED,
+   AAFF_INDEX_WRITE_FAILED,
+   AAFF_ERROR_PTHREAD,
    AAFF_ERROR_EIO_END,
 };
 
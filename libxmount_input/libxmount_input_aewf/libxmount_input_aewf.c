@@ -53,8 +53,16 @@
 #include <stdarg.h>     //lint !e537 !e451
 #include <errno.h>
 #include <pthread.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <stddef.h>
 
 #include "../libxmount_input.h"
+#include "../../libxmount/libxmount_inflate.h"
+
+#ifdef HAVE_LIBURING
+   #include <liburing.h>
+#endif
 
 #include "libxmount_input_aewf.h"
 
@@ -97,6 +105,12 @@
 #define AEWF_OPTION_STATSREFRESH    "aewfrefresh"
 #define AEWF_OPTION_LOG             "aewflog"
 #define AEWF_OPTION_THREADS         "aewfthreads"
+#define AEWF_OPTION_CHUNKCACHE      "aewfchunkcache"
+#define AEWF_OPTION_CHUNKINDEX      "aewfchunkindex"
+#define AEWF_OPTION_SIDECAR         "aewfsidecar"
+#define AEWF_OPTION_VERIFY          "aewfverify"
+#define AEWF_OPTION_READAHEAD       "aewfreadahead"
+#define AEWF_OPTION_URING           "aewfuring"
 
 static int         AewfClose           (void *pHandle);
 static const char* AewfGetErrorMessage (int ErrNum);
@@ -104,6 +118,8 @@ static const char* AewfGetErrorMessage (int ErrNum);
 const uint64_t AEWF_DEFAULT_TABLECACHE      = 10;  // MiB
 const uint64_t AEWF_DEFAULT_MAXOPENSEGMENTS = 10;
 const uint64_t AEWF_DEFAULT_STATSREFRESH    = 10;
+const uint64_t AEWF_DEFAULT_CHUNKCACHE      = 32;  // MiB
+const uint64_t AEWF_DEFAULT_READAHEAD       = 16;  // Chunks
 
 // ----------------------------
 //  Error handling and logging
@@ -273,49 +289,67 @@ static int wrap_uncompress (void *pDst, uint32_t *pDstLen, const void *pSrc, uin
 //         Internal functions
 // ------------------------------------
 
-static int OpenFile (FILE **ppFile, const char *pFilename, uint64_t *pFileSize)
+static int OpenFile (int *pFd, const char *pFilename, uint64_t *pFileSize)
 {
-   *ppFile = fopen (pFilename, "r");
-   if (*ppFile == NULL)
+   struct stat FileStat;
+
+   *pFd = open (pFilename, O_RDONLY);
+   if (*pFd < 0)
       return AEWF_FILE_OPEN_FAILED;
 
    if (pFileSize)
    {
-      fseek(*ppFile, 0 , SEEK_END);
-      *pFileSize = ftell(*ppFile);
-      fseek(*ppFile, 0 , SEEK_SET);
+      if (fstat (*pFd, &FileStat))
+      {
+         (void) close (*pFd);
+         *pFd = -1;
+         return AEWF_FILE_OPEN_FAILED;
+      }
+      *pFileSize = (uint64_t) FileStat.st_size;
    }
    return AEWF_OK;
 }
 
-static int CloseFile (FILE **ppFile)
+static int CloseFile (int *pFd)
 {
-   if (fclose (*ppFile))
+   int rc;
+
+   rc = close (*pFd);
+   *pFd = -1;             // The descriptor is gone even if close failed, callers must not close it again
+   if (rc)
       return AEWF_FILE_CLOSE_FAILED;
-   *ppFile = NULL;
 
    return AEWF_OK;
 }
 
-#define NO_SEEK ULLONG_MAX
+// ReadFilePos uses pread, it neither touches nor depends on a file position and
+// therefore may be called by several threads on the same file descriptor.
 
-static int ReadFilePos (t_pAewf pAewf, FILE *pFile, void *pMem, uint64_t Size, uint64_t Pos)
+static int ReadFilePos (t_pcAewf pAewf, int Fd, void *pMem, uint64_t Size, uint64_t Pos)
 {
-   if (Size == 0)
-      return AEWF_OK;
+   char    *pDst = (char *) pMem;
+   ssize_t   Read;
 
-   if (Pos != NO_SEEK)
+   while (Size)
    {
-      if (fseeko64 (pFile, Pos, SEEK_SET))
-         return AEWF_FILE_SEEK_FAILED;
+      Read = pread (Fd, pDst, Size, (off_t) Pos);
+      if (Read < 0)
+      {
+         if (errno == EINTR)
+            continue;
+         return AEWF_FILE_READ_FAILED;
+      }
+      if (Read == 0)    // Unexpected end of file
+         return AEWF_FILE_READ_FAILED;
+      pDst += Read;
+      Pos  += (uint64_t) Read;
+      Size -= (uint64_t) Read;
    }
-   if (fread (pMem, Size, 1UL, pFile) != 1)
-      return AEWF_FILE_READ_FAILED;
 
    return AEWF_OK;
 }
 
-static int ReadFileAllocPos (t_pAewf pAewf, FILE *pFile, void **ppMem, uint64_t Size, uint64_t Pos)
+static int ReadFileAllocPos (t_pAewf pAewf, int Fd, void **ppMem, uint64_t Size, uint64_t Pos)
 {
    *ppMem = NULL;
 
@@ -325,25 +359,11 @@ static int ReadFileAllocPos (t_pAewf pAewf, FILE *pFile, void **ppMem, uint64_t
       if (*ppMem == NULL)
          return AEWF_MEMALLOC_FAILED;
 
-      CHK (ReadFilePos (pAewf, pFile, *ppMem, Size, Pos))
+      CHK (ReadFilePos (pAewf, Fd, *ppMem, Size, Pos))
    }
    return AEWF_OK;
 }
 
-static int ReadFileAlloc (t_pAewf pAewf, FILE *pFile, void **ppMem, uint64_t Size)
-{
-   CHK (ReadFileAllocPos (pAewf, pFile, ppMem, Size, NO_SEEK))
-
-   return AEWF_OK;
-}
-
-static int QsortCompareSegments (const void *pA, const void *pB)
-{
-   const t_pSegment pSegmentA = ((const t_pSegment)pA); //lint !e1773 Attempt to cast way const
-   const t_pSegment pSegmentB = ((const t_pSegment)pB); //lint !e1773 Attempt to cast way const
-   return (int)pSegmentA->Number - (int)pSegmentB->Number;
-}
-
 static int CreateInfoData (t_pAewf pAewf, t_pAewfSectionVolume pVolume,
                                           char *pHeader , uint64_t HeaderLen,
                                           char *pHeader2, uint64_t Header2Len,
@@ -562,13 +582,47 @@ Leave:
    return rc;
 }
 
-static int AewfOpenSegment (t_pAewf pAewf, t_pTable pTable)
+// -----------
+//  LRU lists
+// -----------
+
+static inline void AewfLruUnlink (t_pAewfLru pLru, t_pAewfLruNode pNode)
+{
+   if (pNode->pPrev) pNode->pPrev->pNext = pNode->pNext;
+   else              pLru->pHead         = pNode->pNext;
+   if (pNode->pNext) pNode->pNext->pPrev = pNode->pPrev;
+   else              pLru->pTail         = pNode->pPrev;
+   pNode->pPrev = NULL;
+   pNode->pNext = NULL;
+}
+
+static inline void AewfLruPushFront (t_pAewfLru pLru, t_pAewfLruNode pNode)
+{
+   pNode->pPrev = NULL;
+   pNode->pNext = pLru->pHead;
+   if (pLru->pHead)
+        pLru->pHead->pPrev = pNode;
+   else pLru->pTail        = pNode;
+   pLru->pHead = pNode;
+}
+
+static inline void AewfLruTouch (t_pAewfLru pLru, t_pAewfLruNode pNode)
+{
+   if (pLru->pHead == pNode)
+      return;
+   AewfLruUnlink    (pLru, pNode);
+   AewfLruPushFront (pLru, pNode);
+}
+
+static int AewfOpenSegment (t_pAewf pAewf, t_pSegment pSegment)
 {
-   t_pSegment pOldestSegment;
+   t_pSegment     pOldestSegment;
+   t_pAewfLruNode pNode;
 
-   if (pTable->pSegment->pFile != NULL) // is already opened ?
+   if (pSegment->Fd >= 0) // is already opened ?
    {
       pAewf->SegmentCacheHits++;
+      AewfLruTouch (&pAewf->SegmentLru, &pSegment->Lru);
       return AEWF_OK;
    }
    pAewf->SegmentCacheMisses++;
@@ -577,38 +631,35 @@ static int AewfOpenSegment (t_pAewf pAewf, t_pTable pTable)
    // --------------------------------------------------
    while (pAewf->OpenSegments >= pAewf->MaxOpenSegments)
    {
+      // Worker threads may still be reading from a segment file; skip those. If all
+      // open files are busy, the limit is exceeded temporarily.
       pOldestSegment = NULL;
-
-      for (uint64_t i=0; i<pAewf->Segments; i++)
+      for (pNode = pAewf->SegmentLru.pTail; pNode; pNode = pNode->pPrev)
       {
-         if (pAewf->pSegmentArr[i].pFile == NULL)
-            continue;
-         if (pOldestSegment == NULL)
-         {
-            pOldestSegment = &pAewf->pSegmentArr[i];
-         }
-         else
+         if (__atomic_load_n (&AEWF_LRU_ENTRY (pNode, t_Segment)->Users, __ATOMIC_ACQUIRE) == 0)
          {
-            if (pAewf->pSegmentArr[i].LastUsed < pOldestSegment->LastUsed)
-               pOldestSegment = &pAewf->pSegmentArr[i];
+            pOldestSegment = AEWF_LRU_ENTRY (pNode, t_Segment);
+            break;
          }
       }
       if (pOldestSegment == NULL)
          break;
+      AewfLruUnlink (&pAewf->SegmentLru, &pOldestSegment->Lru);
 
       LOG ("Closing %s", pOldestSegment->pName);
-      CHK (CloseFile (&pOldestSegment->pFile))
+      CHK (CloseFile (&pOldestSegment->Fd))
       pAewf->OpenSegments--;
    }
 
    // Open the desired segment file
    // -----------------------------
    uint64_t FileSize;
-   LOG ("Opening %s", pTable->pSegment->pName);
-   CHK (OpenFile(&pTable->pSegment->pFile, pTable->pSegment->pName, &FileSize))
-   if (FileSize != pTable->pSegment->FileSize)
-      return AEWF_FILESIZE_CHANGED;
+   LOG ("Opening %s", pSegment->pName);
+   CHK (OpenFile(&pSegment->Fd, pSegment->pName, &FileSize))
    pAewf->OpenSegments++;
+   AewfLruPushFront (&pAewf->SegmentLru, &pSegment->Lru);
+   if (FileSize != pSegment->FileSize)
+      return AEWF_FILESIZE_CHANGED;
 
    return AEWF_OK;
 }
@@ -620,6 +671,7 @@ static int AewfLoadEwfTable (t_pAewf pAewf, t_pTable pTable)
    if (pTable->pEwfTable != NULL) // is already loaded?
    {
       pAewf->TableCacheHits++;
+      AewfLruTouch (&pAewf->TableLru, &pTable->Lru);
       return AEWF_OK;
    }
    pAewf->TableCacheMisses++;
@@ -628,24 +680,10 @@ static int AewfLoadEwfTable (t_pAewf pAewf, t_pTable pTable)
    // -------------------------------------------------
    while ((pAewf->TableCache + pTable->Size) > pAewf->MaxTableCache)
    {
-      pOldestTable = NULL;
-
-      for (uint64_t i=0; i<pAewf->Tables; i++)
-      {
-         if (pAewf->pTableArr[i].pEwfTable == NULL)
-            continue;
-         if (pOldestTable == NULL)
-         {
-            pOldestTable = &pAewf->pTableArr[i];
-         }
-         else
-         {
-            if (pAewf->pTableArr[i].LastUsed < pOldestTable->LastUsed)
-               pOldestTable = &pAewf->pTableArr[i];
-         }
-      }
-      if (pOldestTable == NULL)
+      if (pAewf->TableLru.pTail == NULL)
          break;
+      pOldestTable = AEWF_LRU_ENTRY (pAewf->TableLru.pTail, t_Table);
+      AewfLruUnlink (&pAewf->TableLru, &pOldestTable->Lru);
       pAewf->TableCache -= pOldestTable->Size;
       SAFE_FREE (pOldestTable->pEwfTable, pOldestTable->Size);
       LOG ("Releasing table %" PRIu64 " (%lu bytes)", pOldestTable->Nr, pOldestTable->Size);
@@ -654,14 +692,467 @@ static int AewfLoadEwfTable (t_pAewf pAewf, t_pTable pTable)
    // Read the desired table into RAM
    // -------------------------------
    LOG ("Loading table %" PRIu64 " (%lu bytes)", pTable->Nr, pTable->Size);
-   CHK (AewfOpenSegment (pAewf, pTable));
-   CHK (ReadFileAllocPos (pAewf, pTable->pSegment->pFile, (void**) &pTable->pEwfTable, pTable->Size, pTable->Offset))
+   CHK (AewfOpenSegment (pAewf, pTable->pSegment));
+   CHK (ReadFileAllocPos (pAewf, pTable->pSegment->Fd, (void**) &pTable->pEwfTable, pTable->Size, pTable->Offset))
+   if (pTable->pEwfTable->ChunkCount != pTable->ChunkCount)
+   {
+      LOG ("Error: Table %" PRIu64 " has %u chunks, expected %u", pTable->Nr, pTable->pEwfTable->ChunkCount, pTable->ChunkCount);
+      SAFE_FREE (pTable->pEwfTable, pTable->Size);
+      return AEWF_SECTION_TABLE_WRONG_SIZE;
+   }
+   AewfLruPushFront (&pAewf->TableLru, &pTable->Lru);
    pAewf->TableCache += pTable->Size;
    pAewf->TablesReadFromImage += pTable->Size;
 
    return AEWF_OK;
 }
 
+// AewfTableChunkPos calculates position, length and compression of a chunk's data from
+// the EWF table, which must be loaded.
+
+static void AewfTableChunkPos (t_pTable pTable, uint64_t TableChunk, uint64_t *pSeekPos, uint32_t *pReadLen, int *pCompressed)
+{
+   t_pAewfSectionTable pEwfTable = pTable->pEwfTable;
+   uint32_t             Offset;
+
+   *pCompressed = (pEwfTable->OffsetArray[TableChunk] & AEWF_COMPRESSED) != 0;
+   Offset       =  pEwfTable->OffsetArray[TableChunk] & ~AEWF_COMPRESSED;
+   *pSeekPos    =  pEwfTable->TableBaseOffset + Offset;
+
+   if (TableChunk < (pEwfTable->ChunkCount-1))
+        *pReadLen = (pEwfTable->OffsetArray[TableChunk+1] & ~AEWF_COMPRESSED) - Offset;
+   else *pReadLen = pTable->SectionSectorsSize - (*pSeekPos - pTable->SectionSectorsPos);
+//   else *pReadLen = pAewf->ChunkBuffSize;  // This also  works! It looks as if uncompress is able to find out by itself the real size of the input data. But this line could lead to reading beyond EOF...
+}
+
+// AewfBuildChunkIndex reads all EWF tables once and builds the flat chunk index from them. The
+// tables are released immediately afterwards, as they aren't needed any longer.
+
+static int AewfBuildChunkIndex (t_pAewf pAewf)
+{
+   t_pTable           pTable;
+   t_pAewfChunkIndex  pIndex;
+   uint64_t            SeekPos;
+   uint32_t            ReadLen;
+   int                 Compressed;
+
+   pAewf->pChunkIndexArr = (t_pAewfChunkIndex) malloc (pAewf->Chunks * sizeof(t_AewfChunkIndex));
+   if (pAewf->pChunkIndexArr == NULL)
+      return AEWF_MEMALLOC_FAILED;
+
+   for (uint64_t i=0; i<pAewf->Tables; i++)
+   {
+      pTable = &pAewf->pTableArr[i];
+      CHK (AewfLoadEwfTable (pAewf, pTable))
+      for (uint64_t TableChunk=0; TableChunk<pTable->ChunkCount; TableChunk++)
+      {
+         AewfTableChunkPos (pTable, TableChunk, &SeekPos, &ReadLen, &Compressed);
+         pIndex = &pAewf->pChunkIndexArr[pTable->ChunkFrom + TableChunk];
+         pIndex->Pos     = SeekPos | (Compressed ? AEWF_CHUNKINDEX_COMPRESSED : 0);
+         pIndex->Size    = ReadLen;
+         pIndex->Segment = (uint16_t) (pTable->pSegment - pAewf->pSegmentArr);
+      }
+      AewfLruUnlink (&pAewf->TableLru, &pTable->Lru);
+      pAewf->TableCache -= pTable->Size;
+      SAFE_FREE (pTable->pEwfTable, pTable->Size);
+   }
+   LOG ("Chunk index built, %" PRIu64 " chunks, %" PRIu64 " bytes", pAewf->Chunks, pAewf->Chunks * sizeof(t_AewfChunkIndex));
+
+   return AEWF_OK;
+}
+
+// AewfLocateChunk finds out where the data of a chunk lies in the image and makes sure
+// that the corresponding segment file is opened. It uses the flat chunk index if it
+// exists or the EWF tables otherwise.
+
+static int AewfLocateChunk (t_pAewf pAewf, uint64_t AbsoluteChunk, t_pSegment *ppSegment, uint64_t *pSeekPos, uint32_t *pReadLen, int *pCompressed)
+{
+   t_pAewfChunkIndex pIndex;
+   t_pTable          pTable;
+   uint64_t           TableChunk;
+   uint64_t           Lo, Hi, Mid;
+
+   if (AbsoluteChunk >= pAewf->Chunks)
+      CHK (AEWF_CHUNK_NOT_FOUND)
+
+   if (pAewf->pChunkIndexArr)
+   {
+      pIndex       = &pAewf->pChunkIndexArr[AbsoluteChunk];
+      *ppSegment   = &pAewf->pSegmentArr[pIndex->Segment];
+      *pSeekPos    =  pIndex->Pos & ~AEWF_CHUNKINDEX_COMPRESSED;
+      *pReadLen    =  pIndex->Size;
+      *pCompressed = (pIndex->Pos &  AEWF_CHUNKINDEX_COMPRESSED) != 0;
+   }
+   else
+   {
+      // Find table containing desired chunk (binary search, the tables are sorted by ChunkFrom)
+      // ---------------------------------------------------------------------------------------
+      Lo = 0;
+      Hi = pAewf->Tables-1;
+      while (Lo < Hi)
+      {
+         Mid = Lo + (Hi-Lo+1)/2;
+         if (pAewf->pTableArr[Mid].ChunkFrom <= AbsoluteChunk)
+              Lo = Mid;
+         else Hi = Mid-1;
+      }
+      pTable = &pAewf->pTableArr[Lo];
+      if ((AbsoluteChunk < pTable->ChunkFrom) ||
+          (AbsoluteChunk > pTable->ChunkTo))
+         CHK (AEWF_CHUNK_NOT_FOUND)
+
+      // Load corresponding table
+      // ------------------------
+      CHK (AewfLoadEwfTable (pAewf, pTable))
+      TableChunk = AbsoluteChunk - pTable->ChunkFrom;
+      if (TableChunk > UINT_MAX)
+         CHK (AEWF_ERROR_IN_CHUNK_NUMBER)
+//      LOG ("table %d / entry %" PRIu64 " (%s)", Lo, TableChunk, pTable->pSegment->pName)
+      AewfTableChunkPos (pTable, TableChunk, pSeekPos, pReadLen, pCompressed);
+      *ppSegment = pTable->pSegment;
+   }
+
+   if (*pReadLen > pAewf->ChunkBuffSize)
+   {
+      LOG ("Chunk too big %u / %u", *pReadLen, pAewf->ChunkBuffSize);
+      CHK (AEWF_CHUNK_TOO_BIG)
+   }
+   CHK (AewfOpenSegment (pAewf, *ppSegment))
+
+   return AEWF_OK;
+}
+
+// -------------
+//  Chunk cache
+// -------------
+
+static int AewfChunkCacheInit (t_pAewf pAewf)
+{
+   t_pAewfChunkCache pCache = &pAewf->ChunkCache;
+   t_pAewfCacheShard pShard;
+   uint64_t           TotalEntries;
+   uint32_t           Shards;
+
+   memset (pCache, 0, sizeof(t_AewfChunkCache));
+   TotalEntries = (pAewf->MaxChunkCache * 1024*1024) / pAewf->ChunkSize;
+   if (TotalEntries == 0)
+   {
+      LOG ("Chunk cache switched off");
+      return AEWF_OK;
+   }
+   Shards            = (uint32_t) GETMIN (TotalEntries, AEWF_CHUNKCACHE_SHARDS);
+   pCache->EntrySize = pAewf->ChunkSize;
+   pCache->pShardArr = (t_pAewfCacheShard) malloc (Shards * sizeof(t_AewfCacheShard));
+   if (pCache->pShardArr == NULL)
+      return AEWF_MEMALLOC_FAILED;
+   memset (pCache->pShardArr, 0, Shards * sizeof(t_AewfCacheShard));
+
+   for (uint32_t i=0; i<Shards; i++)  // pCache->Shards only counts the completely initialised shards, so
+   {                                  // that AewfChunkCacheDeInit knows what to clean up in case of an error
+      pShard = &pCache->pShardArr[i];
+      pShard->MaxEntries = TotalEntries / Shards;
+      pShard->HashSize   = pShard->MaxEntries;
+      pShard->ppHashArr  = (t_pAewfCacheEntry *) malloc (pShard->HashSize * sizeof(t_pAewfCacheEntry));
+      if (pShard->ppHashArr == NULL)
+         return AEWF_MEMALLOC_FAILED;
+      memset (pShard->ppHashArr, 0, pShard->HashSize * sizeof(t_pAewfCacheEntry));
+      if (pthread_mutex_init (&pShard->Mutex, NULL) != 0)
+      {
+         SAFE_FREE (pShard->ppHashArr);
+         return AEWF_ERROR_PTHREAD;
+      }
+      pCache->Shards++;
+   }
+   LOG ("Chunk cache: %u shards, %" PRIu64 " entries of %" PRIu64 " bytes", pCache->Shards, TotalEntries, pCache->EntrySize);
+
+   return AEWF_OK;
+}
+
+static void AewfChunkCacheDeInit (t_pAewfChunkCache pCache)
+{
+   t_pAewfCacheShard pShard;
+   t_pAewfCacheEntry pEntry;
+
+   if (pCache->pShardArr == NULL)
+      return;
+   for (uint32_t i=0; i<pCache->Shards; i++)
+   {
+      pShard = &pCache->pShardArr[i];
+      while (pShard->pHead)
+      {
+         pEntry = pShard->pHead;
+         pShard->pHead = pEntry->pNext;
+         SAFE_FREE (pEntry->pData, pCache->EntrySize);
+         SAFE_FREE (pEntry);
+      }
+      SAFE_FREE (pShard->ppHashArr);
+      (void) pthread_mutex_destroy (&pShard->Mutex);
+   }
+   SAFE_FREE (pCache->pShardArr);
+   pCache->Shards = 0;
+}
+
+static inline t_pAewfCacheShard AewfChunkCacheShard (t_pAewfChunkCache pCache, uint64_t Chunk, t_pAewfCacheEntry **pppBucket)
+{
+   t_pAewfCacheShard pShard = &pCache->pShardArr[Chunk % pCache->Shards];
+
+   *pppBucket = &pShard->ppHashArr[(Chunk / pCache->Shards) % pShard->HashSize];
+   return pShard;
+}
+
+// The LRU list functions below must be called with the shard's mutex locked
+
+static inline void AewfChunkCacheUnlink (t_pAewfCacheShard pShard, t_pAewfCacheEntry pEntry)
+{
+   if (pEntry->pPrev) pEntry->pPrev->pNext = pEntry->pNext;
+   else               pShard->pHead        = pEntry->pNext;
+   if (pEntry->pNext) pEntry->pNext->pPrev = pEntry->pPrev;
+   else               pShard->pTail        = pEntry->pPrev;
+}
+
+static inline void AewfChunkCachePushFront (t_pAewfCacheShard pShard, t_pAewfCacheEntry pEntry)
+{
+   pEntry->pPrev = NULL;
+   pEntry->pNext = pShard->pHead;
+   if (pShard->pHead)
+        pShard->pHead->pPrev = pEntry;
+   else pShard->pTail        = pEntry;
+   pShard->pHead = pEntry;
+}
+
+// AewfChunkCacheGet copies Len bytes, starting at chunk offset Ofs, of the given chunk to pDst
+// if the chunk is in the cache. It returns TRUE in that case and the number of bytes copied
+// in pCopied (which is less than Len if the chunk is shorter).
+
+static int AewfChunkCacheGet (t_pAewfChunkCache pCache, uint64_t Chunk, char *pDst, uint64_t Ofs, uint64_t Len, uint64_t *pCopied)
+{
+   t_pAewfCacheShard   pShard;
+   t_pAewfCacheEntry  *ppBucket;
+   t_pAewfCacheEntry   pEntry;
+
+   if (pCache->pShardArr == NULL)
+      return FALSE;
+
+   pShard = AewfChunkCacheShard (pCache, Chunk, &ppBucket);
+   (void) pthread_mutex_lock (&pShard->Mutex);
+   for (pEntry = *ppBucket; pEntry; pEntry = pEntry->pHashNext)
+   {
+      if (pEntry->Chunk == Chunk)
+         break;
+   }
+   if ((pEntry == NULL) || (Ofs > pEntry->Len))
+   {
+      pShard->Misses++;
+      (void) pthread_mutex_unlock (&pShard->Mutex);
+      return FALSE;
+   }
+   pShard->Hits++;
+   *pCopied = GETMIN (Len, pEntry->Len - Ofs);
+   memcpy (pDst, pEntry->pData + Ofs, *pCopied);
+   AewfChunkCacheUnlink    (pShard, pEntry);
+   AewfChunkCachePushFront (pShard, pEntry);
+   (void) pthread_mutex_unlock (&pShard->Mutex);
+
+   return TRUE;
+}
+
+// AewfChunkCacheHas checks if the chunk is in the cache, without counting hits or misses
+// and without touching the LRU list.
+
+static int AewfChunkCacheHas (t_pAewfChunkCache pCache, uint64_t Chunk)
+{
+   t_pAewfCacheShard   pShard;
+   t_pAewfCacheEntry  *ppBucket;
+   t_pAewfCacheEntry   pEntry;
+
+   if (pCache->pShardArr == NULL)
+      return FALSE;
+
+   pShard = AewfChunkCacheShard (pCache, Chunk, &ppBucket);
+   (void) pthread_mutex_lock (&pShard->Mutex);
+   for (pEntry = *ppBucket; pEntry; pEntry = pEntry->pHashNext)
+   {
+      if (pEntry->Chunk == Chunk)
+         break;
+   }
+   (void) pthread_mutex_unlock (&pShard->Mutex);
+
+   return (pEntry != NULL);
+}
+
+// AewfChunkCachePut stores a copy of the given chunk data in the cache. If the shard is full, its least
+// recently used entry is recycled. The cache is a pure optimisation, so a failing memory allocation
+// is not reported as an error.
+
+static void AewfChunkCachePut (t_pAewfChunkCache pCache, uint64_t Chunk, const char *pData, uint64_t Len)
+{
+   t_pAewfCacheShard   pShard;
+   t_pAewfCacheEntry  *ppBucket;
+   t_pAewfCacheEntry  *ppLink;
+   t_pAewfCacheEntry   pEntry;
+
+   if ((pCache->pShardArr == NULL) || (Len > pCache->EntrySize))
+      return;
+
+   pShard = AewfChunkCacheShard (pCache, Chunk, &ppBucket);
+   (void) pthread_mutex_lock (&pShard->Mutex);
+   for (pEntry = *ppBucket; pEntry; pEntry = pEntry->pHashNext)
+   {
+      if (pEntry->Chunk == Chunk)      // Already cached (possibly put by another thread meanwhile)
+      {
+         AewfChunkCacheUnlink    (pShard, pEntry);
+         AewfChunkCachePushFront (pShard, pEntry);
+         (void) pthread_mutex_unlock (&pShard->Mutex);
+         return;
+      }
+   }
+
+   if (pShard->Entries < pShard->MaxEntries)
+   {
+      pEntry = (t_pAewfCacheEntry) malloc (sizeof(t_AewfCacheEntry));
+      if (pEntry)
+      {
+         pEntry->pData = (char *) malloc (pCache->EntrySize);
+         if (pEntry->pData == NULL)
+            SAFE_FREE (pEntry);
+      }
+      if (pEntry == NULL)
+      {
+         (void) pthread_mutex_unlock (&pShard->Mutex);
+         return;
+      }
+      pShard->Entries++;
+   }
+   else
+   {
+      pEntry = pShard->pTail;                      // Recycle the least recently used entry
+      AewfChunkCacheUnlink (pShard, pEntry);
+      t_pAewfCacheEntry *ppOldBucket;
+      (void) AewfChunkCacheShard (pCache, pEntry->Chunk, &ppOldBucket);
+      for (ppLink = ppOldBucket; *ppLink != pEntry; ppLink = &(*ppLink)->pHashNext)
+         ;
+      *ppLink = pEntry->pHashNext;
+   }
+
+   pEntry->Chunk = Chunk;
+   pEntry->Len   = Len;
+   memcpy (pEntry->pData, pData, Len);
+   pEntry->pHashNext = *ppBucket;
+   *ppBucket         =  pEntry;
+   AewfChunkCachePushFront (pShard, pEntry);
+   (void) pthread_mutex_unlock (&pShard->Mutex);
+}
+
+static void AewfChunkCacheCounters (t_pAewfChunkCache pCache, uint64_t *pHits, uint64_t *pMisses, uint64_t *pEntries)
+{
+   t_pAewfCacheShard pShard;
+
+   *pHits    = 0;
+   *pMisses  = 0;
+   *pEntries = 0;
+   for (uint32_t i=0; i<pCache->Shards; i++)
+   {
+      pShard = &pCache->pShardArr[i];
+      (void) pthread_mutex_lock (&pShard->Mutex);
+      *pHits    += pShard->Hits;
+      *pMisses  += pShard->Misses;
+      *pEntries += pShard->Entries;
+      (void) pthread_mutex_unlock (&pShard->Mutex);
+   }
+}
+
+// -------------
+//  Zero chunks
+// -------------
+
+static int AewfZeroChunksInit (t_pAewf pAewf)
+{
+   t_pAewfZeroChunks pZero = &pAewf->ZeroChunks;
+
+   memset (pZero, 0, sizeof(t_AewfZeroChunks));
+   if (pthread_mutex_init (&pZero->Mutex, NULL) != 0)
+      return AEWF_ERROR_PTHREAD;
+   pZero->BitmapSize = (pAewf->Chunks + 7) / 8;
+   pZero->pBitmap    = (uint8_t *) malloc (GETMAX (pZero->BitmapSize, 1));
+   if (pZero->pBitmap == NULL)                // pBitmap only is set if the mutex
+   {                                          // is initialised, too
+      (void) pthread_mutex_destroy (&pZero->Mutex);
+      return AEWF_MEMALLOC_FAILED;
+   }
+   memset (pZero->pBitmap, 0, pZero->BitmapSize);
+
+   return AEWF_OK;
+}
+
+static void AewfZeroChunksDeInit (t_pAewfZeroChunks pZero)
+{
+   if (pZero->pBitmap == NULL)
+      return;
+   SAFE_FREE (pZero->pBitmap, pZero->BitmapSize);
+   (void) pthread_mutex_destroy (&pZero->Mutex);
+}
+
+// The bitmap is written by the workers, hence the atomic accesses
+
+static inline int AewfZeroChunkKnown (t_pAewfZeroChunks pZero, uint64_t Chunk)
+{
+   return (__atomic_load_n (&pZero->pBitmap[Chunk/8], __ATOMIC_RELAXED) & (1 << (Chunk%8))) != 0;
+}
+
+static void AewfZeroChunkMark (t_pAewfZeroChunks pZero, uint64_t Chunk)
+{
+   uint8_t Old;
+
+   Old = __atomic_fetch_or (&pZero->pBitmap[Chunk/8], (uint8_t)(1 << (Chunk%8)), __ATOMIC_RELAXED);
+   if ((Old & (1 << (Chunk%8))) == 0)
+      (void) __atomic_add_fetch (&pZero->Found, 1, __ATOMIC_RELAXED);
+}
+
+static inline int AewfIsZeroData (const char *pData, uint64_t Len)
+{
+   if (Len == 0)
+      return TRUE;
+   return (pData[0] == 0) && (memcmp (pData, pData+1, Len-1) == 0);
+}
+
+// AewfZeroSignatureMatch checks if the given compressed chunk data is identical to that
+// of a zero chunk seen before. Signatures never change once they have been added.
+
+static int AewfZeroSignatureMatch (t_pAewfZeroChunks pZero, const char *pCompressed, uint64_t Len)
+{
+   uint32_t Signatures;
+
+   Signatures = __atomic_load_n (&pZero->Signatures, __ATOMIC_ACQUIRE);
+   for (uint32_t i=0; i<Signatures; i++)
+   {
+      if ((pZero->SignatureLenArr[i] == Len) && (memcmp (pZero->SignatureArr[i], pCompressed, Len) == 0))
+         return TRUE;
+   }
+   return FALSE;
+}
+
+// AewfZeroChunkLearn is called for a compressed chunk that has been found to be zero after
+// decompression. It marks the chunk and adds its compressed data as new signature.
+
+static void AewfZeroChunkLearn (t_pAewfZeroChunks pZero, uint64_t Chunk, const char *pCompressed, uint64_t Len)
+{
+   uint32_t Signatures;
+
+   AewfZeroChunkMark (pZero, Chunk);
+   if ((Len > AEWF_ZERO_SIGNATURE_MAXLEN) || AewfZeroSignatureMatch (pZero, pCompressed, Len))
+      return;
+
+   (void) pthread_mutex_lock (&pZero->Mutex);
+   Signatures = pZero->Signatures;
+   if ((Signatures < AEWF_ZERO_SIGNATURES) && !AewfZeroSignatureMatch (pZero, pCompressed, Len))
+   {
+      memcpy (pZero->SignatureArr[Signatures], pCompressed, Len);
+      pZero->SignatureLenArr[Signatures] = (uint32_t) Len;
+      __atomic_store_n (&pZero->Signatures, Signatures+1, __ATOMIC_RELEASE);
+   }
+   (void) pthread_mutex_unlock (&pZero->Mutex);
+}
+
 static int UpdateStats (t_pAewf pAewf, int Force)
 {
    time_t   NowT;
@@ -669,6 +1160,7 @@ static int UpdateStats (t_pAewf pAewf, int Force)
    FILE   *pFile           = NULL;
    char   *pFilename       = NULL;
    char   *pCurrentWorkDir = NULL;
+   uint64_t LruHits, LruMisses, LruEntries;
    int      rc;
 
    if (pAewf->pStatsPath)
@@ -690,13 +1182,23 @@ static int UpdateStats (t_pAewf pAewf, int Force)
 
          fprintf (pFile, "Image segment files     %6"PRIu64"\n" , pAewf->Segments);
          fprintf (pFile, "Image tables            %6"PRIu64"\n" , pAewf->Tables);
+         fprintf (pFile, "Inflate backend         %s\n"         , XmountInflateBackend());
+         fprintf (pFile, "Adler-32 backend        %s\n"         , XmountAdler32Backend());
+         fprintf (pFile, "Chunk read backend      %s\n"         , pAewf->Uring.Active ? "io_uring" : "pread");
          fprintf (pFile, "\n");
          fprintf (pFile, "Cache         hits      misses  ratio\n");
          fprintf (pFile, "--------------------------------------\n");
          fprintf (pFile, "Segment %10" PRIu64 "  %10" PRIu64 "  %5.1f%%\n", pAewf->SegmentCacheHits, pAewf->SegmentCacheMisses, (100.0*pAewf->SegmentCacheHits)/(pAewf->SegmentCacheHits+pAewf->SegmentCacheMisses));
          fprintf (pFile, "Table   %10" PRIu64 "  %10" PRIu64 "  %5.1f%%\n", pAewf->TableCacheHits  , pAewf->TableCacheMisses  , (100.0*pAewf->TableCacheHits)  /(pAewf->TableCacheHits  +pAewf->TableCacheMisses  ));
          fprintf (pFile, "Chunk   %10" PRIu64 "  %10" PRIu64 "  %5.1f%%\n", pAewf->ChunkCacheHits  , pAewf->ChunkCacheMisses  , (100.0*pAewf->ChunkCacheHits)  /(pAewf->ChunkCacheHits  +pAewf->ChunkCacheMisses  ));
+         AewfChunkCacheCounters (&pAewf->ChunkCache, &LruHits, &LruMisses, &LruEntries);
+         fprintf (pFile, "LRU     %10" PRIu64 "  %10" PRIu64 "  %5.1f%%\n", LruHits                , LruMisses                , (100.0*LruHits)                /(LruHits                +LruMisses                ));
          fprintf (pFile, "\n");
+         fprintf (pFile, "Zero chunks found        %10" PRIu64 "\n", __atomic_load_n (&pAewf->ZeroChunks.Found, __ATOMIC_RELAXED));
+         fprintf (pFile, "Zero chunk reads         %10" PRIu64 "\n", pAewf->ZeroChunkReads);
+         fprintf (pFile, "Readahead chunks         %10" PRIu64 "\n", pAewf->ReadaheadChunks);
+         fprintf (pFile, "io_uring chunk reads     %10" PRIu64 "\n", pAewf->UringReads);
+         fprintf (pFile, "io_uring batches         %10" PRIu64 "\n", pAewf->UringBatches);
          fprintf (pFile, "Read operations          %10" PRIu64 "\n", pAewf->ReadOperations);
          fprintf (pFile, "Errors                   %10" PRIu64 "\n", pAewf->Errors);
          fprintf (pFile, "Open segment files       %10" PRIu64"\n" , pAewf->OpenSegments);
@@ -707,6 +1209,8 @@ static int UpdateStats (t_pAewf pAewf, int Force)
          fprintf (pFile, "Tables read from image   %10.1f MiB\n"             , pAewf->TablesReadFromImage  / (1024.0*1024.0));
          fprintf (pFile, "RAM used as table cache  %10.1f MiB\n"             , pAewf->TableCache           / (1024.0*1024.0));
          fprintf (pFile, "Size of all image tables %10.1f MiB\n"             , pAewf->TotalTableSize       / (1024.0*1024.0));
+         fprintf (pFile, "RAM used as chunk cache  %10.1f MiB\n"             , (LruEntries * pAewf->ChunkCache.EntrySize) / (1024.0*1024.0));
+         fprintf (pFile, "RAM used as chunk index  %10.1f MiB\n"             , (pAewf->pChunkIndexArr ? pAewf->Chunks * sizeof (t_AewfChunkIndex) : 0) / (1024.0*1024.0));
          fprintf (pFile, "\n");
          fprintf (pFile, "Histogram of read request sizes\n");
          fprintf (pFile, "-------------------------------\n");
@@ -735,73 +1239,91 @@ Leave:
    return rc;
 }
 
+// AewfChunkLen returns the length of the uncompressed data of a chunk. The very last chunk
+// of the image may be smaller than the default chunk size if the image isn't a multiple of
+// the chunk size.
+static inline uint64_t AewfChunkLen (t_pcAewf pAewf, uint64_t AbsoluteChunk)
+{
+   uint64_t Len;
+
+   if (AbsoluteChunk != (pAewf->Chunks-1))
+      return pAewf->ChunkSize;
+   Len = pAewf->ImageSize % pAewf->ChunkSize;
+   return (Len == 0) ? pAewf->ChunkSize : Len;
+}
+
+// AewfVerifyChunk tells whether the checksum of the given chunk should be verified
+// when reading it from the image, depending on option aewfverify. Sampling is based on
+// the chunk number, so a chunk is either always or never verified.
+static inline int AewfVerifyChunk (t_pcAewf pAewf, uint64_t AbsoluteChunk)
+{
+   switch (pAewf->Verify)
+   {
+      case AEWF_VERIFY_OFF    : return FALSE;
+      case AEWF_VERIFY_SAMPLED: return (AbsoluteChunk % AEWF_VERIFY_SAMPLE_INTERVAL) == 0;
+      case AEWF_VERIFY_FULL   :
+      default                 : return TRUE;
+   }
+}
+
 // -----------------------------------------------------------------------------
 //  Legacy functions - Single threaded read function from former xmount version
 // -----------------------------------------------------------------------------
 
-// AewfReadChunkLegacy0 reads exactly one chunk. It expects the EWF table be present
-// in memory and the required segment be opened.
+// AewfReadChunkLegacy0 reads exactly one chunk. It expects the required segment be opened.
 
-static int AewfReadChunkLegacy0 (t_pAewf pAewf, t_pTable pTable, uint64_t AbsoluteChunk, uint64_t TableChunk)
+static int AewfReadChunkLegacy0 (t_pAewf pAewf, t_pSegment pSegment, uint64_t AbsoluteChunk, uint64_t SeekPos, uint32_t ReadLen, int Compressed)
 {
-   int                  Compressed;
-   uint64_t             SeekPos;
-   t_pAewfSectionTable pEwfTable;
-   uint32_t             Offset;
-   uint32_t             ReadLen;
-   uLongf               DstLen0;
+   uint64_t             DstLen;
    int                  zrc;
    uint32_t             CalcCRC;
    uint32_t           *pStoredCRC;
    uint64_t             ChunkSize;
+   int                  Verify;
    int                  Ret = AEWF_OK;
 
-   pEwfTable  = pTable->pEwfTable;
-   if (pEwfTable == NULL)
-      return AEWF_ERROR_EWF_TABLE_NOT_READY;
-   if (pTable->pSegment->pFile == NULL)
+   if (pSegment->Fd < 0)
       return AEWF_ERROR_EWF_SEGMENT_NOT_READY;
 
-   Compressed = pEwfTable->OffsetArray[TableChunk] &  AEWF_COMPRESSED;
-   Offset     = pEwfTable->OffsetArray[TableChunk] & ~AEWF_COMPRESSED;
-   SeekPos    = pEwfTable->TableBaseOffset + Offset;
-
-   if (TableChunk < (pEwfTable->ChunkCount-1))
-        ReadLen = (pEwfTable->OffsetArray[TableChunk+1] & ~AEWF_COMPRESSED) - Offset;
-   else ReadLen = pTable->SectionSectorsSize - (SeekPos - pTable->SectionSectorsPos);
-//   else ReadLen = pAewf->ChunkBuffSize;  // This also  works! It looks as if uncompress is able to find out by itself the real size of the input data. But this line could lead to reading beyond EOF...
-
-   if (ReadLen > pAewf->ChunkBuffSize)
-   {
-      LOG ("Chunk too big %u / %u", ReadLen, pAewf->ChunkBuffSize);
-      return AEWF_CHUNK_TOO_BIG;
-   }
+   ChunkSize = AewfChunkLen (pAewf, AbsoluteChunk);
 
-   ChunkSize = pAewf->ChunkSize;
-   if (AbsoluteChunk == (pAewf->Chunks-1))   // The very last chunk of the image may be smaller than the default
-   {                                         // chunk size if the image isn't a multiple of the chunk size.
-      ChunkSize = pAewf->ImageSize % pAewf->ChunkSize;
-      if (ChunkSize == 0)
-         ChunkSize = pAewf->ChunkSize;
-   }
+   Verify = AewfVerifyChunk (pAewf, AbsoluteChunk);
+   if (Verify)
+      pAewf->ChunksVerified++;
 
    if (Compressed)
    {
-      CHK (ReadFilePos (pAewf, pTable->pSegment->pFile, pAewf->pChunkBuffCompressed, ReadLen, SeekPos))
-      DstLen0 = pAewf->ChunkBuffSize;
-      zrc = uncompress ((unsigned char*)pAewf->pChunkBuffUncompressed, &DstLen0, (const Bytef*)pAewf->pChunkBuffCompressed, ReadLen);
-      if (zrc != Z_OK)
-         Ret = AEWF_UNCOMPRESS_FAILED;
-      if (DstLen0 != ChunkSize)
-         Ret = AEWF_BAD_UNCOMPRESSED_LENGTH;
+      CHK (ReadFilePos (pAewf, pSegment->Fd, pAewf->pChunkBuffCompressed, ReadLen, SeekPos))
+      if (AewfZeroSignatureMatch (&pAewf->ZeroChunks, pAewf->pChunkBuffCompressed, ReadLen))
+      {
+         memset (pAewf->pChunkBuffUncompressed, 0, ChunkSize);
+         AewfZeroChunkMark (&pAewf->ZeroChunks, AbsoluteChunk);
+      }
+      else
+      {
+         DstLen = pAewf->ChunkBuffSize;
+         zrc = XmountInflate (&pAewf->Inflate, Verify ? XmountInflateFormat_Zlib : XmountInflateFormat_ZlibUnchecked,
+                              pAewf->pChunkBuffUncompressed, &DstLen, pAewf->pChunkBuffCompressed, ReadLen);
+         if (zrc != Z_OK)
+            Ret = AEWF_UNCOMPRESS_FAILED;
+         if (DstLen != ChunkSize)
+            Ret = AEWF_BAD_UNCOMPRESSED_LENGTH;
+         if ((Ret == AEWF_OK) && (ReadLen <= AEWF_ZERO_SIGNATURE_MAXLEN) && AewfIsZeroData (pAewf->pChunkBuffUncompressed, ChunkSize))
+            AewfZeroChunkLearn (&pAewf->ZeroChunks, AbsoluteChunk, pAewf->pChunkBuffCompressed, ReadLen);
+      }
    }
    else
    {
-      CHK (ReadFilePos (pAewf, pTable->pSegment->pFile, pAewf->pChunkBuffUncompressed, ReadLen, SeekPos))
-      CalcCRC    =  adler32 (1, (const Bytef *) pAewf->pChunkBuffUncompressed, ChunkSize);
-      pStoredCRC = (uint32_t *) (pAewf->pChunkBuffUncompressed + ChunkSize);  //lint !e826 Suspicious pointer-to-pointer conversion (area too small)
-      if (CalcCRC != *pStoredCRC)
-         Ret = AEWF_CHUNK_CRC_ERROR;
+      CHK (ReadFilePos (pAewf, pSegment->Fd, pAewf->pChunkBuffUncompressed, ReadLen, SeekPos))
+      if (Verify)
+      {
+         CalcCRC    = XmountAdler32 (1, pAewf->pChunkBuffUncompressed, ChunkSize);
+         pStoredCRC = (uint32_t *) (pAewf->pChunkBuffUncompressed + ChunkSize);  //lint !e826 Suspicious pointer-to-pointer conversion (area too small)
+         if (CalcCRC != *pStoredCRC)
+            Ret = AEWF_CHUNK_CRC_ERROR;
+      }
+      if ((Ret == AEWF_OK) && AewfIsZeroData (pAewf->pChunkBuffUncompressed, ChunkSize))
+         AewfZeroChunkMark (&pAewf->ZeroChunks, AbsoluteChunk);
    }
 
    pAewf->DataReadFromImage    += ReadLen;
@@ -821,10 +1343,10 @@ static int AewfReadChunkLegacy0 (t_pAewf pAewf, t_pTable pTable, uint64_t Absolu
 
 static int AewfReadChunkLegacy (t_pAewf pAewf, uint64_t AbsoluteChunk, char **ppBuffer, uint64_t *pLen)
 {
-   t_pTable  pTable;
-   int        Found=FALSE;
-   uint64_t   TableChunk;
-   uint64_t   TableNr;
+   t_pSegment pSegment;
+   uint64_t   SeekPos;
+   uint32_t   ReadLen;
+   int        Compressed;
 
    *ppBuffer = pAewf->pChunkBuffUncompressed;
    *pLen     = 0;
@@ -837,32 +1359,28 @@ static int AewfReadChunkLegacy (t_pAewf pAewf, uint64_t AbsoluteChunk, char **pp
    }
    pAewf->ChunkCacheMisses++;
 
-   // Find table containing desired chunk
-   // -----------------------------------
-   for (TableNr=0; TableNr<pAewf->Tables; TableNr++)
+   if (AewfZeroChunkKnown (&pAewf->ZeroChunks, AbsoluteChunk))
    {
-      pTable = &pAewf->pTableArr[TableNr];
-      Found  = (AbsoluteChunk >= pTable->ChunkFrom) &&
-               (AbsoluteChunk <= pTable->ChunkTo);
-      if (Found)
-         break;
+      *pLen = AewfChunkLen (pAewf, AbsoluteChunk);
+      memset (pAewf->pChunkBuffUncompressed, 0, *pLen);
+      pAewf->ChunkInBuff                  = AbsoluteChunk;
+      pAewf->ChunkBuffUncompressedDataLen = *pLen;
+      pAewf->ZeroChunkReads++;
+      return AEWF_OK;
+   }
+
+   if (AewfChunkCacheGet (&pAewf->ChunkCache, AbsoluteChunk, pAewf->pChunkBuffUncompressed, 0, pAewf->ChunkSize, pLen))
+   {
+      pAewf->ChunkInBuff                  = AbsoluteChunk;
+      pAewf->ChunkBuffUncompressedDataLen = *pLen;
+      return AEWF_OK;
    }
-   if (!Found)
-      CHK (AEWF_CHUNK_NOT_FOUND)
 
-   // Load corresponding table and get chunk
-   // --------------------------------------
-   pTable->LastUsed = time(NULL);                  //lint !e771 pTable' (line 640) conceivably not initialized
-   pTable->pSegment->LastUsed = pTable->LastUsed;  // Update LastUsed here, in order not to remove the required data from cache
-
-   CHK (AewfLoadEwfTable (pAewf, pTable))
-   CHK (AewfOpenSegment  (pAewf, pTable));
-   if ((AbsoluteChunk - pTable->ChunkFrom) > UINT_MAX)
-      CHK (AEWF_ERROR_IN_CHUNK_NUMBER)
-   TableChunk = AbsoluteChunk - pTable->ChunkFrom;
-//   LOG ("table %d / entry %" PRIu64 " (%s)", TableNr, TableChunk, pTable->pSegment->pName)
-   CHK (AewfReadChunkLegacy0 (pAewf, pTable, AbsoluteChunk, TableChunk))
+   CHK (AewfLocateChunk      (pAewf, AbsoluteChunk, &pSegment, &SeekPos, &ReadLen, &Compressed))
+   CHK (AewfReadChunkLegacy0 (pAewf, pSegment, AbsoluteChunk, SeekPos, ReadLen, Compressed))
    *pLen = pAewf->ChunkBuffUncompressedDataLen;
+   if (!AewfZeroChunkKnown (&pAewf->ZeroChunks, AbsoluteChunk))  // No need to waste cache memory for zero chunks
+      AewfChunkCachePut (&pAewf->ChunkCache, AbsoluteChunk, pAewf->pChunkBuffUncompressed, *pLen);
 
    return AEWF_OK;
 }
@@ -900,43 +1418,92 @@ static int AewfReadLegacy (t_pAewf pAewf, char *pBuf, uint64_t Seek64, size_t Co
 //  MT functions - Read function with multi-threaded decompression and CRC calculation
 // ------------------------------------------------------------------------------------
 
-// AewfThreadUncompress is run whenever compressed data chunk are encountered. It uncompresses
-// the data and copies it to the correct destination.
+// AewfThreadReadChunk reads the chunk data from the segment file into pDst. As it uses
+// pread on the segment's file descriptor, all workers may read concurrently. The part
+// already read by the io_uring (PreRead) is skipped. The segment's user count is released
+// afterwards, allowing the reading thread to close the file again.
+static int AewfThreadReadChunk (t_pAewfThread pThread, char *pDst)
+{
+   int rc;
+
+   rc = ReadFilePos (pThread->pAewf, pThread->pSegment->Fd, pDst                       + pThread->PreRead,
+                                                            pThread->ChunkBuffCompressedDataLen - pThread->PreRead,
+                                                            pThread->SeekPos                    + pThread->PreRead);
+   (void) __atomic_sub_fetch (&pThread->pSegment->Users, 1, __ATOMIC_RELEASE);
+
+   return rc;
+}
+
+// AewfThreadUncompress is run whenever compressed data chunk are encountered. It reads and
+// uncompresses the data and copies it to the correct destination.
 static void* AewfThreadUncompress (void *pArg)
 {
    t_pAewfThread pThread = (t_pAewfThread) pArg;
-   uLongf         DstLen0;
+   uint64_t       DstLen;
    int            zrc;
 
-   pThread->ReturnCode = AEWF_OK;
-   DstLen0 = pThread->pAewf->ChunkBuffSize;
-   zrc = uncompress ((unsigned char*)pThread->pChunkBuffUncompressed, &DstLen0,
-                       (const Bytef*)pThread->pChunkBuffCompressed  ,
-                                     pThread->ChunkBuffCompressedDataLen);
+   pThread->ReturnCode = AewfThreadReadChunk (pThread, pThread->pChunkBuffCompressed);
+   if (pThread->ReturnCode != AEWF_OK)
+      return NULL;
+
+   if (AewfZeroSignatureMatch (pThread->pZeroChunks, pThread->pChunkBuffCompressed, pThread->ChunkBuffCompressedDataLen))
+   {
+      memset (pThread->pChunkBuffUncompressed, 0, pThread->ChunkBuffUncompressedDataLen);  // No need to inflate
+      AewfZeroChunkMark (pThread->pZeroChunks, pThread->ChunkInBuff);
+      if (pThread->pBuf)
+         memset (pThread->pBuf, 0, pThread->Len);
+      return NULL;
+   }
+
+   DstLen = pThread->pAewf->ChunkBuffSize;
+   zrc = XmountInflate (&pThread->Inflate, pThread->Verify ? XmountInflateFormat_Zlib : XmountInflateFormat_ZlibUnchecked,
+                         pThread->pChunkBuffUncompressed, &DstLen,
+                         pThread->pChunkBuffCompressed  ,
+                         pThread->ChunkBuffCompressedDataLen);
    if (zrc != Z_OK)
       pThread->ReturnCode = AEWF_UNCOMPRESS_FAILED;
-   else if (DstLen0 != pThread->ChunkBuffUncompressedDataLen)
+   else if (DstLen != pThread->ChunkBuffUncompressedDataLen)
       pThread->ReturnCode = AEWF_BAD_UNCOMPRESSED_LENGTH;
    else
-      memcpy (pThread->pBuf, pThread->pChunkBuffUncompressed+pThread->Ofs, pThread->Len);
+   {
+      if (pThread->pBuf)
+         memcpy (pThread->pBuf, pThread->pChunkBuffUncompressed+pThread->Ofs, pThread->Len);
+      if ((pThread->ChunkBuffCompressedDataLen <= AEWF_ZERO_SIGNATURE_MAXLEN) &&
+          AewfIsZeroData (pThread->pChunkBuffUncompressed, pThread->ChunkBuffUncompressedDataLen))
+           AewfZeroChunkLearn (pThread->pZeroChunks, pThread->ChunkInBuff, pThread->pChunkBuffCompressed, pThread->ChunkBuffCompressedDataLen);
+      else AewfChunkCachePut  (pThread->pChunkCache, pThread->ChunkInBuff, pThread->pChunkBuffUncompressed, pThread->ChunkBuffUncompressedDataLen);
+   }
 
    return NULL;
 }
 
-// AewfThreadCRC is called for uncompressed data chunks. It verifies the CRC and
-// copies the data to the correct destination.
+// AewfThreadCRC is called for uncompressed data chunks. It reads the chunk, verifies the
+// CRC (if requested) and copies the data to the correct destination.
 static void* AewfThreadCRC (void *pArg)
 {
    t_pAewfThread  pThread = (t_pAewfThread) pArg;
    uint32_t      *pStoredCRC;
    uint32_t        CalcCRC;
 
-   pThread->ReturnCode = AEWF_OK;
-   CalcCRC    =  adler32 (1, (const Bytef *) pThread->pChunkBuffUncompressed, pThread->ChunkBuffUncompressedDataLen);
-   pStoredCRC = (uint32_t *) (pThread->pChunkBuffUncompressed + pThread->ChunkBuffUncompressedDataLen);  //lint !e826 Suspicious pointer-to-pointer conversion (area too small)
-   if (CalcCRC != *pStoredCRC)
-      pThread->ReturnCode = AEWF_CHUNK_CRC_ERROR;
-   memcpy (pThread->pBuf, pThread->pChunkBuffUncompressed+pThread->Ofs, pThread->Len);
+   pThread->ReturnCode = AewfThreadReadChunk (pThread, pThread->pChunkBuffUncompressed);
+   if (pThread->ReturnCode != AEWF_OK)
+      return NULL;
+
+   if (pThread->Verify)
+   {
+      CalcCRC    = XmountAdler32 (1, pThread->pChunkBuffUncompressed, pThread->ChunkBuffUncompressedDataLen);
+      pStoredCRC = (uint32_t *) (pThread->pChunkBuffUncompressed + pThread->ChunkBuffUncompressedDataLen);  //lint !e826 Suspicious pointer-to-pointer conversion (area too small)
+      if (CalcCRC != *pStoredCRC)
+         pThread->ReturnCode = AEWF_CHUNK_CRC_ERROR;
+   }
+   if (pThread->ReturnCode == AEWF_OK)
+   {
+      if (AewfIsZeroData (pThread->pChunkBuffUncompressed, pThread->ChunkBuffUncompressedDataLen))
+           AewfZeroChunkMark (pThread->pZeroChunks, pThread->ChunkInBuff);
+      else AewfChunkCachePut (pThread->pChunkCache, pThread->ChunkInBuff, pThread->pChunkBuffUncompressed, pThread->ChunkBuffUncompressedDataLen);
+   }
+   if (pThread->pBuf)
+      memcpy (pThread->pBuf, pThread->pChunkBuffUncompressed+pThread->Ofs, pThread->Len);
 
    return NULL;
 }
@@ -953,76 +1520,346 @@ static void* AewfThreadCopy (void *pArg)
    return NULL;
 }
 
+// AewfWorker is the main loop of the persistent worker threads created in AewfOpen. It
+// waits for a job being handed to it by AewfThreadLaunch and runs it. The workers live
+// until AewfClose sets the pool's Shutdown flag.
+static void* AewfWorker (void *pArg)
+{
+   t_pAewfThread pThread = (t_pAewfThread) pArg;
+   t_pAewfPool   pPool   = pThread->pPool;
 
-// AewfReadChunkMT0 reads exactly one chunk. It expects the EWF table be present
-// in memory and the required segment be opened.
-static int AewfReadChunkMT0 (t_pAewf pAewf, t_pTable pTable, uint64_t AbsoluteChunk, uint64_t TableChunk, char *pBuf, uint64_t Ofs, uint64_t Len)
+   (void) pthread_mutex_lock (&pPool->Mutex);
+   for (;;)
+   {
+      while (!pThread->JobPending && !pPool->Shutdown)
+         (void) pthread_cond_wait (&pThread->CondJob, &pPool->Mutex);
+      if (!pThread->JobPending)  // Shutdown, but only after the last job has been done
+         break;
+      (void) pthread_mutex_unlock (&pPool->Mutex);
+
+      (void) pThread->pJob (pThread);
+
+      (void) pthread_mutex_lock (&pPool->Mutex);
+      pThread->JobPending = FALSE;
+      if (pThread->Prefetch)
+      {
+         pPool->Prefetching--;
+         (void) pthread_cond_signal (&pPool->CondDone);
+      }
+      else if (--pPool->Busy == 0)
+      {
+         (void) pthread_cond_signal (&pPool->CondDone);
+      }
+   }
+   (void) pthread_mutex_unlock (&pPool->Mutex);
+
+   return NULL;
+}
+
+// AewfThreadLaunch hands a job to an idle worker. The job arguments in pThread
+// must have been set before.
+static int AewfThreadLaunch (t_pAewf pAewf, t_pAewfThread pThread, void *(*pJob)(void *), int Prefetch)
 {
-   int                  Compressed;
-   uint64_t             SeekPos;
-   t_pAewfSectionTable pEwfTable;
-   uint32_t             Offset;
-   uint32_t             ReadLen;
-   int                  prc;
-   uint64_t             ChunkSize;
-   int                  Ret = AEWF_OK;
+   if (pthread_mutex_lock (&pAewf->Pool.Mutex) != 0)
+      return AEWF_ERROR_PTHREAD;
+   pThread->pJob       = pJob;
+   pThread->JobPending = TRUE;
+   pThread->Prefetch   = (uint8_t) Prefetch;
+   pThread->State      = AEWF_LAUNCHED;
+   if (Prefetch)
+        pAewf->Pool.Prefetching++;
+   else pAewf->Pool.Busy++;
+   (void) pthread_cond_signal   (&pThread->CondJob);
+   (void) pthread_mutex_unlock  (&pAewf->Pool.Mutex);
 
-//   LOG ("Called - AbsoluteChunk=%'" PRIu64, AbsoluteChunk);
+   return AEWF_OK;
+}
 
-   pEwfTable = pTable->pEwfTable;
-   if (pEwfTable == NULL)
-      return AEWF_ERROR_EWF_TABLE_NOT_READY;
-   if (pTable->pSegment->pFile == NULL)
-      return AEWF_ERROR_EWF_SEGMENT_NOT_READY;
+// ------------------------------------------------------------------------------------
+//  io_uring functions - Batched chunk reads, only available if built with liburing
+// ------------------------------------------------------------------------------------
 
-   Compressed = pEwfTable->OffsetArray[TableChunk] &  AEWF_COMPRESSED;
-   Offset     = pEwfTable->OffsetArray[TableChunk] & ~AEWF_COMPRESSED;
-   SeekPos    = pEwfTable->TableBaseOffset + Offset;
+// AewfUringInit sets up the ring if io_uring is enabled. If the kernel refuses (too old, or
+// forbidden by a seccomp filter), the workers simply keep reading with pread.
+static void AewfUringInit (t_pAewf pAewf)
+{
+   pAewf->Uring.Active   = FALSE;
+   pAewf->Uring.Queued   = 0;
+   pAewf->Uring.InFlight = 0;
+#ifdef HAVE_LIBURING
+   int rc;
 
-   if (TableChunk < (pEwfTable->ChunkCount-1))
-        ReadLen = (pEwfTable->OffsetArray[TableChunk+1] & ~AEWF_COMPRESSED) - Offset;
-   else ReadLen = pTable->SectionSectorsSize - (SeekPos - pTable->SectionSectorsPos);
-//   else ReadLen = pAewf->ChunkBuffSize;  // This also  works! It looks as if uncompress is able to find out by itself the real size of the input data. But this line could lead to reading beyond EOF...
+   if (!pAewf->UseUring || (pAewf->pThreadArr == NULL))
+      return;
+   rc = io_uring_queue_init (pAewf->Threads, &pAewf->Uring.Ring, 0);  // There never are more reads in flight than workers
+   if (rc < 0)
+   {
+      LOG ("io_uring not available (%s), reading chunks with pread", strerror (-rc));
+      return;
+   }
+   pAewf->Uring.Active = TRUE;
+   LOG ("Reading chunks with io_uring");
+#endif
+}
+
+// AewfUringReap launches the jobs of all chunks whose read has completed. If Wait is set, it
+// blocks until at least one read has completed (unless none is in flight).
+static int AewfUringReap (t_pAewf pAewf, int Wait)
+{
+#ifdef HAVE_LIBURING
+   struct io_uring_cqe *pCqe;
+   t_pAewfThread        pThread;
+   int                  rc;
 
-   if (ReadLen > pAewf->ChunkBuffSize)
+   while (pAewf->Uring.InFlight)
    {
-      LOG ("Chunk too big %u / %u", ReadLen, pAewf->ChunkBuffSize);
-      CHK (AEWF_CHUNK_TOO_BIG)
+      if (Wait)
+           rc = io_uring_wait_cqe (&pAewf->Uring.Ring, &pCqe);
+      else rc = io_uring_peek_cqe (&pAewf->Uring.Ring, &pCqe);
+      if (rc == -EINTR)
+         continue;
+      if ((rc == -EAGAIN) && !Wait)  // Nothing completed yet
+         break;
+      if (rc < 0)
+      {
+         LOG ("Waiting for io_uring completions failed (%s)", strerror (-rc));
+         return AEWF_URING_FAILED;
+      }
+      pThread = (t_pAewfThread) io_uring_cqe_get_data (pCqe);
+      pThread->PreRead   = (pCqe->res > 0) ? (uint32_t) pCqe->res : 0;  // After errors or short reads, the job reads (the rest) with pread
+      pThread->IoPending = FALSE;
+      io_uring_cqe_seen (&pAewf->Uring.Ring, pCqe);
+      pAewf->Uring.InFlight--;
+      CHK (AewfThreadLaunch (pAewf, pThread, pThread->pJob, pThread->Prefetch))
+      Wait = FALSE;  // Take the others that have completed meanwhile, but don't wait for them
    }
+#else
+   (void) pAewf;
+   (void) Wait;
+#endif
+   return AEWF_OK;
+}
 
-   ChunkSize = pAewf->ChunkSize;
-   if (AbsoluteChunk == (pAewf->Chunks-1))   // The very last chunk of the image may be smaller than the default
-   {                                         // chunk size if the image isn't a multiple of the chunk size.
-      ChunkSize = pAewf->ImageSize % pAewf->ChunkSize;
-      if (ChunkSize == 0)
-         ChunkSize = pAewf->ChunkSize;
+// AewfUringQueue prepares the read of a chunk into the given buffer of the worker. Returns
+// FALSE if the read couldn't be queued; the job then must be launched directly.
+static int AewfUringQueue (t_pAewf pAewf, t_pAewfThread pThread, void *(*pJob)(void *), char *pDst, int Prefetch)
+{
+#ifdef HAVE_LIBURING
+   struct io_uring_sqe *pSqe;
+
+   if (!pAewf->Uring.Active)
+      return FALSE;
+   pSqe = io_uring_get_sqe (&pAewf->Uring.Ring);
+   if (pSqe == NULL)
+      return FALSE;
+   io_uring_prep_read    (pSqe, pThread->pSegment->Fd, pDst, (unsigned) pThread->ChunkBuffCompressedDataLen, pThread->SeekPos);
+   io_uring_sqe_set_data (pSqe, pThread);
+   pThread->pJob      = pJob;
+   pThread->Prefetch  = (uint8_t) Prefetch;
+   pThread->State     = AEWF_LAUNCHED;
+   pThread->IoPending = TRUE;
+   pAewf->Uring.Queued++;
+   pAewf->UringReads++;
+
+   return TRUE;
+#else
+   (void) pAewf;
+   (void) pThread;
+   (void) pJob;
+   (void) pDst;
+   (void) Prefetch;
+
+   return FALSE;
+#endif
+}
+
+// AewfUringSubmit submits all queued reads with a single system call and launches the jobs
+// of the completed ones until no read of the current request is outstanding anymore. Reads
+// of the readahead still in flight are reaped later on.
+static int AewfUringSubmit (t_pAewf pAewf)
+{
+#ifdef HAVE_LIBURING
+   int Pending;
+   int rc;
+
+   if (!pAewf->Uring.Active)
+      return AEWF_OK;
+
+   if (pAewf->Uring.Queued)
+   {
+      rc = io_uring_submit (&pAewf->Uring.Ring);
+      if (rc > 0)
+      {
+         pAewf->Uring.Queued   -= GETMIN ((uint32_t) rc, pAewf->Uring.Queued);
+         pAewf->Uring.InFlight += (uint32_t) rc;
+         pAewf->UringBatches++;
+      }
+      if (pAewf->Uring.Queued)  // Give up the io_uring, the workers read the remaining chunks themselves
+      {
+         LOG ("io_uring_submit failed (%d), switching to pread", rc);
+         while (pAewf->Uring.InFlight)
+            CHK (AewfUringReap (pAewf, TRUE))
+         pAewf->Uring.Active = FALSE;
+         pAewf->Uring.Queued = 0;
+         for (uint32_t i=0; i<pAewf->Threads; i++)
+         {
+            t_pAewfThread pThread = &pAewf->pThreadArr[i];
+            if (pThread->IoPending)
+            {
+               pThread->IoPending = FALSE;
+               CHK (AewfThreadLaunch (pAewf, pThread, pThread->pJob, pThread->Prefetch))
+            }
+         }
+      }
+   }
+
+   do
+   {
+      Pending = FALSE;
+      for (uint32_t i=0; (i<pAewf->Threads) && !Pending; i++)
+         Pending = pAewf->pThreadArr[i].IoPending && !pAewf->pThreadArr[i].Prefetch;
+      if (Pending)
+         CHK (AewfUringReap (pAewf, TRUE))
+   } while (Pending);
+#else
+   (void) pAewf;
+#endif
+   return AEWF_OK;
+}
+
+// AewfUringDeInit hands the reads still in flight to the workers (which must be done before
+// they're shut down) and releases the ring.
+static void AewfUringDeInit (t_pAewf pAewf)
+{
+#ifdef HAVE_LIBURING
+   if (!pAewf->Uring.Active)
+      return;
+   while (pAewf->Uring.InFlight)
+   {
+      if (AewfUringReap (pAewf, TRUE) != AEWF_OK)
+         break;
+   }
+   io_uring_queue_exit (&pAewf->Uring.Ring);
+   pAewf->Uring.Active = FALSE;
+#else
+   (void) pAewf;
+#endif
+}
+
+// AewfPrefetchCollect makes the workers that have finished a readahead job available again.
+// Readahead results are not checked, a failed chunk simply is read again later on. If Wait is
+// set, the function blocks until there is an idle worker (unless no readahead job is running).
+static void AewfPrefetchCollect (t_pAewf pAewf, int Wait)
+{
+   t_pAewfThread pThread;
+   int           Idle;
+
+   (void) AewfUringReap (pAewf, FALSE);  // Launch the readahead jobs whose data has arrived meanwhile
+   (void) pthread_mutex_lock (&pAewf->Pool.Mutex);
+   for (;;)
+   {
+      Idle = FALSE;
+      for (uint32_t i=0; i<pAewf->Threads; i++)
+      {
+         pThread = &pAewf->pThreadArr[i];
+         if ((pThread->State == AEWF_LAUNCHED) && pThread->Prefetch && !pThread->JobPending && !pThread->IoPending)
+         {
+            pThread->State    = AEWF_IDLE;
+            pThread->Prefetch = FALSE;
+            if (pThread->ReturnCode != AEWF_OK)
+               pThread->ChunkInBuff = AEWF_NONE;
+         }
+         if (pThread->State == AEWF_IDLE)
+            Idle = TRUE;
+      }
+      if (Idle || !Wait)
+         break;
+      if (pAewf->Uring.InFlight)  // Readahead data still on its way, the worker can't even start yet
+      {
+         (void) pthread_mutex_unlock (&pAewf->Pool.Mutex);
+         if (AewfUringReap (pAewf, TRUE) != AEWF_OK)
+            return;
+         (void) pthread_mutex_lock (&pAewf->Pool.Mutex);
+         continue;
+      }
+      if (pAewf->Pool.Prefetching == 0)
+         break;
+      (void) pthread_cond_wait (&pAewf->Pool.CondDone, &pAewf->Pool.Mutex);
    }
+   (void) pthread_mutex_unlock (&pAewf->Pool.Mutex);
+}
+
+// AewfPrefetchWait waits until the readahead job of the given worker is finished.
+static void AewfPrefetchWait (t_pAewf pAewf, t_pAewfThread pThread)
+{
+   while (pThread->IoPending)
+   {
+      if (AewfUringReap (pAewf, TRUE) != AEWF_OK)
+         return;
+   }
+   (void) pthread_mutex_lock (&pAewf->Pool.Mutex);
+   while (pThread->JobPending)
+      (void) pthread_cond_wait (&pAewf->Pool.CondDone, &pAewf->Pool.Mutex);
+   (void) pthread_mutex_unlock (&pAewf->Pool.Mutex);
+   AewfPrefetchCollect (pAewf, FALSE);
+}
+
+// AewfReadChunkMT0 hands exactly one chunk to a worker, which reads and processes it. With
+// io_uring, the read only is queued and the worker is launched on its completion. It expects
+// the required segment be opened. If pBuf is NULL, it's a readahead job: The chunk only goes
+// to the chunk cache and the worker's buffer.
+static int AewfReadChunkMT0 (t_pAewf pAewf, t_pSegment pSegment, uint64_t AbsoluteChunk, uint64_t SeekPos, uint32_t ReadLen, int Compressed,
+                             char *pBuf, uint64_t Ofs, uint64_t Len, int *pDone)
+{
+   uint64_t             ChunkSize;
+   void             *(*pJob)(void *);
+   char                *pDst;
+   int                  Ret = AEWF_OK;
+
+//   LOG ("Called - AbsoluteChunk=%'" PRIu64, AbsoluteChunk);
+
+   *pDone = FALSE;
+   if (pSegment->Fd < 0)
+      return AEWF_ERROR_EWF_SEGMENT_NOT_READY;
+
+   ChunkSize = AewfChunkLen (pAewf, AbsoluteChunk);
 
    for (uint64_t i=0; i<pAewf->Threads; i++)  // Search for first free thread for doing the job
    {
       t_pAewfThread pThread = &(pAewf->pThreadArr[i]);
       if (pThread->State == AEWF_IDLE)
       {
+         pThread->pSegment                     = pSegment;
+         pThread->SeekPos                      = SeekPos;
+         pThread->PreRead                      = 0;
          pThread->ChunkBuffCompressedDataLen   = ReadLen;
          pThread->ChunkBuffUncompressedDataLen = ChunkSize;  // uncompress should return this size (if it's a compressed chunk)
          pThread->ChunkInBuff                  = AbsoluteChunk;
+         pThread->Verify                       = AewfVerifyChunk (pAewf, AbsoluteChunk);
+         if (pThread->Verify)
+            pAewf->ChunksVerified++;
 
          pThread->pBuf                         = pBuf; // These 3 parameters specify which part
          pThread->Ofs                          = Ofs;  // of the resulting chunk data should be
          pThread->Len                          = Len;  // copied to which location.
+
          if (Compressed)
          {
-            CHK (ReadFilePos (pAewf, pTable->pSegment->pFile, pThread->pChunkBuffCompressed, ReadLen, SeekPos))
-            prc = pthread_create (&pThread->ID, NULL, AewfThreadUncompress, pThread);
+            pJob = AewfThreadUncompress;
+            pDst = pThread->pChunkBuffCompressed;
          }
          else
          {
-            CHK (ReadFilePos (pAewf, pTable->pSegment->pFile, pThread->pChunkBuffUncompressed, ReadLen, SeekPos))
-            prc = pthread_create (&pThread->ID, NULL, AewfThreadCRC, pThread);
+            pJob = AewfThreadCRC;
+            pDst = pThread->pChunkBuffUncompressed;
          }
-         if (prc != 0)
-            Ret = AEWF_ERROR_PTHREAD;
-         pThread->State = AEWF_LAUNCHED;  // Only switch to LAUNCHED now that we know that pthread_create was successful
+         (void) __atomic_add_fetch (&pSegment->Users, 1, __ATOMIC_RELAXED);  // Released by the worker once it has read the data
+         if (AewfUringQueue (pAewf, pThread, pJob, pDst, (pBuf == NULL)))
+              Ret = AEWF_OK;
+         else Ret = AewfThreadLaunch (pAewf, pThread, pJob, (pBuf == NULL));
+         if (Ret != AEWF_OK)
+            (void) __atomic_sub_fetch (&pSegment->Users, 1, __ATOMIC_RELAXED);
+         *pDone = (Ret == AEWF_OK);
          break;
       }
    }
@@ -1033,74 +1870,141 @@ static int AewfReadChunkMT0 (t_pAewf pAewf, t_pTable pTable, uint64_t AbsoluteCh
    return Ret;
 }
 
-static int AewfReadChunkMT (t_pAewf pAewf, uint64_t AbsoluteChunk, char *pBuf, uint64_t Ofs, uint64_t Len)
+// AewfReadChunkMT either copies the requested data directly (chunk cache hit) or launches a
+// worker for it. pDone is set to FALSE if no worker was available; the caller must stop then.
+static int AewfReadChunkMT (t_pAewf pAewf, uint64_t AbsoluteChunk, char *pBuf, uint64_t Ofs, uint64_t Len, int *pDone)
 {
-   t_pTable  pTable;
-   int        Found=FALSE;
-   uint64_t   TableChunk;
-   uint64_t   TableNr;
-   int        rc;
+   t_pSegment pSegment;
+   uint64_t   SeekPos;
+   uint32_t   ReadLen;
+   int        Compressed;
+   uint64_t   Copied;
 
 //   LOG ("Called - AbsoluteChunk=%'" PRIu64, AbsoluteChunk);
 
+   if (AewfZeroChunkKnown (&pAewf->ZeroChunks, AbsoluteChunk))
+   {
+      memset (pBuf, 0, Len);
+      pAewf->ZeroChunkReads++;
+      *pDone = TRUE;
+      return AEWF_OK;
+   }
+
    // Check if chunk already is in cache
    // ----------------------------------
    for (uint32_t i=0; i<pAewf->Threads; i++)
    {
       t_pAewfThread pThread = &(pAewf->pThreadArr[i]);
-      if (pThread->ChunkInBuff == AbsoluteChunk)
+      if ((pThread->ChunkInBuff == AbsoluteChunk) && (pThread->State == AEWF_LAUNCHED) && pThread->Prefetch)
+         AewfPrefetchWait (pAewf, pThread);  // Chunk is being decompressed by the readahead
+      if ((pThread->ChunkInBuff == AbsoluteChunk) && (pThread->State == AEWF_IDLE))
       {
          pThread->pBuf  = pBuf;
          pThread->Ofs   = Ofs;
          pThread->Len   = Len;
-         rc = pthread_create (&pThread->ID, NULL, AewfThreadCopy, pThread);
-         if (rc != 0)
-            return AEWF_ERROR_PTHREAD;
-         pThread->State = AEWF_LAUNCHED;
+         CHK (AewfThreadLaunch (pAewf, pThread, AewfThreadCopy, FALSE))
          pAewf->ChunkCacheHits++;
+         *pDone = TRUE;
 
          return AEWF_OK;
       }
    }
    pAewf->ChunkCacheMisses++;
 
-   // Find table containing desired chunk
-   // -----------------------------------
-   for (TableNr=0; TableNr<pAewf->Tables; TableNr++)
+   if (AewfChunkCacheGet (&pAewf->ChunkCache, AbsoluteChunk, pBuf, Ofs, Len, &Copied))
    {
-      pTable = &pAewf->pTableArr[TableNr];
-      Found  = (AbsoluteChunk >= pTable->ChunkFrom) &&
-               (AbsoluteChunk <= pTable->ChunkTo);
-      if (Found)
-         break;
+      if (Copied != Len)
+         CHK (AEWF_WRONG_CHUNK_CALCULATION)
+      *pDone = TRUE;
+      return AEWF_OK;
    }
-   if (!Found)
-      CHK (AEWF_CHUNK_NOT_FOUND)
-
-   // Load corresponding table and get chunk
-   // --------------------------------------
-   pTable->LastUsed = time(NULL);                  //lint !e771 pTable' (line 640) conceivably not initialized
-   pTable->pSegment->LastUsed = pTable->LastUsed;  // Update LastUsed here, in order not to remove the required data from cache
 
-   CHK (AewfLoadEwfTable (pAewf, pTable))
-   CHK (AewfOpenSegment  (pAewf, pTable));
-   TableChunk = AbsoluteChunk - pTable->ChunkFrom;
-   if (TableChunk > UINT_MAX)
-      CHK (AEWF_ERROR_IN_CHUNK_NUMBER)
-//   LOG ("table %d / entry %" PRIu64 " (%s)", TableNr, TableChunk, pTable->pSegment->pName)
-   CHK (AewfReadChunkMT0 (pAewf, pTable, AbsoluteChunk, TableChunk, pBuf, Ofs, Len))
+   CHK (AewfLocateChunk  (pAewf, AbsoluteChunk, &pSegment, &SeekPos, &ReadLen, &Compressed))
+   CHK (AewfReadChunkMT0 (pAewf, pSegment, AbsoluteChunk, SeekPos, ReadLen, Compressed, pBuf, Ofs, Len, pDone))
 
    return AEWF_OK;
 }
 
-static int AewfReadMT0 (t_pAewf pAewf, char *pBuf, uint64_t Seek64, size_t Count, size_t *pRead, int *pErrno)
+// AewfAdvise tells the kernel that the segment file data of the given chunks will be needed soon.
+// Each chunk is announced only once.
+static void AewfAdvise (t_pAewf pAewf, uint64_t FromChunk, uint64_t ToChunk)
+{
+#ifdef POSIX_FADV_WILLNEED
+   t_pSegment pSegment;
+   uint64_t   SeekPos;
+   uint32_t   ReadLen;
+   int        Compressed;
+
+   ToChunk = GETMIN (ToChunk, pAewf->Chunks);
+   if (pAewf->AdvisedChunk > ToChunk)  // Sequential reading restarted further up in the image
+      pAewf->AdvisedChunk = 0;
+   FromChunk = GETMAX (FromChunk, pAewf->AdvisedChunk);
+   for (uint64_t Chunk=FromChunk; Chunk<ToChunk; Chunk++)
+   {
+      if (AewfZeroChunkKnown (&pAewf->ZeroChunks, Chunk))
+         continue;
+      if (AewfLocateChunk (pAewf, Chunk, &pSegment, &SeekPos, &ReadLen, &Compressed) != AEWF_OK)
+         break;
+      (void) posix_fadvise (pSegment->Fd, (off_t) SeekPos, (off_t) ReadLen, POSIX_FADV_WILLNEED);
+   }
+   pAewf->AdvisedChunk = ToChunk;
+#else
+   (void) pAewf;
+   (void) FromChunk;
+   (void) ToChunk;
+#endif
+}
+
+// AewfReadahead is called on sequential reads, once the whole request has been handed to the
+// workers. It hands the chunks following the request to the remaining idle workers, which
+// decompress them into the chunk cache while the caller processes the data just read. The
+// segment file data of the chunks after these is announced to the kernel.
+static void AewfReadahead (t_pAewf pAewf, uint64_t FromChunk)
+{
+   t_pSegment pSegment;
+   uint64_t   SeekPos;
+   uint64_t   ToChunk;
+   uint32_t   ReadLen;
+   int        Compressed;
+   int        Done = TRUE;
+   int        Known;
+   int        rc;
+
+   ToChunk = GETMIN (FromChunk + pAewf->Readahead, pAewf->Chunks);
+   for (uint64_t Chunk=FromChunk; (Chunk<ToChunk) && Done; Chunk++)
+   {
+      Known = AewfZeroChunkKnown (&pAewf->ZeroChunks, Chunk) || AewfChunkCacheHas (&pAewf->ChunkCache, Chunk);
+      for (uint32_t i=0; (i<pAewf->Threads) && !Known; i++)
+         Known = (pAewf->pThreadArr[i].ChunkInBuff == Chunk);
+      if (Known)
+         continue;
+
+      rc = AewfLocateChunk (pAewf, Chunk, &pSegment, &SeekPos, &ReadLen, &Compressed);
+      if (rc == AEWF_OK)
+         rc = AewfReadChunkMT0 (pAewf, pSegment, Chunk, SeekPos, ReadLen, Compressed, NULL, 0, 0, &Done);
+      if (rc != AEWF_OK)
+      {
+         LOG ("Readahead of chunk %" PRIu64 " failed (%s)", Chunk, AewfGetErrorMessage (rc));
+         break;
+      }
+      if (Done)
+         pAewf->ReadaheadChunks++;
+   }
+   AewfAdvise (pAewf, ToChunk, ToChunk + pAewf->Readahead);
+}
+
+// AewfReadMT0 reads as many chunks as there are idle workers. If Readahead is set and all data
+// of the request could be handed to the workers, the chunks behind it are read in advance.
+static int AewfReadMT0 (t_pAewf pAewf, char *pBuf, uint64_t Seek64, size_t Count, size_t *pRead, int *pErrno, int Readahead)
 {
    uint64_t       AbsoluteChunk;
    uint64_t       Remaining;
    uint64_t       Len, Ofs;
    t_pAewfThread pThread;
    int            RcRead;
+   int            RcUring;
    int            RcThread;
+   int            Done;
    int            rc;
 
    Ofs           = Seek64 % pAewf->ChunkSize;
@@ -1108,40 +2012,52 @@ static int AewfReadMT0 (t_pAewf pAewf, char *pBuf, uint64_t Seek64, size_t Count
    Remaining     = Count;
    *pRead        = 0;
 
+   AewfPrefetchCollect (pAewf, TRUE);  // Make sure there's at least one idle worker
+
    // Launch all read/decompress jobs
    // -------------------------------
    while (Remaining)
    {
       Len = GETMIN (pAewf->ChunkSize - Ofs, Remaining);
-      RcRead = AewfReadChunkMT (pAewf, AbsoluteChunk, pBuf, Ofs, Len);
-      if (RcRead)
+      RcRead = AewfReadChunkMT (pAewf, AbsoluteChunk, pBuf, Ofs, Len, &Done);
+      if (RcRead || !Done)  // Stop if all workers are busy, the caller will call us again for the rest
          break;
       Remaining -= Len;
       pBuf      += Len;
       Ofs        = 0;
       AbsoluteChunk++;
    }
+   if (Readahead && (Remaining == 0))
+      AewfReadahead (pAewf, (Seek64 + Count) / pAewf->ChunkSize);
+   RcUring = AewfUringSubmit (pAewf);  // The reads of the request and of its readahead go out as one batch
 
    // Wait for threads
    // ----------------
+   (void) pthread_mutex_lock (&pAewf->Pool.Mutex);
+   while (pAewf->Pool.Busy)
+      (void) pthread_cond_wait (&pAewf->Pool.CondDone, &pAewf->Pool.Mutex);
+   (void) pthread_mutex_unlock (&pAewf->Pool.Mutex);
+
    RcThread=0;
    for (uint32_t i=0; i<pAewf->Threads; i++)
    {
       pThread = &(pAewf->pThreadArr[i]);
 //      LOG ("Checking thread %d -> %d", i, pThread->State);
-      if (pThread->State == AEWF_LAUNCHED)
+      if ((pThread->State == AEWF_LAUNCHED) && !pThread->Prefetch && !pThread->IoPending)  // Readahead jobs are collected by AewfPrefetchCollect
       {
-         pthread_join (pThread->ID, NULL);
          pThread->State = AEWF_IDLE;
          rc = pThread->ReturnCode;
          if (rc)
+         {
             RcThread = rc;
-         *pRead += pThread->Len;
-
+            pThread->ChunkInBuff = AEWF_NONE;  // Don't serve corrupt data from this buffer later on
+         }
       }
    }
    CHK (RcRead)
+   CHK (RcUring)
    CHK (RcThread)
+   *pRead = Count - Remaining;
 
    return AEWF_OK;
 }
@@ -1151,13 +2067,15 @@ static int AewfReadMT (t_pAewf pAewf, char *pBuf, uint64_t Seek64, size_t Count,
    uint64_t ToRead;
    uint64_t MaxPerLoop;
    size_t   Read;
+   int      Readahead;
 
    MaxPerLoop = pAewf->Threads * pAewf->ChunkSize;
+   Readahead  = pAewf->Readahead && (pAewf->SeqReads >= AEWF_READAHEAD_SEQREADS);
    while (Count)
    {
       ToRead = GETMIN (MaxPerLoop, Count);
       Read   = 0;
-      CHK (AewfReadMT0 (pAewf, pBuf, Seek64, ToRead, &Read, pErrno))
+      CHK (AewfReadMT0 (pAewf, pBuf, Seek64, ToRead, &Read, pErrno, Readahead && (ToRead == Count)))  // Readahead along with the last part of the request
       *pRead += Read;
       pBuf   += Read;
       Seek64 += Read;
@@ -1167,18 +2085,815 @@ static int AewfReadMT (t_pAewf pAewf, char *pBuf, uint64_t Seek64, size_t Count,
    return AEWF_OK;
 }
 
-static uint32_t GetCPUs (t_pAewf pAewf)
+static uint32_t GetCPUs (t_pAewf pAewf)
+{
+   int32_t CPUs;
+
+   CPUs = sysconf( _SC_NPROCESSORS_ONLN );
+   if (CPUs < 0)
+   {
+      if (pAewf)
+         LOG ("Number of CPUs could not be determined, assume 4 CPUs");
+      CPUs = 4;
+   }
+   return (uint32_t)CPUs;
+}
+
+// AewfScanSegment opens a single segment file and walks through its section chain. It only
+// collects what it finds in pScan, the consistency checks spanning several segment files are
+// done by AewfOpenScan when merging the results. AewfScanSegment may run in parallel for
+// different segment files.
+
+static int AewfScanSegment (t_pAewf pAewf, const char *pFilename, t_pAewfSegmentScan pScan)
+{
+   t_AewfFileHeader         FileHeader;
+   t_AewfSection            Section;
+   int                      Fd         = -1;
+   t_pTable                pTable;
+   t_pAewfSectionTable     pEwfTable  = NULL;
+   uint64_t                 Pos;
+   uint64_t                 SectionSectorsPos  = 0;
+   uint64_t                 SectionSectorsSize = 0;
+   int                      LastSection;
+   uint32_t                 SectionsCount;
+   int                      rc;
+
+   pScan->FirstTablePos    = UINT64_MAX;
+   pScan->VolumePos        = UINT64_MAX;
+   pScan->SectorsFromPrev  = TRUE;    // Sectors info still is the one inherited from the previous segment
+
+   pScan->Segment.pName = realpath (pFilename, NULL); // realpath allocates a buffer of the necessary length
+   if (pScan->Segment.pName == NULL)
+      CHK_LEAVE (AEWF_FILE_OPEN_FAILED)
+
+   LOG ("Opening segment %s", pFilename);
+   CHK_LEAVE (OpenFile (&Fd, pScan->Segment.pName, &pScan->Segment.FileSize))
+   CHK_LEAVE (ReadFilePos (pAewf, Fd, (void*)&FileHeader, sizeof(FileHeader), 0))
+
+   if (memcmp (FileHeader.Signature, AEWF_SIGNATURE, sizeof (AEWF_SIGNATURE)) != 0 )
+   {
+      LOG ("Error: Bad file signature in %s", pScan->Segment.pName);
+      CHK_LEAVE (AEWF_BAD_FILE_SIGNATURE)
+   }
+   pScan->Segment.Number   = FileHeader.SegmentNumber;
+   pScan->Segment.Fd       = -1;
+
+   Pos = sizeof (FileHeader);
+   SectionsCount = 0;
+   // Search for the important sections
+   do
+   {
+      if (++SectionsCount > AEWF_MAX_SECTION_COUNT)
+      {
+         LOG ("Error: Segment file has unusual high number of sections (%s)", pScan->Segment.pName);
+         CHK_LEAVE (AEWF_TOO_MANY_SECTIONS)
+      }
+
+      CHK_LEAVE (ReadFilePos (pAewf, Fd, &Section, sizeof (t_AewfSection), Pos))
+      if ((Pos + Section.Size) > pScan->Segment.FileSize)
+         CHK_LEAVE (AEWF_SECTION_BEYOND_EOF)
+
+      int IsHeader  = strcasecmp ((char *)Section.Type, "header"  ) == 0;
+      int IsHeader2 = strcasecmp ((char *)Section.Type, "header2" ) == 0;
+
+      if (IsHeader || IsHeader2)
+      {
+         void     **ppHdr   = IsHeader ? (void **) &pScan->pHeader : (void **) &pScan->pHeader2;
+         uint64_t  *pHdrLen = IsHeader ? &pScan->HeaderLen         : &pScan->Header2Len;
+
+         if (Section.Size <= sizeof (t_AewfSection))  // There must be at least 1 byte of header data
+            CHK_LEAVE (AEWF_SECTION_HEADER_WRONG_SIZE)
+
+         if (*ppHdr == NULL)
+         {
+            *pHdrLen = Section.Size - sizeof(t_AewfSection);
+            if (*pHdrLen > AEWF_MAX_HEADER_LEN)
+               CHK_LEAVE (AEWF_SECTION_HEADER_WRONG_SIZE)
+            CHK_LEAVE (ReadFileAllocPos (pAewf, Fd, ppHdr, *pHdrLen, Pos + sizeof (t_AewfSection)))
+         }
+      }
+      else if (strcasecmp ((char *)Section.Type, "sectors") == 0)
+      {
+         if (Section.Size < sizeof (t_AewfSection))
+            CHK_LEAVE (AEWF_SECTION_SECTORS_WRONG_SIZE)
+         SectionSectorsPos      = Pos;
+         SectionSectorsSize     = Section.Size;
+         pScan->SectorsFromPrev = FALSE;
+      }
+      else if (strcasecmp ((char *)Section.Type, "table") == 0)
+      {
+         if (pScan->FirstTablePos == UINT64_MAX)
+            pScan->FirstTablePos = Pos;
+         if (pScan->SectorsFromPrev)
+              pScan->NeedsSectorsFromPrev = TRUE;                 // Checked by AewfOpenScan
+         else if (SectionSectorsSize == 0)                        CHK_LEAVE (AEWF_SECTORS_MUST_PRECEDE_TABLES)
+         if (Section.Size < (sizeof (t_AewfSection) +
+                             sizeof (t_AewfSectionTable)))        CHK_LEAVE (AEWF_SECTION_TABLE_WRONG_SIZE)
+
+         CHK_LEAVE (ReadFileAllocPos (pAewf, Fd, (void**) &pEwfTable, sizeof(t_AewfSectionTable), Pos + sizeof (t_AewfSection))) // No need to read the part that contains the chunk offsets (array at structure end)
+         if (pEwfTable->ChunkCount)  // Disregard tables having zero chunks
+         {
+            pScan->Tables++;
+            pTable = (t_pTable) realloc (pScan->pTableArr, pScan->Tables * sizeof (t_Table));
+            if (pTable == NULL)
+               CHK_LEAVE (AEWF_MEMALLOC_FAILED)
+            pScan->pTableArr = pTable;
+            pTable = &pScan->pTableArr[pScan->Tables-1];
+            pTable->pSegment           = NULL;                   // Nr, pSegment and the chunk numbers are set by AewfOpenScan
+            pTable->Offset             = Pos          + sizeof (t_AewfSection);
+            pTable->Size               = Section.Size - sizeof (t_AewfSection);
+            pTable->ChunkCount         = pEwfTable->ChunkCount;
+            pTable->Lru.pPrev          = NULL;
+            pTable->Lru.pNext          = NULL;
+            pTable->pEwfTable          = NULL;
+            pTable->SectionSectorsPos  = SectionSectorsPos;      // Both are 0 if the sectors section lies in the previous segment
+            pTable->SectionSectorsSize = SectionSectorsSize;
+            pScan->TotalTableSize     += pTable->Size;
+            SectionSectorsPos      = 0;
+            SectionSectorsSize     = 0;
+            pScan->SectorsFromPrev = FALSE;
+
+            // Is the offset array big enough for the number of chunks?
+            // Is the file long enough for holding the table?
+            uint64_t MaxArrayEntries = (pTable->Size - sizeof(t_AewfSectionTable)) / sizeof(uint32_t);
+            if (MaxArrayEntries                 < pTable->ChunkCount)        CHK_LEAVE (AEWF_SECTION_TABLE_WRONG_SIZE)
+            if ((pTable->Offset + pTable->Size) > pScan->Segment.FileSize)   CHK_LEAVE (AEWF_SECTION_TABLE_BEYOND_EOF)
+         }
+         SAFE_FREE (pEwfTable, sizeof(t_AewfSectionTable));
+      }
+
+      else if ( ((strcasecmp ((char *)Section.Type, "volume") == 0) || // Guymager works with the volume section. Others use different names
+                 (strcasecmp ((char *)Section.Type, "disk"  ) == 0) || // for it, but it all is the same. See Joachim Metz' EWF documentation
+                 (strcasecmp ((char *)Section.Type, "data"  ) == 0))
+              && (pScan->VolumePos == UINT64_MAX))
+      {
+         pScan->VolumePos = Pos;
+         if (Section.Size < (sizeof (t_AewfSection)+sizeof(t_AewfSectionVolume)))
+              pScan->VolumeRc = AEWF_SECTION_VOLUME_WRONG_SIZE;  // Only an error if it's the volume section used by AewfOpenScan
+         else CHK_LEAVE (ReadFileAllocPos (pAewf, Fd, (void**) &pScan->pVolume, sizeof(t_AewfSectionVolume), Pos + sizeof (t_AewfSection)))
+      }
+      if (strcasecmp ((char *)Section.Type, "hash") == 0)
+      {
+         if (Section.Size < (sizeof (t_AewfSection) + sizeof(t_AewfSectionHash)))
+            CHK_LEAVE (AEWF_SECTION_HASH_WRONG_SIZE)
+
+         SAFE_FREE (pScan->pMD5, sizeof (t_AewfSectionHash));
+         CHK_LEAVE (ReadFileAllocPos (pAewf, Fd, (void**) &pScan->pMD5, sizeof(t_AewfSectionHash), Pos + sizeof (t_AewfSection)))
+      }
+//      LOG ("Section %s", Section.Type)
+
+      LastSection = (Pos == Section.OffsetNextSection) ||  // This is the official marker for the last section
+                    (Pos == 0);                            // This is an error - normally - but let's be fault tolerant
+      if (!LastSection)
+      {
+         if ( (Section.OffsetNextSection        <= Pos) ||         // Test works even if unsigned substraction
+             ((Section.OffsetNextSection - Pos) <  Section.Size))  // would result would in integer wrap around
+         {
+            LOG ("Error: Next section must lie beyond current section (%s %"PRIu64" / %"PRIu64")", pScan->Segment.pName, Section.OffsetNextSection, Pos)
+            CHK_LEAVE (AEWF_SECTION_STARTPOS_ERROR)
+         }
+         Pos = Section.OffsetNextSection;
+      }
+   } while (!LastSection);
+   pScan->SectionSectorsPos  = SectionSectorsPos;
+   pScan->SectionSectorsSize = SectionSectorsSize;
+   rc = AEWF_OK;
+
+Leave:
+   if (Fd >= 0)
+      (void) close (Fd);
+   SAFE_FREE (pEwfTable, sizeof(t_AewfSectionTable));
+   pScan->rc = rc;
+
+   return rc;
+}
+
+static void AewfScanSegmentFree (t_pAewfSegmentScan pScan)
+{
+   SAFE_FREE (pScan->Segment.pName);
+   SAFE_FREE (pScan->pTableArr, pScan->Tables * sizeof (t_Table));
+   SAFE_FREE (pScan->pVolume  , sizeof (t_AewfSectionVolume));
+   SAFE_FREE (pScan->pMD5     , sizeof (t_AewfSectionHash));
+   SAFE_FREE (pScan->pHeader  , pScan->HeaderLen);
+   SAFE_FREE (pScan->pHeader2 , pScan->Header2Len);
+}
+
+static void *AewfScanWorker (void *pArg)
+{
+   t_pAewfScanPool pScanPool = (t_pAewfScanPool) pArg;
+   uint64_t         i;
+
+   for (;;)
+   {
+      (void) pthread_mutex_lock (&pScanPool->Mutex);
+      i = pScanPool->Next++;
+      (void) pthread_mutex_unlock (&pScanPool->Mutex);
+      if (i >= pScanPool->Count)
+         break;
+      (void) AewfScanSegment (pScanPool->pAewf, pScanPool->ppFilenameArr[i], &pScanPool->pScanArr[i]);
+   }
+   return NULL;
+}
+
+static int QsortCompareSegmentScans (const void *pA, const void *pB)
+{
+   const t_pAewfSegmentScan pScanA = ((const t_pAewfSegmentScan)pA); //lint !e1773 Attempt to cast way const
+   const t_pAewfSegmentScan pScanB = ((const t_pAewfSegmentScan)pB); //lint !e1773 Attempt to cast way const
+   return (int)pScanA->Segment.Number - (int)pScanB->Segment.Number;
+}
+
+// AewfOpenScan walks through the section chains of all segment files. The segment files are
+// independent of each other and are scanned in parallel by up to pAewf->Threads threads. The
+// results then are merged in segment order into pSegmentArr and pTableArr and the info text
+// is assembled.
+
+static int AewfOpenScan (t_pAewf pAewf, const char **ppFilenameArr, uint64_t FilenameArrLen)
+{
+   t_AewfScanPool           ScanPool;
+   t_pAewfSegmentScan      pScanArr    = NULL;
+   t_pAewfSegmentScan      pScan;
+   t_pAewfSegmentScan      pPrevScan;
+   pthread_t              *pThreadIdArr = NULL;
+   uint64_t                 ThreadCount;
+   uint64_t                 ThreadsStarted = 0;
+   t_pSegment              pSegment;
+   t_pTable                pTable;
+   t_pAewfSectionVolume    pVolume     = NULL;
+   t_pAewfSectionHash      pMD5        = NULL;
+   char                   *pHeader     = NULL;
+   char                   *pHeader2    = NULL;
+   uint64_t                 SectionSectorsPos  = 0;
+   uint64_t                 SectionSectorsSize = 0;
+   uint64_t                 HeaderLen  = 0;
+   uint64_t                 Header2Len = 0;
+   int                      rc;
+
+   // Scan all segment files
+   // ----------------------
+   pScanArr = (t_pAewfSegmentScan) malloc (FilenameArrLen * sizeof (t_AewfSegmentScan));
+   if (pScanArr == NULL)
+      CHK_LEAVE (AEWF_MEMALLOC_FAILED)
+   memset (pScanArr, 0, FilenameArrLen * sizeof (t_AewfSegmentScan));
+
+   ScanPool.pAewf         = pAewf;
+   ScanPool.ppFilenameArr = ppFilenameArr;
+   ScanPool.pScanArr      = pScanArr;
+   ScanPool.Count         = FilenameArrLen;
+   ScanPool.Next          = 0;
+   ThreadCount = GETMIN (pAewf->Threads, FilenameArrLen);
+   if (ThreadCount > 1)
+   {
+      LOG ("Scanning %"PRIu64" segment files with %"PRIu64" threads", FilenameArrLen, ThreadCount);
+      pThreadIdArr = (pthread_t *) malloc (ThreadCount * sizeof (pthread_t));
+      if (pThreadIdArr == NULL)
+         CHK_LEAVE (AEWF_MEMALLOC_FAILED)
+      if (pthread_mutex_init (&ScanPool.Mutex, NULL))
+         CHK_LEAVE (AEWF_ERROR_PTHREAD)
+      for (ThreadsStarted=0; ThreadsStarted<ThreadCount; ThreadsStarted++)
+      {
+         if (pthread_create (&pThreadIdArr[ThreadsStarted], NULL, AewfScanWorker, &ScanPool))
+            break;
+      }
+      if (ThreadsStarted == 0)
+           (void) AewfScanWorker (&ScanPool);   // Do the work ourselves
+      for (uint64_t i=0; i<ThreadsStarted; i++)
+         (void) pthread_join (pThreadIdArr[i], NULL);
+      (void) pthread_mutex_destroy (&ScanPool.Mutex);
+   }
+   else
+   {
+      for (uint64_t i=0; i<FilenameArrLen; i++)
+         if (AewfScanSegment (pAewf, ppFilenameArr[i], &pScanArr[i]) != AEWF_OK)
+            break;
+   }
+   for (uint64_t i=0; i<FilenameArrLen; i++)    // Report the error of the first failing file
+      CHK_LEAVE (pScanArr[i].rc)
+
+   // Put segments into correct sequence and check if segment numbers are correct
+   // ---------------------------------------------------------------------------
+   qsort (pScanArr, FilenameArrLen, sizeof (t_AewfSegmentScan), &QsortCompareSegmentScans);
+   pPrevScan = NULL;
+   for (uint64_t i=0; i<FilenameArrLen; i++)
+   {
+      pScan = &pScanArr[i];
+      if (pPrevScan)
+      {
+         if (pScan->Segment.Number == pPrevScan->Segment.Number)
+         {
+            LOG ("Error: Duplicate segment numbers");
+            LOG ("Segment files %s and %s have both segment number %u", pPrevScan->Segment.pName, pScan->Segment.pName, pScan->Segment.Number);
+            CHK_LEAVE (AEWF_DUPLICATE_SEGMENT_NUMBER)
+         }
+      }
+      if (pScan->Segment.Number != (i+1))
+      {
+         LOG ("Error: Missing segment number(s)");
+         if (pPrevScan)
+              LOG ("Previous segment file %s has segment number %u", pPrevScan->Segment.pName, pPrevScan->Segment.Number)
+         else LOG ("No previous segment file.")
+         LOG ("Following segment file %s has segment number %u", pScan->Segment.pName    , pScan->Segment.Number    );
+         CHK_LEAVE (AEWF_MISSING_SEGMENT_NUMBER)
+      }
+      pPrevScan = pScan;
+   }
+
+   // Merge the scan results in segment order
+   // ---------------------------------------
+   pAewf->pSegmentArr = (t_pSegment) malloc (FilenameArrLen * sizeof(t_Segment));
+   if (pAewf->pSegmentArr == NULL)
+      CHK_LEAVE (AEWF_MEMALLOC_FAILED)
+   pAewf->Segments = FilenameArrLen;
+   for (uint64_t i=0; i<FilenameArrLen; i++)
+   {
+      pAewf->pSegmentArr[i] = pScanArr[i].Segment;
+      pScanArr[i].Segment.pName = NULL;         // Now owned by pSegmentArr
+   }
+
+   pAewf->pTableArr      = NULL;
+   pAewf->Tables         = 0;
+   pAewf->Chunks         = 0;
+   pAewf->TotalTableSize = 0;
+
+   LOG ("Reading tables");
+   for (uint64_t i=0; i<pAewf->Segments; i++)
+   {
+      pScan    = &pScanArr[i];
+      pSegment = &pAewf->pSegmentArr[i];
+      LOG ("Segment %s ", pSegment->pName);
+
+      if ((pVolume == NULL) && (pScan->FirstTablePos < pScan->VolumePos))
+         CHK_LEAVE (AEWF_VOLUME_MUST_PRECEDE_TABLES)
+      if (pScan->NeedsSectorsFromPrev && (SectionSectorsSize == 0))
+         CHK_LEAVE (AEWF_SECTORS_MUST_PRECEDE_TABLES)
+      if ((pVolume == NULL) && (pScan->VolumePos != UINT64_MAX))
+      {
+         CHK_LEAVE (pScan->VolumeRc)
+         pVolume = pScan->pVolume;
+         pScan->pVolume = NULL;
+         pAewf->Sectors    = pVolume->SectorCount;
+         pAewf->SectorSize = pVolume->BytesPerSector;
+         pAewf->ChunkSize  = pVolume->SectorsPerChunk * (uint64_t) pVolume->BytesPerSector;
+         pAewf->ImageSize  = pAewf->Sectors * pAewf->SectorSize;
+      }
+      if ((pHeader == NULL) && pScan->pHeader)
+      {
+         pHeader   = pScan->pHeader;
+         HeaderLen = pScan->HeaderLen;
+         pScan->pHeader = NULL;
+      }
+      if ((pHeader2 == NULL) && pScan->pHeader2)
+      {
+         pHeader2   = pScan->pHeader2;
+         Header2Len = pScan->Header2Len;
+         pScan->pHeader2 = NULL;
+      }
+      if (pScan->pMD5)                        // The last one wins
+      {
+         SAFE_FREE (pMD5, sizeof (t_AewfSectionHash));
+         pMD5 = pScan->pMD5;
+         pScan->pMD5 = NULL;
+      }
+
+      if (pScan->Tables)
+      {
+         if (pAewf->Tables + pScan->Tables > AEWF_MAX_TABLES)
+         {
+            LOG ("Error: Number of AEWF tables exceeds %"PRIu64, (uint64_t) AEWF_MAX_TABLES);
+            CHK_LEAVE (AEWF_NUMBER_OF_TABLES)
+         }
+         pTable = (t_pTable) realloc (pAewf->pTableArr, (pAewf->Tables + pScan->Tables) * sizeof (t_Table));
+         if (pTable == NULL)
+            CHK_LEAVE (AEWF_MEMALLOC_FAILED)
+         pAewf->pTableArr = pTable;
+         for (uint64_t t=0; t<pScan->Tables; t++)
+         {
+            pTable  = &pAewf->pTableArr[pAewf->Tables];
+            *pTable = pScan->pTableArr[t];
+            pTable->Nr        = pAewf->Tables++;
+            pTable->pSegment  = pSegment;
+            pTable->ChunkFrom = pAewf->Chunks;
+            pAewf->Chunks    += pTable->ChunkCount;
+            pTable->ChunkTo   = pAewf->Chunks-1;
+            if (pTable->SectionSectorsSize == 0)             // Sectors section lies in a previous segment
+            {
+               pTable->SectionSectorsPos  = SectionSectorsPos;
+               pTable->SectionSectorsSize = SectionSectorsSize;
+            }
+         }
+         pAewf->TotalTableSize += pScan->TotalTableSize;
+      }
+      if (!pScan->SectorsFromPrev)
+      {
+         SectionSectorsPos  = pScan->SectionSectorsPos;
+         SectionSectorsSize = pScan->SectionSectorsSize;
+      }
+   }
+   if (pVolume == NULL)
+      CHK_LEAVE (AEWF_VOLUME_MISSING)
+
+   if (pAewf->Chunks != pVolume->ChunkCount)
+   {
+      LOG ("Error: Wrong chunk count: %"PRIu64" / %"PRIu64, pAewf->Chunks, pVolume->ChunkCount);
+      LOG ("Maybe some segment files are missing. Perhaps you specified E01 instead of E?? or the segments continue beyond extension .EZZ.");
+      CHK_LEAVE (AEWF_WRONG_CHUNK_COUNT)
+   }
+
+   // Check for reasonable limits in order to detect corrupt images 
+   // -------------------------------------------------------------
+   if (pAewf->Sectors == 0) 
+   {
+      LOG ("Error: Image contains zero sectors.");
+      CHK_LEAVE (AEWF_ZERO_SECTORS)
+   }
+   if ((pAewf->SectorSize == 0) || 
+       (pAewf->SectorSize > AEWF_MAX_SECTOR_SIZE))
+   {
+      LOG ("Error: Image has invalid number of bytes per sector: %"PRIu32, pVolume->BytesPerSector);
+      CHK_LEAVE (AEWF_INVALID_SECTOR_SIZE)
+
+   }
+   if ((pAewf->ChunkSize == 0) || 
+       (pAewf->ChunkSize > AEWF_MAX_CHUNK_SIZE))
+   {
+      LOG ("Error: Image has invalid chunk size: %"PRIu64, pAewf->ChunkSize);
+      CHK_LEAVE (AEWF_INVALID_CHUNK_SIZE)
+
+   }
+   if (pAewf->ImageSize == 0) 
+   {
+      LOG ("Error: Image size is zero.");
+      CHK_LEAVE (AEWF_ZERO_IMAGE_SIZE)
+   }
+   if ((pAewf->Tables == 0) || (pAewf->Tables > AEWF_MAX_TABLES))
+   {
+      LOG ("Error: Number of AEWF tables is %"PRIu64, pAewf->Tables);
+      CHK_LEAVE (AEWF_NUMBER_OF_TABLES)
+   }
+
+   CHK_LEAVE (CreateInfoData (pAewf, pVolume, pHeader, HeaderLen, pHeader2, Header2Len, pMD5))
+   rc = AEWF_OK;
+
+Leave:
+   if (pScanArr)
+   {
+      for (uint64_t i=0; i<FilenameArrLen; i++)
+         AewfScanSegmentFree (&pScanArr[i]);
+      SAFE_FREE (pScanArr, FilenameArrLen * sizeof (t_AewfSegmentScan));
+   }
+   SAFE_FREE (pThreadIdArr);
+   SAFE_FREE (pVolume  , sizeof(t_AewfSectionVolume));
+   SAFE_FREE (pHeader  , HeaderLen);
+   SAFE_FREE (pHeader2 , Header2Len);
+   SAFE_FREE (pMD5     , sizeof (t_AewfSectionHash));
+
+   return rc;
+}
+
+
+// ---------------
+//  Sidecar index
+// ---------------
+
+
+// AewfSidecarLoad reads the sidecar index file with a single read operation and sets up
+// pSegmentArr, pTableArr, the info text and, if requested, the chunk index from it. It fails
+// if the sidecar file doesn't match the given segment files or if any of them has changed
+// since the sidecar file was written; AewfOpen then falls back to scanning the segment files.
+
+static int AewfSidecarLoad (t_pAewf pAewf, const char **ppFilenameArr, uint64_t FilenameArrLen)
+{
+   t_pAewfSidecarHeader   pHdr;
+   t_pAewfSidecarSegment  pSideSegmentArr;
+   t_pAewfSidecarTable    pSideTableArr;
+   t_pAewfSidecarTable    pSideTable;
+   t_pSegment             pSegment;
+   t_pTable               pTable;
+   int                    Fd         = -1;
+   char                  *pBuff      = NULL;
+   char                 **ppNameArr  = NULL;
+   char                  *pRealName  = NULL;
+   char                  *pNames;
+   char                  *pInfo;
+   char                  *pIndex;
+   uint64_t                FileSize;
+   uint64_t                ExpectedSize;
+   uint64_t                SegmentSize;
+   uint64_t                Chunks;
+   uint64_t                TotalTableSize;
+   uint64_t                Pos;
+   uint64_t                j;
+   struct stat             Stat;
+   int                     rc;
+
+   CHK_LEAVE (OpenFile (&Fd, pAewf->pSidecarPath, &FileSize))
+   if (FileSize < sizeof (t_AewfSidecarHeader))
+      CHK_LEAVE (AEWF_SIDECAR_INVALID)
+   CHK_LEAVE (ReadFileAllocPos (pAewf, Fd, (void**) &pBuff, FileSize, 0))
+   CHK_LEAVE (CloseFile (&Fd))
+
+   // Check header and overall consistency
+   // ------------------------------------
+   pHdr = (t_pAewfSidecarHeader) pBuff;
+   if ((pHdr->Magic    != AEWF_SIDECAR_MAGIC  ) ||
+       (pHdr->Version  != AEWF_SIDECAR_VERSION) ||
+       (pHdr->Segments != FilenameArrLen      ) ||
+       (pHdr->Segments >  UINT16_MAX          ) ||  // Segment numbers are 16 bit
+       (pHdr->Tables   == 0                   ) ||
+       (pHdr->Tables   >  AEWF_MAX_TABLES     ) ||
+       (pHdr->Chunks   >  FileSize            ) ||
+       (pHdr->NamesLen >  FileSize            ) ||
+       (pHdr->InfoLen  >  FileSize            ) ||
+       (pHdr->InfoLen  == 0                   ) ||
+       (pHdr->ChunkSize == 0                  ) ||
+       (pHdr->ChunkSize >  AEWF_MAX_CHUNK_SIZE) ||
+       (pHdr->Sectors  == 0                   ) ||
+       (pHdr->SectorSize == 0                 ) ||
+       (pHdr->SectorSize >  AEWF_MAX_SECTOR_SIZE) ||
+       (pHdr->Sectors  >  UINT64_MAX / pHdr->SectorSize) ||
+       (pHdr->ImageSize != pHdr->Sectors * pHdr->SectorSize))
+      CHK_LEAVE (AEWF_SIDECAR_INVALID)
+   if (pAewf->ChunkIndex && !pHdr->HasChunkIndex)  // Rescan, so that a sidecar containing the chunk index gets written
+      CHK_LEAVE (AEWF_SIDECAR_INVALID)
+
+   ExpectedSize = sizeof (t_AewfSidecarHeader)
+                + pHdr->Segments * sizeof (t_AewfSidecarSegment)
+                + pHdr->Tables   * sizeof (t_AewfSidecarTable)
+                + pHdr->NamesLen
+                + pHdr->InfoLen
+                + (pHdr->HasChunkIndex ? pHdr->Chunks * sizeof (t_AewfChunkIndex) : 0);
+   if (ExpectedSize != FileSize)
+      CHK_LEAVE (AEWF_SIDECAR_INVALID)
+   if (XmountAdler32 (1, pBuff + sizeof (t_AewfSidecarHeader), FileSize - sizeof (t_AewfSidecarHeader)) != pHdr->Checksum)
+      CHK_LEAVE (AEWF_SIDECAR_INVALID)
+
+   pSideSegmentArr = (t_pAewfSidecarSegment) (pBuff + sizeof (t_AewfSidecarHeader));
+   pSideTableArr   = (t_pAewfSidecarTable  ) (pSideSegmentArr + pHdr->Segments);
+   pNames          = (char *)                (pSideTableArr   + pHdr->Tables);
+   pInfo           = pNames + pHdr->NamesLen;
+   pIndex          = pInfo  + pHdr->InfoLen;
+   if (pInfo[pHdr->InfoLen-1] != '\0')
+      CHK_LEAVE (AEWF_SIDECAR_INVALID)
+
+   ppNameArr = (char **) malloc (pHdr->Segments * sizeof (char *));
+   if (ppNameArr == NULL)
+      CHK_LEAVE (AEWF_MEMALLOC_FAILED)
+   Pos = 0;
+   for (uint64_t i=0; i<pHdr->Segments; i++)
+   {
+      ppNameArr[i] = &pNames[Pos];
+      while ((Pos < pHdr->NamesLen) && (pNames[Pos] != '\0'))
+         Pos++;
+      if (Pos++ >= pHdr->NamesLen)
+         CHK_LEAVE (AEWF_SIDECAR_INVALID)
+   }
+
+   // Match the given files against the segments in the sidecar and check that they're unchanged
+   // -------------------------------------------------------------------------------------------
+   pAewf->pSegmentArr = (t_pSegment) malloc (pHdr->Segments * sizeof (t_Segment));
+   if (pAewf->pSegmentArr == NULL)
+      CHK_LEAVE (AEWF_MEMALLOC_FAILED)
+   memset (pAewf->pSegmentArr, 0, pHdr->Segments * sizeof (t_Segment));
+   pAewf->Segments = pHdr->Segments;
+
+   for (uint64_t i=0; i<FilenameArrLen; i++)
+   {
+      pRealName = realpath (ppFilenameArr[i], NULL);
+      if (pRealName == NULL)
+         CHK_LEAVE (AEWF_FILE_OPEN_FAILED)
+      j = i;                                                   // Files normally are given in the same order
+      if (strcmp (ppNameArr[j], pRealName) != 0)               // as they were when the sidecar was written
+      {
+         for (j=0; j<pHdr->Segments; j++)
+            if (strcmp (ppNameArr[j], pRealName) == 0)
+               break;
+      }
+      if ((j == pHdr->Segments) || (pAewf->pSegmentArr[j].pName != NULL))
+         CHK_LEAVE (AEWF_SIDECAR_INVALID)
+      if (stat (pRealName, &Stat) != 0)
+         CHK_LEAVE (AEWF_FILE_OPEN_FAILED)
+      if (((uint64_t) Stat.st_size  != pSideSegmentArr[j].FileSize) ||
+          ((int64_t)  Stat.st_mtime != pSideSegmentArr[j].MTime))
+      {
+         LOG ("Segment file %s changed since the sidecar index was written", pRealName);
+         CHK_LEAVE (AEWF_SIDECAR_SEGMENT_CHANGED)
+      }
+      if (pSideSegmentArr[j].Number != (j+1))   // Segments are stored sorted, as AewfOpenScan leaves them
+         CHK_LEAVE (AEWF_SIDECAR_INVALID)
+      pSegment = &pAewf->pSegmentArr[j];
+      pSegment->pName    = pRealName;
+      pSegment->Number   = pSideSegmentArr[j].Number;
+      pSegment->FileSize = pSideSegmentArr[j].FileSize;
+      pSegment->Fd       = -1;
+      pRealName = NULL;
+   }
+
+   // Tables, image geometry and info text. The tables get the same checks as in AewfOpenScan
+   // and must follow each other without gaps, as they would when found by the scan.
+   // ------------------------------------------------------------------------------------------
+   pAewf->pTableArr = (t_pTable) malloc (pHdr->Tables * sizeof (t_Table));
+   if (pAewf->pTableArr == NULL)
+      CHK_LEAVE (AEWF_MEMALLOC_FAILED)
+   pAewf->Tables = pHdr->Tables;
+   Chunks         = 0;
+   TotalTableSize = 0;
+   for (uint64_t i=0; i<pHdr->Tables; i++)
+   {
+      pSideTable = &pSideTableArr[i];
+      pTable     = &pAewf->pTableArr[i];
+      if ((pSideTable->Segment    >= pHdr->Segments) ||
+          (pSideTable->ChunkCount == 0             ) ||
+          (pSideTable->ChunkFrom  != Chunks        ) ||
+          (pSideTable->ChunkTo    != Chunks + pSideTable->ChunkCount - 1) ||
+          (pSideTable->ChunkTo    >= pHdr->Chunks  ))
+         CHK_LEAVE (AEWF_SIDECAR_INVALID)
+      SegmentSize = pAewf->pSegmentArr[pSideTable->Segment].FileSize;
+      if ((pSideTable->Size < sizeof (t_AewfSectionTable)) ||
+          (((pSideTable->Size - sizeof(t_AewfSectionTable)) / sizeof(uint32_t)) < pSideTable->ChunkCount) ||
+          (pSideTable->Size   > SegmentSize) ||
+          (pSideTable->Offset > SegmentSize - pSideTable->Size))
+         CHK_LEAVE (AEWF_SIDECAR_INVALID)
+      if ((pSideTable->SectionSectorsSize < sizeof (t_AewfSection)) ||
+          (pSideTable->SectionSectorsSize > SegmentSize) ||
+          (pSideTable->SectionSectorsPos  > SegmentSize - pSideTable->SectionSectorsSize))
+         CHK_LEAVE (AEWF_SIDECAR_INVALID)
+      Chunks         += pSideTable->ChunkCount;
+      TotalTableSize += pSideTable->Size;
+      pTable->Nr                 = i;
+      pTable->ChunkFrom          = pSideTable->ChunkFrom;
+      pTable->ChunkTo            = pSideTable->ChunkTo;
+      pTable->pSegment           = &pAewf->pSegmentArr[pSideTable->Segment];
+      pTable->Offset             = pSideTable->Offset;
+      pTable->Size               = pSideTable->Size;
+      pTable->ChunkCount         = pSideTable->ChunkCount;
+      pTable->SectionSectorsPos  = pSideTable->SectionSectorsPos;
+      pTable->SectionSectorsSize = pSideTable->SectionSectorsSize;
+      pTable->Lru.pPrev          = NULL;
+      pTable->Lru.pNext          = NULL;
+      pTable->pEwfTable          = NULL;
+   }
+   if ((Chunks != pHdr->Chunks) || (TotalTableSize != pHdr->TotalTableSize))
+      CHK_LEAVE (AEWF_SIDECAR_INVALID)
+   pAewf->Chunks         = pHdr->Chunks;
+   pAewf->TotalTableSize = pHdr->TotalTableSize;
+   pAewf->SectorSize     = pHdr->SectorSize;
+   pAewf->Sectors        = pHdr->Sectors;
+   pAewf->ChunkSize      = pHdr->ChunkSize;
+   pAewf->ImageSize      = pHdr->ImageSize;
+   pAewf->pInfo          = strdup (pInfo);
+   if (pAewf->pInfo == NULL)
+      CHK_LEAVE (AEWF_MEMALLOC_FAILED)
+
+   if (pAewf->ChunkIndex)
+   {
+      pAewf->pChunkIndexArr = (t_pAewfChunkIndex) malloc (pHdr->Chunks * sizeof (t_AewfChunkIndex));
+      if (pAewf->pChunkIndexArr == NULL)
+         CHK_LEAVE (AEWF_MEMALLOC_FAILED)
+      memcpy (pAewf->pChunkIndexArr, pIndex, pHdr->Chunks * sizeof (t_AewfChunkIndex));
+      for (uint64_t i=0; i<pHdr->Chunks; i++)
+      {
+         t_pAewfChunkIndex pEntry = &pAewf->pChunkIndexArr[i];
+         uint64_t          EntryPos = pEntry->Pos & ~AEWF_CHUNKINDEX_COMPRESSED;
+
+         if (pEntry->Segment >= pHdr->Segments)
+            CHK_LEAVE (AEWF_SIDECAR_INVALID)
+         SegmentSize = pAewf->pSegmentArr[pEntry->Segment].FileSize;
+         if ((pEntry->Size > SegmentSize) ||
+             (EntryPos     > SegmentSize - pEntry->Size))
+            CHK_LEAVE (AEWF_SIDECAR_INVALID)
+      }
+   }
+   LOG ("Sidecar index %s loaded", pAewf->pSidecarPath);
+   rc = AEWF_OK;
+
+Leave:
+   if (Fd >= 0)
+      (void) close (Fd);
+   if (rc != AEWF_OK)           // Leave a clean handle for AewfOpenScan
+   {
+      if (pAewf->pSegmentArr)
+      {
+         for (uint64_t i=0; i<pAewf->Segments; i++)
+            SAFE_FREE (pAewf->pSegmentArr[i].pName);
+         SAFE_FREE (pAewf->pSegmentArr);
+      }
+      SAFE_FREE (pAewf->pTableArr);
+      SAFE_FREE (pAewf->pChunkIndexArr);
+      SAFE_FREE (pAewf->pInfo);
+      pAewf->Segments = 0;
+      pAewf->Tables   = 0;
+      pAewf->Chunks   = 0;
+   }
+   SAFE_FREE (pRealName);
+   SAFE_FREE (ppNameArr);
+   SAFE_FREE (pBuff);
+
+   return rc;
+}
+
+// AewfSidecarWrite writes the sidecar index file. It first is written under a temporary
+// name and renamed afterwards, so that concurrent opens never see a half-written file.
+
+static int AewfSidecarWrite (t_pAewf pAewf)
 {
-   int32_t CPUs;
+   t_AewfSidecarHeader   Hdr;
+   t_AewfSidecarSegment  SideSegment;
+   t_AewfSidecarTable    SideTable;
+   t_pSegment           pSegment;
+   t_pTable             pTable;
+   struct stat           Stat;
+   FILE                *pFile     = NULL;
+   char                *pTmpName  = NULL;
+   uint32_t              Checksum  = 1;
+   int                   rc;
+
+   #define WRITE_SIDECAR(pData,Len)                                               \
+   {                                                                             \
+      if (fwrite ((pData), 1, (Len), pFile) != (size_t)(Len))                     \
+         CHK_LEAVE (AEWF_SIDECAR_WRITE_FAILED)                                   \
+      Checksum = XmountAdler32 (Checksum, (pData), (Len));                      \
+   }
 
-   CPUs = sysconf( _SC_NPROCESSORS_ONLN );
-   if (CPUs < 0)
+   memset (&Hdr, 0, sizeof (Hdr));
+   Hdr.Magic          = AEWF_SIDECAR_MAGIC;
+   Hdr.Version        = AEWF_SIDECAR_VERSION;
+   Hdr.Segments       = pAewf->Segments;
+   Hdr.Tables         = pAewf->Tables;
+   Hdr.Chunks         = pAewf->Chunks;
+   Hdr.TotalTableSize = pAewf->TotalTableSize;
+   Hdr.SectorSize     = pAewf->SectorSize;
+   Hdr.Sectors        = pAewf->Sectors;
+   Hdr.ChunkSize      = pAewf->ChunkSize;
+   Hdr.ImageSize      = pAewf->ImageSize;
+   Hdr.InfoLen        = strlen (pAewf->pInfo) + 1;
+   Hdr.HasChunkIndex  = (pAewf->pChunkIndexArr != NULL);
+   for (uint64_t i=0; i<pAewf->Segments; i++)
+      Hdr.NamesLen += strlen (pAewf->pSegmentArr[i].pName) + 1;
+
+   if (asprintf (&pTmpName, "%s.tmp_%d", pAewf->pSidecarPath, getpid()) < 0)
+      CHK_LEAVE (AEWF_MEMALLOC_FAILED)
+   pFile = fopen (pTmpName, "w");
+   if (pFile == NULL)
+      CHK_LEAVE (AEWF_SIDECAR_WRITE_FAILED)
+   if (fwrite (&Hdr, sizeof (Hdr), 1, pFile) != 1)  // Rewritten with the correct checksum at the end
+      CHK_LEAVE (AEWF_SIDECAR_WRITE_FAILED)
+
+   for (uint64_t i=0; i<pAewf->Segments; i++)
    {
-      if (pAewf)
-         LOG ("Number of CPUs could not be determined, assume 4 CPUs");
-      CPUs = 4;
+      pSegment = &pAewf->pSegmentArr[i];
+      if (stat (pSegment->pName, &Stat) != 0)
+         CHK_LEAVE (AEWF_FILE_OPEN_FAILED)
+      if ((uint64_t) Stat.st_size != pSegment->FileSize)
+         CHK_LEAVE (AEWF_FILESIZE_CHANGED)
+      memset (&SideSegment, 0, sizeof (SideSegment));
+      SideSegment.FileSize = pSegment->FileSize;
+      SideSegment.MTime    = (int64_t) Stat.st_mtime;
+      SideSegment.Number   = pSegment->Number;
+      WRITE_SIDECAR (&SideSegment, sizeof (SideSegment))
    }
-   return (uint32_t)CPUs;
+   for (uint64_t i=0; i<pAewf->Tables; i++)
+   {
+      pTable = &pAewf->pTableArr[i];
+      memset (&SideTable, 0, sizeof (SideTable));
+      SideTable.ChunkFrom          = pTable->ChunkFrom;
+      SideTable.ChunkTo            = pTable->ChunkTo;
+      SideTable.Segment            = pTable->pSegment - pAewf->pSegmentArr;
+      SideTable.Offset             = pTable->Offset;
+      SideTable.Size               = pTable->Size;
+      SideTable.ChunkCount         = pTable->ChunkCount;
+      SideTable.SectionSectorsPos  = pTable->SectionSectorsPos;
+      SideTable.SectionSectorsSize = pTable->SectionSectorsSize;
+      WRITE_SIDECAR (&SideTable, sizeof (SideTable))
+   }
+   for (uint64_t i=0; i<pAewf->Segments; i++)
+      WRITE_SIDECAR (pAewf->pSegmentArr[i].pName, strlen (pAewf->pSegmentArr[i].pName) + 1)
+   WRITE_SIDECAR (pAewf->pInfo, Hdr.InfoLen)
+   if (Hdr.HasChunkIndex)
+      WRITE_SIDECAR (pAewf->pChunkIndexArr, pAewf->Chunks * sizeof (t_AewfChunkIndex))
+   #undef WRITE_SIDECAR
+
+   Hdr.Checksum = Checksum;
+   if (fseeko (pFile, 0, SEEK_SET))
+      CHK_LEAVE (AEWF_SIDECAR_WRITE_FAILED)
+   if (fwrite (&Hdr, sizeof (Hdr), 1, pFile) != 1)
+      CHK_LEAVE (AEWF_SIDECAR_WRITE_FAILED)
+   rc = fclose (pFile);
+   pFile = NULL;
+   if (rc != 0)
+      CHK_LEAVE (AEWF_SIDECAR_WRITE_FAILED)
+   if (rename (pTmpName, pAewf->pSidecarPath) != 0)
+      CHK_LEAVE (AEWF_SIDECAR_WRITE_FAILED)
+   LOG ("Sidecar index %s written", pAewf->pSidecarPath);
+   rc = AEWF_OK;
+
+Leave:
+   if (pFile)
+   {
+      (void) fclose (pFile);
+      (void) unlink (pTmpName);
+   }
+   SAFE_FREE (pTmpName);
+
+   return rc;
 }
 
 // ---------------
@@ -1230,12 +2945,22 @@ static int AewfInitHandle (void *pHandle)
    pAewf->DataRequestedByCaller = 0;
    pAewf->TablesReadFromImage   = 0;
    pAewf->ChunksRead            = 0;
+   pAewf->ChunksVerified        = 0;
+   pAewf->ZeroChunkReads        = 0;
+   pAewf->ReadaheadChunks       = 0;
+   pAewf->UringReads            = 0;
+   pAewf->UringBatches          = 0;
+   pAewf->SeqNextPos            = UINT64_MAX;
+   pAewf->SeqReads              = 0;
+   pAewf->AdvisedChunk          = 0;
    pAewf->BytesRead             = 0;
    memset (pAewf->ReadSizesArr, 0, sizeof (pAewf->ReadSizesArr));
    pAewf->Errors                = 0;
    pAewf->LastError             = AEWF_OK;
    pAewf->pInfo                 = NULL;
    pAewf->pThreadArr            = NULL;
+   pAewf->Pool.Initialised      = FALSE;
+   pAewf->pChunkIndexArr        = NULL;
 
    return AEWF_OK;
 }
@@ -1261,8 +2986,13 @@ static int AewfCreateHandle (void **ppHandle, void *p_init_handle, const char *p
    pAewf->MaxOpenSegments = AEWF_DEFAULT_MAXOPENSEGMENTS;
    pAewf->StatsRefresh    = AEWF_DEFAULT_STATSREFRESH;
    pAewf->Threads         = GetCPUs(pAewf);
+   pAewf->MaxChunkCache   = AEWF_DEFAULT_CHUNKCACHE;
+   pAewf->Verify          = AEWF_VERIFY_FULL;
+   pAewf->Readahead       = AEWF_DEFAULT_READAHEAD;
+   pAewf->UseUring        = TRUE;
    pAewf->pStatsPath      = NULL;
    pAewf->pLogPath        = NULL;
+   pAewf->pSidecarPath    = NULL;
 
    *ppHandle = (void*) pAewf;
 
@@ -1283,6 +3013,7 @@ int AewfDestroyHandle(void **ppHandle)
 
    SAFE_FREE (pAewf->pLogPath  );
    SAFE_FREE (pAewf->pStatsPath);
+   SAFE_FREE (pAewf->pSidecarPath);
    SAFE_FREE (pAewf->pStatsPath);
 
    memset (pAewf, 0, sizeof(t_Aewf));
@@ -1294,27 +3025,10 @@ int AewfDestroyHandle(void **ppHandle)
 
 int AewfOpen (void *pHandle, const char **ppFilenameArr, uint64_t FilenameArrLen)
 {
-   t_pAewf                 pAewf = (t_pAewf) pHandle;
-   t_AewfFileHeader         FileHeader;
-   t_AewfSection            Section;
-   FILE                   *pFile;
-   t_pSegment              pSegment;
-   t_pSegment              pPrevSegment;
-   t_pTable                pTable;
-   uint64_t                 Pos;
-   t_pAewfSectionTable     pEwfTable   = NULL;
-   t_pAewfSectionVolume    pVolume     = NULL;
-   t_pAewfSectionHash      pMD5        = NULL;
-   char                   *pHeader     = NULL;
-   char                   *pHeader2    = NULL;
-   int                      LastSection;
-   uint64_t                 SectionSectorsPos;
-   uint64_t                 SectionSectorsSize;
-   uint64_t                 HeaderLen  = 0;
-   uint64_t                 Header2Len = 0;
-   uint32_t                 SectionsCount;
-   uint64_t                 FileSize;
-   int                      rc;
+   t_pAewf pAewf = (t_pAewf) pHandle;
+   int      SidecarLoaded = FALSE;
+   int      Opened        = FALSE;
+   int      rc;
 
    LOG ("Called - Files=%" PRIu64, FilenameArrLen);
 
@@ -1324,243 +3038,17 @@ int AewfOpen (void *pHandle, const char **ppFilenameArr, uint64_t FilenameArrLen
 
    CHK_LEAVE (AewfInitHandle  (pAewf));   // Re-init vital structures
    pAewf->Open = TRUE;
+   Opened      = TRUE;
 
-   // Create pSegmentArr and put the segment files in it
-   // --------------------------------------------------
-   size_t SegmentArrLen = FilenameArrLen * sizeof(t_Segment);
-   pAewf->pSegmentArr   = (t_pSegment) malloc (SegmentArrLen);
-   pAewf->Segments      = FilenameArrLen;
-   if (pAewf->pSegmentArr == NULL)
-      CHK_LEAVE (AEWF_MEMALLOC_FAILED)
-   memset (pAewf->pSegmentArr, 0, SegmentArrLen);
-
-   for (uint64_t i=0; i<FilenameArrLen; i++)
-   {
-      pSegment = &pAewf->pSegmentArr[i];
-      pSegment->pName = realpath (ppFilenameArr[i], NULL); // realpath allocates a buffer of the necessary length
-
-      LOG ("Opening segment %s", ppFilenameArr[i]);
-      CHK_LEAVE (OpenFile (&pFile, pSegment->pName, &pSegment->FileSize))
-      CHK_LEAVE (ReadFilePos (pAewf, pFile, (void*)&FileHeader, sizeof(FileHeader), 0))
-
-      if (memcmp (FileHeader.Signature, AEWF_SIGNATURE, sizeof (AEWF_SIGNATURE)) != 0 )
-      {
-         LOG ("Error: Bad file signature in %s", pSegment->pName);
-         CHK_LEAVE (AEWF_BAD_FILE_SIGNATURE)
-      }
-
-      pSegment->Number   = FileHeader.SegmentNumber;
-      pSegment->LastUsed = 0;
-      pSegment->pFile    = NULL;
-
-      CHK_LEAVE (CloseFile (&pFile))
-   }
-
-   // Put segment array into correct sequence and check if segment numbers are correct
-   // --------------------------------------------------------------------------------
-   qsort (pAewf->pSegmentArr, pAewf->Segments, sizeof (t_Segment), &QsortCompareSegments);
-   pPrevSegment = NULL;
-   for (uint64_t i=0; i<pAewf->Segments; i++)
-   {
-      pSegment = &(pAewf->pSegmentArr[i]);
-      if (pPrevSegment)
-      {
-         if (pSegment->Number == pPrevSegment->Number)
-         {
-            LOG ("Error: Duplicate segment numbers");
-            LOG ("Segment files %s and %s have both segment number %u", pPrevSegment->pName, pSegment->pName, pSegment->Number);
-            CHK_LEAVE (AEWF_DUPLICATE_SEGMENT_NUMBER)
-         }
-      }
-      if (pSegment->Number != (i+1))
-      {
-         LOG ("Error: Missing segment number(s)");
-         if (pPrevSegment)
-              LOG ("Previous segment file %s has segment number %u", pPrevSegment->pName, pPrevSegment->Number)
-         else LOG ("No previous segment file.")
-         LOG ("Following segment file %s has segment number %u", pSegment->pName    , pSegment->Number    );
-         CHK_LEAVE (AEWF_MISSING_SEGMENT_NUMBER)
-      }
-      pPrevSegment = pSegment;
-   }
-
-   // Find all tables in the segment files
-   // ------------------------------------
-   pAewf->pTableArr      = NULL;
-   pAewf->Tables         = 0;
-   pAewf->Chunks         = 0;
-   pAewf->TotalTableSize = 0;
-   SectionSectorsPos     = 0;
-   SectionSectorsSize    = 0;
-
-   LOG ("Reading tables");
-   for (uint64_t i=0; i<pAewf->Segments; i++)
-   {
-      pSegment = &pAewf->pSegmentArr[i];
-      CHK_LEAVE (OpenFile (&pFile, pSegment->pName, &FileSize))
-      if (FileSize != pSegment->FileSize)
-         CHK_LEAVE (AEWF_FILESIZE_CHANGED)
-
-      CHK_LEAVE (ReadFilePos (pAewf, pFile, &FileHeader, sizeof(FileHeader), 0))
-      Pos = sizeof (FileHeader);
-      LOG ("Segment %s ", pSegment->pName);
-      SectionsCount = 0;
-      // Search for the important sections
-      do
-      {
-         if (++SectionsCount > AEWF_MAX_SECTION_COUNT)
-         {
-            LOG ("Error: Segment file has unusual high number of sections (%s)", pSegment->pName);
-            CHK_LEAVE (AEWF_TOO_MANY_SECTIONS)
-         }
-
-         CHK_LEAVE (ReadFilePos (pAewf, pFile, &Section, sizeof (t_AewfSection), Pos))
-         if ((Pos + Section.Size) > pSegment->FileSize)
-            CHK_LEAVE (AEWF_SECTION_BEYOND_EOF)
-
-         int IsHeader  = strcasecmp ((char *)Section.Type, "header"  ) == 0;
-         int IsHeader2 = strcasecmp ((char *)Section.Type, "header2" ) == 0;
-
-         if (IsHeader || IsHeader2)
-         {
-            void     **ppHdr   = IsHeader ? (void **) &pHeader : (void **) &pHeader2;
-            uint64_t  *pHdrLen = IsHeader ? &HeaderLen         : &Header2Len;
-
-            if (Section.Size <= sizeof (t_AewfSection))  // There must be at least 1 byte of header data
-               CHK_LEAVE (AEWF_SECTION_HEADER_WRONG_SIZE)
-
-            if (*ppHdr == NULL)
-            {
-               *pHdrLen = Section.Size - sizeof(t_AewfSection);
-               if (*pHdrLen > AEWF_MAX_HEADER_LEN)
-                  CHK_LEAVE (AEWF_SECTION_HEADER_WRONG_SIZE)
-               CHK_LEAVE (ReadFileAlloc (pAewf, pFile, ppHdr, *pHdrLen))
-            }
-         }
-         else if (strcasecmp ((char *)Section.Type, "sectors") == 0)
-         {
-            if (Section.Size < sizeof (t_AewfSection))
-               CHK_LEAVE (AEWF_SECTION_SECTORS_WRONG_SIZE)
-            SectionSectorsPos  = Pos;
-            SectionSectorsSize = Section.Size;
-         }
-         else if (strcasecmp ((char *)Section.Type, "table") == 0)
-         {
-            if (pVolume == NULL)                               CHK_LEAVE (AEWF_VOLUME_MUST_PRECEDE_TABLES)
-            if (SectionSectorsSize == 0)                       CHK_LEAVE (AEWF_SECTORS_MUST_PRECEDE_TABLES)
-            if (Section.Size < (sizeof (t_AewfSection) + 
-                                sizeof (t_AewfSectionTable)))  CHK_LEAVE (AEWF_SECTION_TABLE_WRONG_SIZE)
-
-            CHK_LEAVE (ReadFileAlloc (pAewf, pFile, (void**) &pEwfTable, sizeof(t_AewfSectionTable))) // No need to read the part that contains the chunk offsets (array at structure end)
-            if (pEwfTable->ChunkCount)  // Disregard tables having zero chunks
-            {
-               pAewf->Tables++;
-               pAewf->pTableArr = (t_pTable) realloc (pAewf->pTableArr, pAewf->Tables * sizeof (t_Table));
-               pTable = &pAewf->pTableArr[pAewf->Tables-1];
-               pTable->Nr                 = pAewf->Tables-1;
-               pTable->pSegment           = pSegment;
-               pTable->Offset             = Pos          + sizeof (t_AewfSection);
-               pTable->Size               = Section.Size - sizeof (t_AewfSection); 
-               pTable->ChunkCount         = pEwfTable->ChunkCount;
-               pTable->LastUsed           = 0;
-               pTable->pEwfTable          = NULL;
-               pTable->ChunkFrom          = pAewf->Chunks;
-               pTable->SectionSectorsPos  = SectionSectorsPos;
-               pTable->SectionSectorsSize = SectionSectorsSize;
-               pAewf->TotalTableSize     += pTable->Size;
-               pAewf->Chunks             += pTable->ChunkCount;
-               pTable->ChunkTo            = pAewf->Chunks-1;
-               SectionSectorsPos  = 0;
-               SectionSectorsSize = 0;
-
-               // Is the offset array big enough for the number of chunks?
-               // Is the file long enough for holding the table?
-               uint64_t MaxArrayEntries = (pTable->Size - sizeof(t_AewfSectionTable)) / sizeof(uint32_t);
-               if (MaxArrayEntries                 < pTable->ChunkCount)   CHK_LEAVE (AEWF_SECTION_TABLE_WRONG_SIZE)
-               if ((pTable->Offset + pTable->Size) > pSegment->FileSize)   CHK_LEAVE (AEWF_SECTION_TABLE_BEYOND_EOF)
-            }
-            SAFE_FREE (pEwfTable, sizeof(t_AewfSectionTable));
-         }
-
-         else if ( ((strcasecmp ((char *)Section.Type, "volume") == 0) || // Guymager works with the volume section. Others use different names
-                    (strcasecmp ((char *)Section.Type, "disk"  ) == 0) || // for it, but it all is the same. See Joachim Metz' EWF documentation
-                    (strcasecmp ((char *)Section.Type, "data"  ) == 0))
-                 && (pVolume==NULL))
-         {
-            if (Section.Size < (sizeof (t_AewfSection)+sizeof(t_AewfSectionVolume)))
-               CHK_LEAVE (AEWF_SECTION_VOLUME_WRONG_SIZE)
-
-            CHK_LEAVE (ReadFileAlloc (pAewf, pFile, (void**) &pVolume, sizeof(t_AewfSectionVolume)))
-            pAewf->Sectors    = pVolume->SectorCount;
-            pAewf->SectorSize = pVolume->BytesPerSector;
-            pAewf->ChunkSize  = pVolume->SectorsPerChunk * (uint64_t) pVolume->BytesPerSector;
-            pAewf->ImageSize  = pAewf->Sectors * pAewf->SectorSize;
-         }
-         if (strcasecmp ((char *)Section.Type, "hash") == 0)
-         {
-            if (Section.Size < (sizeof (t_AewfSection) + sizeof(t_AewfSectionHash)))
-               CHK_LEAVE (AEWF_SECTION_HASH_WRONG_SIZE)
-
-            CHK_LEAVE (ReadFileAlloc (pAewf, pFile, (void**) &pMD5, sizeof(t_AewfSectionHash)))
-         }
-//         LOG ("Section %s", Section.Type)
-
-         LastSection = (Pos == Section.OffsetNextSection) ||  // This is the official marker for the last section
-                       (Pos == 0);                            // This is an error - normally - but let's be fault tolerant
-         if (!LastSection)
-         {
-            if ( (Section.OffsetNextSection        <= Pos) ||         // Test works even if unsigned substraction 
-                ((Section.OffsetNextSection - Pos) <  Section.Size))  // would result would in integer wrap around
-            {
-               LOG ("Error: Next section must lie beyond current section (%s %"PRIu64" / %"PRIu64")", pSegment->pName, Section.OffsetNextSection, Pos)
-               CHK_LEAVE (AEWF_SECTION_STARTPOS_ERROR)
-            }
-            Pos = Section.OffsetNextSection;
-         }
-      } while (!LastSection);
-      CHK_LEAVE (CloseFile (&pFile))
-   }
-   if (pVolume == NULL)
-      CHK_LEAVE (AEWF_VOLUME_MISSING)
-
-   if (pAewf->Chunks != pVolume->ChunkCount)
-   {
-      LOG ("Error: Wrong chunk count: %"PRIu64" / %"PRIu64, pAewf->Chunks, pVolume->ChunkCount);
-      LOG ("Maybe some segment files are missing. Perhaps you specified E01 instead of E?? or the segments continue beyond extension .EZZ.");
-      CHK_LEAVE (AEWF_WRONG_CHUNK_COUNT)
-   }
-
-   // Check for reasonable limits in order to detect corrupt images 
-   // -------------------------------------------------------------
-   if (pAewf->Sectors == 0) 
-   {
-      LOG ("Error: Image contains zero sectors.");
-      CHK_LEAVE (AEWF_ZERO_SECTORS)
-   }
-   if ((pAewf->SectorSize == 0) || 
-       (pAewf->SectorSize > AEWF_MAX_SECTOR_SIZE))
-   {
-      LOG ("Error: Image has invalid number of bytes per sector: %"PRIu32, pVolume->BytesPerSector);
-      CHK_LEAVE (AEWF_INVALID_SECTOR_SIZE)
-
-   }
-   if ((pAewf->ChunkSize == 0) || 
-       (pAewf->ChunkSize > AEWF_MAX_CHUNK_SIZE))
-   {
-      LOG ("Error: Image has invalid chunk size: %"PRIu64, pAewf->ChunkSize);
-      CHK_LEAVE (AEWF_INVALID_CHUNK_SIZE)
-
-   }
-   if (pAewf->ImageSize == 0) 
-   {
-      LOG ("Error: Image size is zero.");
-      CHK_LEAVE (AEWF_ZERO_IMAGE_SIZE)
-   }
-   if ((pAewf->Tables == 0) || (pAewf->Tables > AEWF_MAX_TABLES))
+   if (pAewf->pSidecarPath)
    {
-      LOG ("Error: Number of AEWF tables is %"PRIu64, pAewf->Tables);
-      CHK_LEAVE (AEWF_NUMBER_OF_TABLES)
+      rc = AewfSidecarLoad (pAewf, ppFilenameArr, FilenameArrLen);
+      if (rc == AEWF_OK)
+           SidecarLoaded = TRUE;
+      else LOG ("Sidecar index %s not used (%s), scanning segment files", pAewf->pSidecarPath, AewfGetErrorMessage (rc));
    }
+   if (!SidecarLoaded)
+      CHK_LEAVE (AewfOpenScan (pAewf, ppFilenameArr, FilenameArrLen))
 
    pAewf->ChunkBuffSize = pAewf->ChunkSize + 4096; // reserve some extra space (for CRC and as compressed data might be slightly larger than uncompressed data with some imagers)
    pAewf->pChunkBuffCompressed   = (char *) malloc (pAewf->ChunkBuffSize);
@@ -1571,39 +3059,79 @@ int AewfOpen (void *pHandle, const char **ppFilenameArr, uint64_t FilenameArrLen
 
    pAewf->TableCache      = 0;
    pAewf->OpenSegments    = 0;
+   XmountInflateInit (&pAewf->Inflate);
+   LOG ("Inflate backend: %s", XmountInflateBackend());
+   LOG ("Adler-32 backend: %s", XmountAdler32Backend());
+   pAewf->SegmentLru.pHead = NULL;
+   pAewf->SegmentLru.pTail = NULL;
+   pAewf->TableLru.pHead   = NULL;
+   pAewf->TableLru.pTail   = NULL;
+
+   CHK_LEAVE (AewfChunkCacheInit (pAewf))
+   CHK_LEAVE (AewfZeroChunksInit (pAewf))
+   if (pAewf->ChunkIndex && (pAewf->pChunkIndexArr == NULL))
+      CHK_LEAVE (AewfBuildChunkIndex (pAewf))
+   if (pAewf->pSidecarPath && !SidecarLoaded)
+   {
+      rc = AewfSidecarWrite (pAewf);   // Not fatal, the image can be used anyway
+      if (rc != AEWF_OK)
+         LOG ("Writing sidecar index %s failed (%s)", pAewf->pSidecarPath, AewfGetErrorMessage (rc));
+   }
 
-   CHK_LEAVE (CreateInfoData (pAewf, pVolume, pHeader, HeaderLen, pHeader2, Header2Len, pMD5))
-
-   // Allocate thread structures
-   // --------------------------
+   // Allocate thread structures and start the workers
+   // ------------------------------------------------
    if (pAewf->Threads > 1)
    {
+      if (pthread_mutex_init (&pAewf->Pool.Mutex, NULL) != 0)
+         CHK_LEAVE (AEWF_ERROR_PTHREAD)
+      if (pthread_cond_init (&pAewf->Pool.CondDone, NULL) != 0)
+      {
+         (void) pthread_mutex_destroy (&pAewf->Pool.Mutex);
+         CHK_LEAVE (AEWF_ERROR_PTHREAD)
+      }
+      pAewf->Pool.Initialised = TRUE;
+      pAewf->Pool.Busy        = 0;
+      pAewf->Pool.Prefetching = 0;
+      pAewf->Pool.Shutdown    = FALSE;
       pAewf->pThreadArr = (t_pAewfThread) malloc (pAewf->Threads * sizeof (t_AewfThread));
       if (pAewf->pThreadArr == NULL)
             CHK_LEAVE (AEWF_MEMALLOC_FAILED)
+      memset (pAewf->pThreadArr, 0, pAewf->Threads * sizeof (t_AewfThread));
       for (uint32_t i=0; i<pAewf->Threads; i++)
       {
          t_pAewfThread pThread = &pAewf->pThreadArr[i];
-         memset (pThread, 0, sizeof(t_AewfThread));
          pThread->pAewf                  = pAewf;
+         pThread->pPool                  = &pAewf->Pool;
+         pThread->pChunkCache            = &pAewf->ChunkCache;
+         pThread->pZeroChunks            = &pAewf->ZeroChunks;
          pThread->pChunkBuffCompressed   = (char *) malloc (pAewf->ChunkBuffSize);
          pThread->pChunkBuffUncompressed = (char *) malloc (pAewf->ChunkBuffSize);
          pThread->ChunkInBuff            = AEWF_NONE;
          pThread->State                  = AEWF_IDLE;
+         XmountInflateInit (&pThread->Inflate);
          if ((pThread->pChunkBuffCompressed   == NULL) ||
              (pThread->pChunkBuffUncompressed == NULL))
             CHK_LEAVE (AEWF_MEMALLOC_FAILED)
+         if (pthread_cond_init (&pThread->CondJob, NULL) != 0)
+            CHK_LEAVE (AEWF_ERROR_PTHREAD)
+         if (pthread_create (&pThread->ID, NULL, AewfWorker, pThread) != 0)
+         {
+            (void) pthread_cond_destroy (&pThread->CondJob);
+            CHK_LEAVE (AEWF_ERROR_PTHREAD)
+         }
+         pThread->Running = TRUE;
       }
    }
+   AewfUringInit (pAewf);
 
    rc = AEWF_OK;
 
 Leave:
-   SAFE_FREE (pVolume  , sizeof(t_AewfSectionVolume));
-   SAFE_FREE (pHeader  , HeaderLen);
-   SAFE_FREE (pHeader2 , Header2Len);
-   SAFE_FREE (pMD5     , sizeof (t_AewfSectionHash));
-   SAFE_FREE (pEwfTable, sizeof(t_AewfSectionTable));
+   if ((rc != AEWF_OK) && Opened)   // Free whatever has been set up so far, the handle stays closed
+   {
+      (void) AewfClose (pAewf);
+      pAewf->Open = FALSE;
+   }
 
    LOG ("Ret");
    return rc;
@@ -1623,20 +3151,44 @@ static int AewfClose (void *pHandle)
 
    CHK (UpdateStats (pAewf,TRUE))
 
-   // Check if all threads ended and free structures
-   // ----------------------------------------------
-   if (pAewf->pThreadArr)
+   // Stop the workers and free structures
+   // ------------------------------------
+   AewfUringDeInit (pAewf);
+   if (pAewf->pThreadArr)   // Only allocated once the pool has been initialised
    {
+      (void) pthread_mutex_lock (&pAewf->Pool.Mutex);
+      pAewf->Pool.Shutdown = TRUE;
+      for (uint32_t i=0; i<pAewf->Threads; i++)
+      {
+         if (pAewf->pThreadArr[i].Running)
+            (void) pthread_cond_signal (&pAewf->pThreadArr[i].CondJob);
+      }
+      (void) pthread_mutex_unlock (&pAewf->Pool.Mutex);
+
       for (uint32_t i=0; i<pAewf->Threads; i++)
       {
          t_pAewfThread pThread = &pAewf->pThreadArr[i];
-         if (pThread->State != AEWF_IDLE)
-            CHK (AEWF_THREADS_STILL_RUNNING)
+         if (pThread->Running)
+         {
+            if (pthread_join (pThread->ID, NULL) != 0)
+               CHK (AEWF_THREADS_STILL_RUNNING)
+            (void) pthread_cond_destroy (&pThread->CondJob);
+            pThread->Running = FALSE;
+         }
          SAFE_FREE (pThread->pChunkBuffCompressed  , pAewf->ChunkBuffSize);
          SAFE_FREE (pThread->pChunkBuffUncompressed, pAewf->ChunkBuffSize);
+         XmountInflateDeInit (&pThread->Inflate);
       }
       SAFE_FREE (pAewf->pThreadArr, pAewf->Threads * sizeof (t_AewfThread));
    }
+   if (pAewf->Pool.Initialised)
+   {
+      (void) pthread_cond_destroy  (&pAewf->Pool.CondDone);
+      (void) pthread_mutex_destroy (&pAewf->Pool.Mutex);
+      pAewf->Pool.Initialised = FALSE;
+   }
+   AewfChunkCacheDeInit (&pAewf->ChunkCache);
+   AewfZeroChunksDeInit (&pAewf->ZeroChunks);
 
    for (uint64_t i=0; i<pAewf->Tables; i++)
    {
@@ -1648,17 +3200,19 @@ static int AewfClose (void *pHandle)
    for (uint64_t i=0; i<pAewf->Segments; i++)
    {
       pSegment = &pAewf->pSegmentArr[i];
-      if (pSegment->pFile)
-         CHK (CloseFile (&pSegment->pFile));
+      if (pSegment->Fd >= 0)
+         CHK (CloseFile (&pSegment->Fd));
       SAFE_FREE (pSegment->pName);
    }
    pAewf->Segments = 0;
 
+   SAFE_FREE (pAewf->pChunkIndexArr, pAewf->Chunks * sizeof (t_AewfChunkIndex));
    SAFE_FREE (pAewf->pTableArr  , pAewf->Tables   * sizeof (t_Table));
    SAFE_FREE (pAewf->pSegmentArr, pAewf->Segments * sizeof (t_Segment));
    SAFE_FREE (pAewf->pChunkBuffCompressed  , pAewf->ChunkBuffSize);
    SAFE_FREE (pAewf->pChunkBuffUncompressed, pAewf->ChunkBuffSize);
    SAFE_FREE (pAewf->pInfo);
+   XmountInflateDeInit (&pAewf->Inflate);
 
    pAewf->Open = FALSE;
 
@@ -1710,9 +3264,24 @@ static int AewfRead (void *pHandle, char *pBuf, off_t Seek, size_t Count, size_t
    if ((Seek64+Count) > pAewf->ImageSize) // image simply return what
       Count = pAewf->ImageSize - Seek64;  // is possible.
 
+   if (Seek64 == pAewf->SeqNextPos)  // Sequential access detection for the readahead
+        pAewf->SeqReads++;
+   else pAewf->SeqReads = 0;
+   pAewf->SeqNextPos = Seek64 + Count;
+
    if (pAewf->Threads == 1)
-        rc = AewfReadLegacy (pAewf, pBuf, Seek64, Count, pRead, pErrno);
-   else rc = AewfReadMT     (pAewf, pBuf, Seek64, Count, pRead, pErrno);
+   {
+      rc = AewfReadLegacy (pAewf, pBuf, Seek64, Count, pRead, pErrno);
+      if (pAewf->Readahead && (pAewf->SeqReads >= AEWF_READAHEAD_SEQREADS))  // No workers for decompressing in advance,
+      {                                                                     // let the kernel do its part at least
+         uint64_t NextChunk = (Seek64 + Count) / pAewf->ChunkSize;
+         AewfAdvise (pAewf, NextChunk, NextChunk + 2*pAewf->Readahead);
+      }
+   }
+   else
+   {
+      rc = AewfReadMT (pAewf, pBuf, Seek64, Count, pRead, pErrno);
+   }
 
    rc = AEWF_OK;
 
@@ -1723,6 +3292,89 @@ Leave:
    return rc;
 }
 
+// AewfZeroChunkProbe finds out if a chunk is zero without reading it entirely. Only small
+// compressed chunks are looked at, they're compared against the known zero signatures or
+// decompressed otherwise (which possibly yields a new signature).
+
+static int AewfZeroChunkProbe (t_pAewf pAewf, uint64_t AbsoluteChunk, int *pZero)
+{
+   t_pSegment pSegment;
+   uint64_t   SeekPos;
+   uint64_t   DstLen;
+   uint32_t   ReadLen;
+   int        Compressed;
+
+   *pZero = AewfZeroChunkKnown (&pAewf->ZeroChunks, AbsoluteChunk);
+   if (*pZero)
+      return AEWF_OK;
+
+   CHK (AewfLocateChunk (pAewf, AbsoluteChunk, &pSegment, &SeekPos, &ReadLen, &Compressed))
+   if (!Compressed || (ReadLen > AEWF_ZERO_SIGNATURE_MAXLEN))
+      return AEWF_OK;
+
+   CHK (ReadFilePos (pAewf, pSegment->Fd, pAewf->pChunkBuffCompressed, ReadLen, SeekPos))
+   pAewf->DataReadFromImage += ReadLen;
+   if (AewfZeroSignatureMatch (&pAewf->ZeroChunks, pAewf->pChunkBuffCompressed, ReadLen))
+   {
+      AewfZeroChunkMark (&pAewf->ZeroChunks, AbsoluteChunk);
+      *pZero = TRUE;
+      return AEWF_OK;
+   }
+
+   pAewf->ChunkInBuff = AEWF_NONE;  // The buffer is used by the legacy read functions as well
+   DstLen = pAewf->ChunkBuffSize;
+   if (XmountInflate (&pAewf->Inflate, XmountInflateFormat_Zlib, pAewf->pChunkBuffUncompressed, &DstLen, pAewf->pChunkBuffCompressed, ReadLen) != Z_OK)
+      return AEWF_OK;  // Let AewfRead report the error
+   if ((DstLen == AewfChunkLen (pAewf, AbsoluteChunk)) && AewfIsZeroData (pAewf->pChunkBuffUncompressed, DstLen))
+   {
+      AewfZeroChunkLearn (&pAewf->ZeroChunks, AbsoluteChunk, pAewf->pChunkBuffCompressed, ReadLen);
+      *pZero = TRUE;
+   }
+
+   return AEWF_OK;
+}
+
+static int AewfGetExtents (void *pHandle, uint64_t Offset, uint64_t Count, pts_LibXmountExtent *ppExtents, uint64_t *pExtentsCount)
+{
+   t_pAewf              pAewf      = (t_pAewf) pHandle;
+   pts_LibXmountExtent pExtentArr = NULL;
+   uint64_t             Extents    = 0;
+   uint64_t             AbsoluteChunk;
+   uint64_t             End;
+   uint64_t             ChunkEnd;
+   int                  Zero;
+   int                  rc;
+
+   LOG ("Called - Offset=%'" PRIu64 ",Count=%'" PRIu64, Offset, Count);
+   CHK (AewfCheckHandle (pHandle))
+
+   *ppExtents     = NULL;
+   *pExtentsCount = 0;
+   if (Offset >= pAewf->ImageSize)
+      return AEWF_OK;
+   End = GETMIN (Offset + Count, pAewf->ImageSize);
+
+   AbsoluteChunk = Offset / pAewf->ChunkSize;
+   while (Offset < End)
+   {
+      ChunkEnd = GETMIN ((AbsoluteChunk+1) * pAewf->ChunkSize, End);
+      CHK_LEAVE (AewfZeroChunkProbe (pAewf, AbsoluteChunk, &Zero))
+      if (AddExtent (&pExtentArr, &Extents, Offset, ChunkEnd - Offset, Zero ? LibXmountExtentType_Zero : LibXmountExtentType_Data) != 0)
+         CHK_LEAVE (AEWF_MEMALLOC_FAILED)
+      Offset = ChunkEnd;
+      AbsoluteChunk++;
+   }
+   *ppExtents     = pExtentArr;
+   *pExtentsCount = Extents;
+   pExtentArr     = NULL;
+   rc = AEWF_OK;
+
+Leave:
+   SAFE_FREE (pExtentArr);
+   LOG ("Ret %d - %" PRIu64 " extents", rc, *pExtentsCount);
+   return rc;
+}
+
 static int AewfOptionsHelp (const char **ppHelp)
 {
    char *pHelp=NULL;
@@ -1735,14 +3387,37 @@ static int AewfOptionsHelp (const char **ppHelp)
                           "    %-12s : The update interval, in seconds, for the statistics (%s must be set). Default: %"PRIu64"s.\n"
                           "    %-12s : Path for writing log file (must exist).\n"
                           "                   The files created in this directory will be named log_<pid>.\n"
-                          "    %-12s : Max. number of threads for parallelized decompression. Default: System CPUs (%"PRIu32")\n"
-                          "                   A value of 1 switches back to old, single-threaded legacy functions.\n",
+                          "    %-12s : Max. number of threads for parallelized decompression and for scanning\n"
+                          "                   the segment files when opening the image. Default: System CPUs (%"PRIu32")\n"
+                          "                   A value of 1 switches back to old, single-threaded legacy functions.\n"
+                          "    %-12s : Maximum amount of RAM, in MiB, for caching uncompressed chunks. Default: %"PRIu64" MiB\n"
+                          "                   A value of 0 switches the chunk cache off.\n"
+                          "    %-12s : Set to 1 for building a flat index of all chunks when opening the image. It needs %u bytes\n"
+                          "                   of RAM per chunk, but avoids reading image offset tables later on. Default: 0\n"
+                          "    %-12s : Path of a sidecar index file. If it exists and matches the segment files, it is used\n"
+                          "                   instead of scanning all segment files. Otherwise it is (re-)written after the scan.\n"
+                          "    %-12s : Chunk checksum verification: off, sampled (every %uth chunk) or full. Default: full\n"
+                          "    %-12s : Number of chunks to be decompressed in advance when reading sequentially. Default: %"PRIu64"\n"
+                          "                   A value of 0 switches the readahead off.\n"
+                          "    %-12s : Set to 0 for reading chunks with pread instead of submitting them in batches by means\n"
+                          "                   of io_uring. Default: 1 (%s)\n",
                           AEWF_OPTION_TABLECACHE,      AEWF_DEFAULT_TABLECACHE,
                           AEWF_OPTION_MAXOPENSEGMENTS, AEWF_DEFAULT_MAXOPENSEGMENTS,
                           AEWF_OPTION_STATS,
                           AEWF_OPTION_STATSREFRESH, AEWF_OPTION_STATS, AEWF_DEFAULT_STATSREFRESH,
                           AEWF_OPTION_LOG,
-                          AEWF_OPTION_THREADS, GetCPUs(NULL));
+                          AEWF_OPTION_THREADS, GetCPUs(NULL),
+                          AEWF_OPTION_CHUNKCACHE, AEWF_DEFAULT_CHUNKCACHE,
+                          AEWF_OPTION_CHUNKINDEX, (unsigned) sizeof (t_AewfChunkIndex),
+                          AEWF_OPTION_SIDECAR,
+                          AEWF_OPTION_VERIFY, AEWF_VERIFY_SAMPLE_INTERVAL,
+                          AEWF_OPTION_READAHEAD, AEWF_DEFAULT_READAHEAD,
+                          AEWF_OPTION_URING,
+#ifdef HAVE_LIBURING
+                          "io_uring is used if the kernel supports it");
+#else
+                          "not available, built without liburing");
+#endif
    if ((pHelp == NULL) || (wr<=0))
       return AEWF_MEMALLOC_FAILED;
 
@@ -1809,11 +3484,40 @@ static int AewfOptionsParse (void *pHandle, uint32_t OptionCount, const pts_LibX
          pOption->valid = TRUE;
          LOG ("Option %s set to %s (full path %s)", AEWF_OPTION_STATS, pOption->p_value, pAewf->pLogPath);
       }
+      else if (strcmp (pOption->p_key, AEWF_OPTION_SIDECAR) == 0)
+      {
+         SAFE_FREE (pAewf->pSidecarPath);
+         pAewf->pSidecarPath = strdup (pOption->p_value);  // The file itself needn't exist yet
+         if (pAewf->pSidecarPath == NULL)
+         {
+            pError = "Cannot allocate memory for sidecar path";
+            break;
+         }
+         pOption->valid = TRUE;
+         LOG ("Option %s set to %s", AEWF_OPTION_SIDECAR, pAewf->pSidecarPath);
+      }
+      else if (strcmp (pOption->p_key, AEWF_OPTION_VERIFY) == 0)
+      {
+         if      (strcmp (pOption->p_value, "off"    ) == 0) pAewf->Verify = AEWF_VERIFY_OFF;
+         else if (strcmp (pOption->p_value, "sampled") == 0) pAewf->Verify = AEWF_VERIFY_SAMPLED;
+         else if (strcmp (pOption->p_value, "full"   ) == 0) pAewf->Verify = AEWF_VERIFY_FULL;
+         else
+         {
+            pError = "Error in option aewfverify: Use off, sampled or full";
+            break;
+         }
+         pOption->valid = TRUE;
+         LOG ("Option %s set to %s", AEWF_OPTION_VERIFY, pOption->p_value);
+      }
 
       else TEST_OPTION_UINT64 (AEWF_OPTION_MAXOPENSEGMENTS, MaxOpenSegments)
       else TEST_OPTION_UINT64 (AEWF_OPTION_TABLECACHE     , MaxTableCache)
       else TEST_OPTION_UINT64 (AEWF_OPTION_STATSREFRESH   , StatsRefresh)
       else TEST_OPTION_UINT64 (AEWF_OPTION_THREADS        , Threads)
+      else TEST_OPTION_UINT64 (AEWF_OPTION_CHUNKCACHE     , MaxChunkCache)
+      else TEST_OPTION_UINT64 (AEWF_OPTION_CHUNKINDEX     , ChunkIndex)
+      else TEST_OPTION_UINT64 (AEWF_OPTION_READAHEAD      , Readahead)
+      else TEST_OPTION_UINT64 (AEWF_OPTION_URING          , UseUring)
    }
    #undef TEST_OPTION_UINT64
 
@@ -1843,6 +3547,66 @@ static int AewfGetInfofileContent (void *pHandle, const char **ppInfoBuf)
    return AEWF_OK;
 }
 
+static int AewfGetStats (void *pHandle, pts_LibXmountStat *ppStats, uint32_t *pStatsCount)
+{
+   t_pAewf           pAewf  = (t_pAewf) pHandle;
+   pts_LibXmountStat pStats = NULL;
+   uint32_t          Count  = 0;
+   uint64_t          LruHits, LruMisses, LruEntries;
+
+   LOG ("Called");
+   CHK (AewfCheckHandle (pHandle))
+
+   #define ADD_STAT(Key,Value)                                 \
+      if (AddStat (&pStats, &Count, Key, Value) != 0)          \
+      {                                                        \
+         free (pStats);                                        \
+         return AEWF_MEMALLOC_FAILED;                          \
+      }
+
+   ADD_STAT ("Segment cache hits"            , pAewf->SegmentCacheHits                 )
+   ADD_STAT ("Segment cache misses"          , pAewf->SegmentCacheMisses               )
+   ADD_STAT ("Open segment files"            , pAewf->OpenSegments                     )
+   ADD_STAT ("Table cache hits"              , pAewf->TableCacheHits                   )
+   ADD_STAT ("Table cache misses"            , pAewf->TableCacheMisses                 )
+   ADD_STAT ("Table cache size (bytes)"      , pAewf->TableCache                       )
+   ADD_STAT ("Chunk cache hits"              , pAewf->ChunkCacheHits                   )
+   ADD_STAT ("Chunk cache misses"            , pAewf->ChunkCacheMisses                 )
+   AewfChunkCacheCounters (&pAewf->ChunkCache, &LruHits, &LruMisses, &LruEntries);
+   ADD_STAT ("Chunk LRU hits"                , LruHits                                 )
+   ADD_STAT ("Chunk LRU misses"              , LruMisses                               )
+   ADD_STAT ("Chunk LRU entries"             , LruEntries                              )
+   ADD_STAT ("Chunk index size (bytes)"      , pAewf->pChunkIndexArr ? pAewf->Chunks * sizeof (t_AewfChunkIndex) : 0)
+   ADD_STAT ("Read operations"               , pAewf->ReadOperations                   )
+   ADD_STAT ("Data read from image (bytes)"  , pAewf->DataReadFromImage                )
+   ADD_STAT ("Data read, uncompressed"       , pAewf->DataReadFromImageRaw             )
+   ADD_STAT ("Data requested by caller"      , pAewf->DataRequestedByCaller            )
+   ADD_STAT ("Tables read from image (bytes)", pAewf->TablesReadFromImage              )
+   ADD_STAT ("Chunks read"                   , pAewf->ChunksRead                       )
+   ADD_STAT ("Chunks verified"               , pAewf->ChunksVerified                   )
+   ADD_STAT ("Zero chunks found"             , __atomic_load_n (&pAewf->ZeroChunks.Found, __ATOMIC_RELAXED))
+   ADD_STAT ("Zero chunk reads"              , pAewf->ZeroChunkReads                   )
+   ADD_STAT ("Readahead chunks"              , pAewf->ReadaheadChunks                  )
+   ADD_STAT ("io_uring chunk reads"          , pAewf->UringReads                       )
+   ADD_STAT ("io_uring batches"              , pAewf->UringBatches                     )
+   ADD_STAT ("Bytes read"                    , pAewf->BytesRead                        )
+   ADD_STAT ("Read requests <= 32K"          , pAewf->ReadSizesArr[READSIZE_32K      ] )
+   ADD_STAT ("Read requests <= 64K"          , pAewf->ReadSizesArr[READSIZE_64K      ] )
+   ADD_STAT ("Read requests <= 128K"         , pAewf->ReadSizesArr[READSIZE_128K     ] )
+   ADD_STAT ("Read requests <= 256K"         , pAewf->ReadSizesArr[READSIZE_256K     ] )
+   ADD_STAT ("Read requests <= 512K"         , pAewf->ReadSizesArr[READSIZE_512K     ] )
+   ADD_STAT ("Read requests <= 1M"           , pAewf->ReadSizesArr[READSIZE_1M       ] )
+   ADD_STAT ("Read requests > 1M"            , pAewf->ReadSizesArr[READSIZE_ABOVE_1M ] )
+   ADD_STAT ("Errors"                        , pAewf->Errors                           )
+   #undef ADD_STAT
+
+   *ppStats     = pStats;
+   *pStatsCount = Count;
+
+   LOG ("Ret - %u counters", Count);
+   return AEWF_OK;
+}
+
 static const char* AewfGetErrorMessage (int ErrNum)
 {
    const char *pMsg;
@@ -1913,6 +3677,10 @@ static const char* AewfGetErrorMessage (int ErrNum)
       ADD_ERR (AEWF_SECTION_HEADER_WRONG_SIZE)
       ADD_ERR (AEWF_SECTION_VOLUME_WRONG_SIZE)
       ADD_ERR (AEWF_SECTION_HASH_WRONG_SIZE)
+      ADD_ERR (AEWF_SIDECAR_INVALID)
+      ADD_ERR (AEWF_SIDECAR_SEGMENT_CHANGED)
+      ADD_ERR (AEWF_SIDECAR_WRITE_FAILED)
+      ADD_ERR (AEWF_URING_FAILED)
 
       default:
          pMsg = "Unknown error";
@@ -1953,9 +3721,11 @@ void LibXmount_Input_GetFunctions (ts_LibXmountInputFunctions *pFunctions)
    pFunctions->Close              = &AewfClose;
    pFunctions->Size               = &AewfSize;
    pFunctions->Read               = &AewfRead;
+   pFunctions->GetExtents         = &AewfGetExtents;
    pFunctions->OptionsHelp        = &AewfOptionsHelp;
    pFunctions->OptionsParse       = &AewfOptionsParse;
    pFunctions->GetInfofileContent = &AewfGetInfofileContent;
+   pFunctions->GetStats           = &AewfGetStats;
    pFunctions->GetErrorMessage    = &AewfGetErrorMessage;
    pFunctions->FreeBuffer         = &AewfFreeBuffer;
 }
@@ -2067,6 +3837,9 @@ int main(int argc, const char *argv[])
    char         *pOptions = NULL;
    const char   *pHelp;
    const char   *pInfoBuff;
+   struct timespec StartTime;
+   struct timespec EndTime;
+   double         Seconds;
 
    #ifdef CREATE_REVERSE_FILE
       FILE      *pFileRev;
@@ -2110,7 +3883,7 @@ int main(int argc, const char *argv[])
       pOptions = strdup (&(argv[argc-1][1]));
       argc--;
    }
-   rc = AewfCreateHandle ((void**) &pAewf, "aewf", LOG_STDOUT);
+   rc = AewfCreateHandle ((void**) &pAewf, NULL, "aewf", LOG_STDOUT);
    if (rc != AEWF_OK)
       PRINT_ERROR_AND_EXIT ("Cannot create handle, rc=%d\n", rc)
 
@@ -2121,7 +3894,7 @@ int main(int argc, const char *argv[])
       PRINT_ERROR_AND_EXIT ("Cannot open EWF files, rc=%d\n", rc)
 
    #if defined(CREATE_REVERSE_FILE) && defined(REVERSE_FILE_USES_SEPARATE_HANDLE)
-      rc = AewfCreateHandle ((void**) &pAewfRev, "aewf", LOG_STDOUT);
+      rc = AewfCreateHandle ((void**) &pAewfRev, NULL, "aewf", LOG_STDOUT);
       if (rc != AEWF_OK)
          PRINT_ERROR_AND_EXIT ("Cannot create reverse handle, rc=%d\n", rc)
       if (pOptions)
@@ -2154,6 +3927,7 @@ int main(int argc, const char *argv[])
    Pos        = 0;
    PercentOld = -1;
    Errno      = 0;
+   (void) clock_gettime (CLOCK_MONOTONIC, &StartTime);
    while (Remaining)
    {
 //      LOG ("Pos %" PRIu64 " -- Remaining %" PRIu64 " ", Pos, Remaining);
@@ -2194,6 +3968,10 @@ int main(int argc, const char *argv[])
          PercentOld = Percent;
       }
    }
+   (void) clock_gettime (CLOCK_MONOTONIC, &EndTime);
+   Seconds = (EndTime.tv_sec - StartTime.tv_sec) + (EndTime.tv_nsec - StartTime.tv_nsec) / 1e9;
+   printf ("\n%" PRIu64 " bytes in %.2f s, %.1f MiB/s (inflate backend %s)\n", TotalSize, Seconds,
+           Seconds > 0 ? TotalSize / (1024.0*1024.0) / Seconds : 0.0, XmountInflateBackend());
    if (fclose (pFile))
       PRINT_ERROR_AND_EXIT ("Error while closing destination file\n");
 
@@ -123,13 +123,32 @@ typedef struct
 } __attribute__ ((packed)) t_AewfSectionHash, *t_pAewfSectionHash;
 
 
+// Intrusive doubly linked LRU list, used for the open segment files and the loaded tables.
+// The node is embedded in t_Segment and t_Table; AEWF_LRU_ENTRY gets back from the node to
+// the structure containing it.
+
+typedef struct _t_AewfLruNode
+{
+   struct _t_AewfLruNode *pPrev;   // Towards the most recently used entry
+   struct _t_AewfLruNode *pNext;   // Towards the least recently used entry
+} t_AewfLruNode, *t_pAewfLruNode;
+
+typedef struct
+{
+   t_pAewfLruNode pHead;            // Most recently used
+   t_pAewfLruNode pTail;            // Least recently used, next to be evicted
+} t_AewfLru, *t_pAewfLru;
+
+#define AEWF_LRU_ENTRY(pNode,Type) ((Type *)((char *)(pNode) - offsetof(Type, Lru)))
+
 typedef struct
 {
-   char     *pName;
-   uint16_t   Number;       // Same type as t_AewfFileHeader.SegmentNumber
-   FILE     *pFile;         // NULL if file is not opened (never read or kicked out from cache)
-   uint64_t   FileSize;
-   time_t     LastUsed;
+   char         *pName;
+   uint16_t       Number;       // Same type as t_AewfFileHeader.SegmentNumber
+   int            Fd;           // -1 if file is not opened (never read or kicked out from cache)
+   uint32_t       Users;        // Number of worker jobs currently reading from Fd; the file must not be closed while non-zero
+   uint64_t       FileSize;
+   t_AewfLruNode  Lru;          // Position in pAewf->SegmentLru, only linked while Fd is open
 } t_Segment, *t_pSegment;
 
 typedef struct
@@ -143,10 +162,19 @@ typedef struct
    uint32_t             ChunkCount;         // The number of chunks; this is the same as pEwfTable->Chunkcount, however, pEwfTable might not be available (NULL)
    uint64_t             SectionSectorsPos;  // Seek position of corresponding section SECTORS in segment file and its length. Silly EWF format has no clean way
    uint32_t             SectionSectorsSize; // of determining size of the last (possibly compressed) chunk of a table, that's why we need to memorise these values.
-   time_t               LastUsed;           // Last usage of this table, for cache management
+   t_AewfLruNode        Lru;                // Position in pAewf->TableLru, only linked while pEwfTable is loaded
    t_pAewfSectionTable pEwfTable;           // Contains the original EWF table section or NULL, if never read or kicked out from cache
 } t_Table, *t_pTable;
 
+typedef struct
+{
+   uint64_t             Pos;                // Seek position of the chunk data in the segment file, ORed with AEWF_CHUNKINDEX_COMPRESSED for compressed chunks
+   uint32_t             Size;               // Length of the chunk data in the segment file
+   uint16_t             Segment;            // Index of the segment file in pAewf->pSegmentArr
+} __attribute__ ((packed)) t_AewfChunkIndex, *t_pAewfChunkIndex;
+
+const uint64_t AEWF_CHUNKINDEX_COMPRESSED = 0x8000000000000000ULL;
+
 #define AEWF_NONE UINT64_MAX
 
 enum
@@ -161,23 +189,130 @@ enum
    READSIZE_ARRLEN
 };
 
+// Multi-chunk cache of uncompressed chunks. It is split into shards (selected by chunk number
+// modulo number of shards), each one protected by its own mutex and holding its own hash table
+// and LRU list. This keeps lock contention low if several threads access the cache at the same time.
+
+typedef struct _t_AewfCacheEntry
+{
+   uint64_t                   Chunk;       // Absolute chunk number
+   uint64_t                   Len;         // Length of the chunk data (may be shorter than the chunk size for the last chunk)
+   char                     *pData;
+   struct _t_AewfCacheEntry *pPrev;        // LRU list: Towards the most recently used entry
+   struct _t_AewfCacheEntry *pNext;        // LRU list: Towards the least recently used entry
+   struct _t_AewfCacheEntry *pHashNext;
+} t_AewfCacheEntry, *t_pAewfCacheEntry;
+
+typedef struct
+{
+   pthread_mutex_t     Mutex;
+   t_pAewfCacheEntry *ppHashArr;
+   uint64_t            HashSize;
+   t_pAewfCacheEntry  pHead;               // Most recently used entry
+   t_pAewfCacheEntry  pTail;               // Least recently used entry, first to be recycled
+   uint64_t            Entries;
+   uint64_t            MaxEntries;
+   uint64_t            Hits;
+   uint64_t            Misses;
+} t_AewfCacheShard, *t_pAewfCacheShard;
+
+typedef struct
+{
+   t_pAewfCacheShard  pShardArr;           // NULL if the chunk cache is switched off
+   uint32_t            Shards;
+   uint64_t            EntrySize;          // Size of the data buffer of each entry (equals to the chunk size)
+} t_AewfChunkCache, *t_pAewfChunkCache;
+
+#define AEWF_CHUNKCACHE_SHARDS 16
+
+// Chunks known to contain only zeroes are marked in a bitmap and read by means of memset,
+// without any segment file I/O. A chunk gets marked when it is found to be zero after
+// decompression or, without decompressing it, if its compressed data is identical to
+// that of a zero chunk seen before (zero signature). As an imager normally compresses all
+// chunks the same way, all zero chunks of an image usually share the same signature.
+
+#define AEWF_ZERO_SIGNATURES        4
+#define AEWF_ZERO_SIGNATURE_MAXLEN  1024   // A compressed zero chunk is much smaller than that
+
+typedef struct
+{
+   uint8_t         *pBitmap;                 // One bit per chunk, set if the chunk only contains zeroes
+   uint64_t          BitmapSize;
+   uint64_t          Found;                   // Number of bits set in pBitmap
+   pthread_mutex_t   Mutex;                   // Serialises adding signatures
+   uint32_t          Signatures;              // Number of valid signatures, only incremented after the signature has been stored
+   uint32_t          SignatureLenArr[AEWF_ZERO_SIGNATURES];
+   char              SignatureArr   [AEWF_ZERO_SIGNATURES][AEWF_ZERO_SIGNATURE_MAXLEN];
+} t_AewfZeroChunks, *t_pAewfZeroChunks;
+
 typedef enum
 {
    AEWF_IDLE = 0,
    AEWF_LAUNCHED
 } t_AewfThreadState;
 
+typedef struct
+{
+   pthread_mutex_t    Mutex;       // Protects the JobPending fields of all workers as well as Busy and Shutdown
+   pthread_cond_t     CondDone;    // Signalled by the worker that brings Busy down to zero
+   uint32_t           Busy;        // Number of jobs launched but not yet finished (readahead jobs not included)
+   uint32_t           Prefetching; // Number of readahead jobs launched but not yet finished
+   uint8_t            Shutdown;    // Set by AewfClose in order to terminate the workers
+   uint8_t            Initialised; // Mutex and CondDone have been set up and must be destroyed by AewfClose
+} t_AewfPool, *t_pAewfPool;
+
+// Batched chunk reads by means of io_uring (only if built with liburing, option aewfuring). The
+// reading thread queues the reads of all chunks of a request plus its readahead, submits them
+// with a single system call and launches the corresponding worker as soon as a read completes.
+typedef struct
+{
+   uint8_t            Active;      // The ring has been set up and is used for reading chunks
+   uint32_t           Queued;      // Reads prepared, but not yet submitted
+   uint32_t           InFlight;    // Reads submitted, but whose completion hasn't been reaped yet
+#ifdef HAVE_LIBURING
+   struct io_uring    Ring;
+#endif
+} t_AewfUring, *t_pAewfUring;
+
+// Chunk integrity verification (option aewfverify). The Adler-32 checksums of uncompressed
+// chunks are compared against the checksum stored behind the chunk, compressed chunks are
+// checked by the decompressor against the zlib stream's Adler-32 trailer.
+typedef enum
+{
+   AEWF_VERIFY_OFF = 0,   // No checksum is verified at all
+   AEWF_VERIFY_SAMPLED,   // Only every AEWF_VERIFY_SAMPLE_INTERVAL-th chunk is verified
+   AEWF_VERIFY_FULL       // All chunks are verified
+} t_AewfVerify;
+
+#define AEWF_VERIFY_SAMPLE_INTERVAL 16
+
+#define AEWF_READAHEAD_SEQREADS      2   // Number of directly consecutive read requests before readahead starts
+
 typedef struct _t_AewfThread
 {
-   t_AewfThreadState  State;
+   t_AewfThreadState  State; // Only accessed by the reading thread; LAUNCHED until the job's ReturnCode has been collected
    t_pcAewf          pAewf; // Give the threads access to some Aewf constants - make sure the threads only have read access
+   t_pAewfPool       pPool;
+   t_pAewfChunkCache pChunkCache;   // Successfully uncompressed/verified chunks are put into the chunk cache by the worker itself
+   t_pAewfZeroChunks pZeroChunks;   // Chunks found to be zero are marked there by the worker itself
    pthread_t          ID;
+   uint8_t            Running;       // The worker thread has been created and waits for jobs
+   pthread_cond_t     CondJob;       // Signalled when a job has been handed to this worker
+   uint8_t            JobPending;    // Set when launching a job, cleared by the worker when the job is done
+   void *(*pJob)(void *);            // The job to be done: AewfThreadUncompress, AewfThreadCRC or AewfThreadCopy
+   ts_XmountInflate   Inflate;       // Decompressor state of this worker
    char             *pChunkBuffCompressed;
    uint64_t           ChunkBuffCompressedDataLen;
    char             *pChunkBuffUncompressed;         // This buffer serves as cache as well. ChunkInBuff contains the absolute chunk number whose data is stored here
    uint64_t           ChunkBuffUncompressedDataLen;  // This normally always is equal to the chunk size (32K), except maybe for the last chunk, if the image's total size is not a multiple of the chunk size
    uint64_t           ChunkInBuff;
+   uint8_t            Verify;      // Verify the checksum of this chunk
+   uint8_t            Prefetch;    // Readahead job: Nothing to be copied, the reading thread doesn't wait for it
+   uint8_t            IoPending;   // The chunk read has been queued to the io_uring, the job is launched on its completion
+   uint32_t           PreRead;     // Bytes of the chunk already read by the io_uring; the job reads the rest (if any) itself
 
+   t_pSegment         pSegment;    // Job arguments to the thread: Read ChunkBuffCompressedDataLen bytes at
+   uint64_t            SeekPos;    // SeekPos from pSegment (not needed for AewfThreadCopy)
    char              *pBuf;        // Job arguments to the thread: Copy the uncompressed
    uint64_t            Ofs;        // chunk data starting at chunk offset Ofs to pBuf, Len
    uint64_t            Len;        // bytes in total.
@@ -185,6 +320,91 @@ typedef struct _t_AewfThread
    int                ReturnCode;
 } t_AewfThread, *t_pAewfThread;
 
+// Result of scanning a single segment file in AewfOpen. The segment files are scanned
+// independently of each other; AewfOpenScan merges the results in segment order.
+typedef struct
+{
+   int                   rc;
+   t_Segment             Segment;              // pName, Number and FileSize
+   t_pTable             pTableArr;             // Tables with chunks found in this segment; Nr, pSegment and chunk numbers not yet set
+   uint64_t              Tables;
+   uint64_t              TotalTableSize;
+   uint64_t              FirstTablePos;        // Position of the first table section, UINT64_MAX if there is none
+   uint64_t              VolumePos;            // Position of the first volume section, UINT64_MAX if there is none
+   int                   VolumeRc;             // Error found in that volume section
+   t_pAewfSectionVolume pVolume;
+   t_pAewfSectionHash   pMD5;
+   char                *pHeader;
+   char                *pHeader2;
+   uint64_t              HeaderLen;
+   uint64_t              Header2Len;
+   uint8_t               NeedsSectorsFromPrev; // The first table relies on a sectors section in a previous segment
+   uint8_t               SectorsFromPrev;      // No sectors section and no table with chunks found; the sectors info of the previous segment passes through
+   uint64_t              SectionSectorsPos;    // Sectors section at the segment end not yet used by a table
+   uint64_t              SectionSectorsSize;
+} t_AewfSegmentScan, *t_pAewfSegmentScan;
+
+typedef struct
+{
+   t_pAewf              pAewf;
+   const char         **ppFilenameArr;
+   t_pAewfSegmentScan   pScanArr;
+   uint64_t              Count;
+   uint64_t              Next;                 // Next segment file to be scanned, protected by Mutex
+   pthread_mutex_t       Mutex;
+} t_AewfScanPool, *t_pAewfScanPool;
+
+// Sidecar index file. It memorises everything AewfOpen finds out when walking through the
+// section chains of the segment files. Layout:
+//    t_AewfSidecarHeader
+//    t_AewfSidecarSegment [Segments]
+//    t_AewfSidecarTable   [Tables]
+//    Segment file names   (NamesLen bytes, zero terminated strings in segment order)
+//    Info text            (InfoLen bytes, zero terminated)
+//    t_AewfChunkIndex     [Chunks]  (only if HasChunkIndex is set)
+// The file is written in host byte order; files from other architectures are rejected by the
+// magic check.
+
+#define AEWF_SIDECAR_MAGIC   0x5844495f46574541ULL   // AEWF_IDX
+#define AEWF_SIDECAR_VERSION 1
+
+typedef struct
+{
+   uint64_t           Magic;
+   uint32_t           Version;
+   uint32_t           Checksum;        // Adler-32 of everything behind the header
+   uint64_t           Segments;
+   uint64_t           Tables;
+   uint64_t           Chunks;
+   uint64_t           TotalTableSize;
+   uint64_t           SectorSize;
+   uint64_t           Sectors;
+   uint64_t           ChunkSize;
+   uint64_t           ImageSize;
+   uint64_t           NamesLen;
+   uint64_t           InfoLen;
+   uint8_t            HasChunkIndex;
+} __attribute__ ((packed)) t_AewfSidecarHeader, *t_pAewfSidecarHeader;
+
+typedef struct
+{
+   uint64_t           FileSize;        // Size and modification time are used for checking
+   int64_t            MTime;           // if the segment file is still the same
+   uint16_t           Number;
+} __attribute__ ((packed)) t_AewfSidecarSegment, *t_pAewfSidecarSegment;
+
+typedef struct
+{
+   uint64_t           ChunkFrom;
+   uint64_t           ChunkTo;
+   uint64_t           Segment;         // Index in pAewf->pSegmentArr
+   uint64_t           Offset;
+   uint64_t           Size;
+   uint32_t           ChunkCount;
+   uint64_t           SectionSectorsPos;
+   uint32_t           SectionSectorsSize;
+} __attribute__ ((packed)) t_AewfSidecarTable, *t_pAewfSidecarTable;
+
 #define AEWF_MAGIC 0x4d595f5f41455746   // MY__AEWF
 
 typedef struct _t_Aewf
@@ -193,16 +413,20 @@ typedef struct _t_Aewf
    int            Open;            // Memorize if AewfOpen has been called
    t_pSegment    pSegmentArr;      // Array of all segment files (in correct order)
    t_pTable      pTableArr;        // Array of all chunk offset tables found in the segment files (in correct order)
+   t_pAewfChunkIndex pChunkIndexArr; // Flat index of all chunks, only built if option ChunkIndex is set. Replaces the tables when reading.
    uint64_t       Segments;
    uint64_t       Tables;
    uint64_t       Chunks;          // Total number of chunks in all tables
    uint64_t       TotalTableSize;  // Total size of all tables
    uint64_t       TableCache;      // Current amount RAM used by tables, in bytes
    uint64_t       OpenSegments;    // Current number of open segment files
+   t_AewfLru      SegmentLru;      // Open segment files, for finding the one to be closed next
+   t_AewfLru      TableLru;        // Loaded tables, for finding the one to be released next
    uint64_t       SectorSize;
    uint64_t       Sectors;
    uint64_t       ChunkSize;
    uint64_t       ImageSize;       // Equals to Sectors * SectorSize
+   ts_XmountInflate Inflate;       // Decompressor state for the single-threaded read functions
    char         *pChunkBuffCompressed;
    char         *pChunkBuffUncompressed;
    uint64_t       ChunkBuffUncompressedDataLen;  // This normally always is equal to the chunk size (32K), except maybe for the last chunk, if the image's total size is not a multiple of the chunk size
@@ -211,7 +435,11 @@ typedef struct _t_Aewf
    char         *pErrorText;       // Used for assembling error text during option parsing
    time_t         LastStatsUpdate;
    char         *pInfo;
-   t_pAewfThread pThreadArr;
+   t_pAewfThread pThreadArr;       // Persistent worker threads, created in AewfOpen if Threads > 1
+   t_AewfPool     Pool;
+   t_AewfChunkCache ChunkCache;
+   t_AewfZeroChunks ZeroChunks;
+   t_AewfUring    Uring;
 
    // Statistics
    uint64_t   SegmentCacheHits;
@@ -226,6 +454,14 @@ typedef struct _t_Aewf
    uint64_t   DataRequestedByCaller; // How much data was given back to the caller
    uint64_t   TablesReadFromImage;   // The overhead of the table read operations (in bytes)
    uint64_t   ChunksRead;
+   uint64_t   ChunksVerified;        // Chunks read from the image whose checksum was verified
+   uint64_t   ZeroChunkReads;        // Chunks served by memset, as they are known to be zero
+   uint64_t   ReadaheadChunks;       // Chunks handed to the workers by the readahead
+   uint64_t   UringReads;            // Chunks read by means of the io_uring
+   uint64_t   UringBatches;          // Number of io_uring submissions
+   uint64_t   SeqNextPos;            // Image position following the last read request
+   uint64_t   SeqReads;              // Number of consecutive read requests that followed each other directly
+   uint64_t   AdvisedChunk;          // The chunks below have been announced to the kernel by means of posix_fadvise
    uint64_t   BytesRead;
    uint64_t   ReadSizesArr[READSIZE_ARRLEN];  // Distribution of the requested block sizes to be read
    uint64_t   Errors;
@@ -238,7 +474,13 @@ typedef struct _t_Aewf
    uint64_t   StatsRefresh;     // The time in seconds between update of the stats file
    char     *pLogPath;          // Path for log file
    uint8_t    LogStdout;
-   uint32_t   Threads;          // Max. number of threads to be used in parallel actions. Currently only used for uncompression
+   uint32_t   Threads;          // Max. number of threads to be used in parallel actions (uncompression and scanning the segment files in AewfOpen)
+   uint64_t   MaxChunkCache;    // Max. amount of RAM for the cache of uncompressed chunks, in MiB (0 switches the cache off)
+   uint64_t   ChunkIndex;       // Build a flat chunk index in AewfOpen (boolean)
+   char     *pSidecarPath;      // Path of the sidecar index file (NULL if not used)
+   t_AewfVerify Verify;         // Chunk checksum verification
+   uint64_t   Readahead;        // Number of chunks to be decompressed in advance on sequential reads (0 switches readahead off)
+   uint64_t   UseUring;         // Read chunks by means of io_uring if available (boolean)
 } t_Aewf;
 
 
@@ -329,7 +571,11 @@ enum
    AEWF_SECTION_HEADER_WRONG_SIZE,
    AEWF_SECTION_VOLUME_WRONG_SIZE,
    AEWF_SECTION_HASH_WRONG_SIZE,
-   AEWF_SECTION_BEYOND_EOF
+   AEWF_SECTION_BEYOND_EOF,
+   AEWF_SIDECAR_INVALID,
+   AEWF_SIDECAR_SEGMENT_CHANGED,
+   AEWF_SIDECAR_WRITE_FAILED,
+   AEWF_URING_FAILED
 };
 
 #endif
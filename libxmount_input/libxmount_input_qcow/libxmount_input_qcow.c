@@ -22,9 +22,16 @@
 #include <stdio.h>
 #include <string.h>
 #include <stdarg.h>
+#include <errno.h>
+#include <unistd.h>
+#include <libgen.h>
+#include <sys/stat.h>
 #include <zlib.h>
 
 #include "../libxmount_input.h"
+#ifdef HAVE_LIBZSTD
+  #include <zstd.h>
+#endif
 #include "libxmount_input_qcow.h"
 
 #define LOG_WARNING(...) {            \
@@ -61,9 +68,11 @@ void LibXmount_Input_GetFunctions(ts_LibXmountInputFunctions *p_functions) {
     p_functions->Close = &QcowClose;
     p_functions->Size = &QcowSize;
     p_functions->Read = &QcowRead;
+    p_functions->GetExtents = &QcowGetExtents;
     p_functions->OptionsHelp = &QcowOptionsHelp;
     p_functions->OptionsParse = &QcowOptionsParse;
     p_functions->GetInfofileContent = &QcowGetInfofileContent;
+    p_functions->GetStats = &QcowGetStats;
     p_functions->GetErrorMessage = &QcowGetErrorMessage;
     p_functions->FreeBuffer = &QcowFreeBuffer;
 }
@@ -89,11 +98,17 @@ static uint64_t QcowL1OffsetFromAddress(t_pQcow pQcow, uint64_t Address) {
     return (Address >> (pQcow->Header.ClusterBits + pQcow->L2Bits));
 }
 
-static int QcowUtilFileSeek(t_pQcow pQcow, size_t Offset) {
-    if (fseek(pQcow->pFile, Offset, SEEK_SET)) {
-        return QCOW_CANNOT_SEEK;
+/*
+ * QcowL2EntryIsZero
+ */
+static int QcowL2EntryIsZero(uint64_t L2Entry) {
+    if ((L2Entry >> 62) & 1) { // Compressed clusters always contain data
+        return 0;
     }
-    return QCOW_OK;
+    if (L2Entry & 1) { // Zero-Bit Flag
+        return 1;
+    }
+    return (L2Entry & UINT64_C(0x00fffffffffffe00)) == 0;
 }
 
 static int QcowUtilFileRead(t_pQcow pQcow, void* Ptr, size_t Size) {
@@ -106,6 +121,40 @@ static int QcowUtilFileRead(t_pQcow pQcow, void* Ptr, size_t Size) {
     }
 }
 
+/*
+ * QcowUtilPread - Read Size bytes at the given file offset, leaving the stream
+ * position alone. As with QcowUtilFileRead, data beyond the end of the file is
+ * returned as zeroes. Safe to be called from several threads.
+ */
+static int QcowUtilPread(int Fd, void* Ptr, size_t Size, uint64_t Offset) {
+    char *pDst = (char*)Ptr;
+    ssize_t BytesRead;
+
+    while (Size) {
+        BytesRead = pread(Fd, pDst, Size, (off_t)Offset);
+        if (BytesRead < 0) {
+            if (errno == EINTR) continue;
+            return QCOW_CANNOT_READ_DATA;
+        }
+        if (BytesRead == 0) {
+            memset(pDst, '\0', Size);
+            break;
+        }
+        pDst += BytesRead;
+        Offset += BytesRead;
+        Size -= BytesRead;
+    }
+    return QCOW_OK;
+}
+
+/*
+ * QcowUtilFileReadAt - QcowUtilPread on the qcow file, counted in the stats
+ */
+static int QcowUtilFileReadAt(t_pQcow pQcow, void* Ptr, size_t Size, uint64_t Offset) {
+    pQcow->FileReads++;
+    return QcowUtilPread(pQcow->Fd, Ptr, Size, Offset);
+}
+
 static void QcowUtilLog(char* format, ...) {
     printf("[QCOWLOG] ");
     va_list args;
@@ -115,6 +164,125 @@ static void QcowUtilLog(char* format, ...) {
     printf("\n");
 }
 
+/*
+ * QcowL2CacheInit
+ */
+static int QcowL2CacheInit(t_pQcow pQcow) {
+    uint64_t i;
+
+    // An L2 table is exactly one cluster long
+    pQcow->L2CacheEntries = (pQcow->MaxL2Cache * 1024 * 1024) / pQcow->ClusterSize;
+    pQcow->L2CacheEntries = GETMAX(pQcow->L2CacheEntries, 1);
+    pQcow->L2CacheEntries = GETMIN(pQcow->L2CacheEntries, GETMAX(pQcow->Header.L1Size, 1));
+
+    pQcow->pL2CacheArr = calloc(pQcow->L2CacheEntries, sizeof(t_QcowL2CacheEntry));
+    pQcow->ppL2CacheMap = calloc(GETMAX(pQcow->Header.L1Size, 1), sizeof(t_pQcowL2CacheEntry));
+    if (pQcow->pL2CacheArr == NULL || pQcow->ppL2CacheMap == NULL) {
+        return QCOW_MEMALLOC_FAILED;
+    }
+    for (i = 0; i < pQcow->L2CacheEntries; i++) {
+        pQcow->pL2CacheArr[i].L1Index = QCOW_L2CACHE_UNUSED;
+        pQcow->pL2CacheArr[i].pPrev = (i > 0) ? &pQcow->pL2CacheArr[i-1] : NULL;
+        pQcow->pL2CacheArr[i].pNext = (i+1 < pQcow->L2CacheEntries) ? &pQcow->pL2CacheArr[i+1] : NULL;
+    }
+    pQcow->pL2CacheHead = &pQcow->pL2CacheArr[0];
+    pQcow->pL2CacheTail = &pQcow->pL2CacheArr[pQcow->L2CacheEntries-1];
+    return QCOW_OK;
+}
+
+/*
+ * QcowL2CacheDeInit
+ */
+static void QcowL2CacheDeInit(t_pQcow pQcow) {
+    uint64_t i;
+
+    if (pQcow->pL2CacheArr) {
+        for (i = 0; i < pQcow->L2CacheEntries; i++) {
+            free(pQcow->pL2CacheArr[i].pL2Table);
+        }
+        free(pQcow->pL2CacheArr);
+        pQcow->pL2CacheArr = NULL;
+    }
+    free(pQcow->ppL2CacheMap);
+    pQcow->ppL2CacheMap = NULL;
+    pQcow->L2CacheEntries = 0;
+    pQcow->pL2CacheHead = NULL;
+    pQcow->pL2CacheTail = NULL;
+}
+
+/*
+ * QcowL2CacheTouch - Make the given entry the most recently used one
+ */
+static void QcowL2CacheTouch(t_pQcow pQcow, t_pQcowL2CacheEntry pEntry) {
+    if (pEntry == pQcow->pL2CacheHead) {
+        return;
+    }
+    pEntry->pPrev->pNext = pEntry->pNext;
+    if (pEntry->pNext) {
+        pEntry->pNext->pPrev = pEntry->pPrev;
+    } else {
+        pQcow->pL2CacheTail = pEntry->pPrev;
+    }
+    pEntry->pPrev = NULL;
+    pEntry->pNext = pQcow->pL2CacheHead;
+    pQcow->pL2CacheHead->pPrev = pEntry;
+    pQcow->pL2CacheHead = pEntry;
+}
+
+/*
+ * QcowGetL2Table - Get the L2 table of the given L1 entry, reading it into the
+ * cache if necessary. *ppL2Table is set to NULL if no L2 table is allocated.
+ * The returned table stays valid until the next call.
+ */
+static int QcowGetL2Table(t_pQcow pQcow, uint64_t L1Offset, uint64_t **ppL2Table) {
+    t_pQcowL2CacheEntry pEntry;
+    uint64_t L2TableAddress;
+    uint64_t i;
+
+    *ppL2Table = NULL;
+    if (L1Offset >= pQcow->Header.L1Size) {
+        return QCOW_BAD_L1_OFFSET;
+    }
+
+    //Bottom 9 bits are reserved, Top byte too
+    L2TableAddress = be64toh(pQcow->pL1Table[L1Offset]) & UINT64_C(0x00fffffffffffe00);
+    if (L2TableAddress == 0) {
+        return QCOW_OK;
+    }
+
+    pEntry = pQcow->ppL2CacheMap[L1Offset];
+    if (pEntry != NULL) {
+        pQcow->L2CacheHits++;
+        QcowL2CacheTouch(pQcow, pEntry);
+        *ppL2Table = pEntry->pL2Table;
+        return QCOW_OK;
+    }
+
+    // Recycle the least recently used entry
+    pQcow->L2CacheMisses++;
+    pEntry = pQcow->pL2CacheTail;
+    if (pEntry->L1Index != QCOW_L2CACHE_UNUSED) {
+        pQcow->ppL2CacheMap[pEntry->L1Index] = NULL;
+        pEntry->L1Index = QCOW_L2CACHE_UNUSED;
+    }
+    if (pEntry->pL2Table == NULL) {
+        pEntry->pL2Table = malloc(pQcow->L2Size * sizeof(uint64_t));
+        if (pEntry->pL2Table == NULL) {
+            return QCOW_MEMALLOC_FAILED;
+        }
+    }
+    CHK(QcowUtilFileReadAt(pQcow, pEntry->pL2Table, pQcow->L2Size * sizeof(uint64_t), L2TableAddress))
+    for (i = 0; i < pQcow->L2Size; i++) {
+        pEntry->pL2Table[i] = be64toh(pEntry->pL2Table[i]);
+    }
+    pEntry->L1Index = L1Offset;
+    pQcow->ppL2CacheMap[L1Offset] = pEntry;
+    QcowL2CacheTouch(pQcow, pEntry);
+
+    *ppL2Table = pEntry->pL2Table;
+    return QCOW_OK;
+}
+
 /*
  * QcowParseHeader
  */
@@ -128,7 +296,7 @@ static int QcowParseHeader(t_pQcow pQcow) {
     //Fix endianess of header fields
     pHeader->Version = be32toh(pHeader->Version);
     pHeader->BackingFileOffset = be64toh(pHeader->BackingFileOffset);
-    pHeader->BackingFileSize = be64toh(pHeader->BackingFileSize);
+    pHeader->BackingFileSize = be32toh(pHeader->BackingFileSize);
     pHeader->ClusterBits = be32toh(pHeader->ClusterBits);
     pHeader->Size = be64toh(pHeader->Size);
     pHeader->CryptMethod = be32toh(pHeader->CryptMethod);
@@ -138,107 +306,623 @@ static int QcowParseHeader(t_pQcow pQcow) {
     pHeader->RefCountTableClusters = be32toh(pHeader->RefCountTableClusters);
     pHeader->NbSnapshots = be32toh(pHeader->NbSnapshots);
     pHeader->SnapshotsOffset = be64toh(pHeader->SnapshotsOffset);
+    if (pHeader->Version >= 3) {
+        pHeader->IncompatibleFeatures = be64toh(pHeader->IncompatibleFeatures);
+        pHeader->CompatibleFeatures = be64toh(pHeader->CompatibleFeatures);
+        pHeader->AutoclearFeatures = be64toh(pHeader->AutoclearFeatures);
+        pHeader->RefCountOrder = be32toh(pHeader->RefCountOrder);
+        pHeader->HeaderLength = be32toh(pHeader->HeaderLength);
+    } else {
+        // Whatever follows the v2 header isn't part of it
+        pHeader->IncompatibleFeatures = 0;
+        pHeader->CompatibleFeatures = 0;
+        pHeader->AutoclearFeatures = 0;
+        pHeader->RefCountOrder = 4;
+        pHeader->HeaderLength = 72;
+        pHeader->CompressionType = QCOW_COMPRESSION_DEFLATE;
+    }
 
     // Check if unsupported features are used
-    // TODO Check if v3 features are used that are not supported
     if (pHeader->Version != 2 && pHeader->Version != 3) { 
         return QCOW_BAD_VERSION;
     }
     if (pHeader->CryptMethod != 0) {
         return QCOW_UNSUPPORTED_ENCRYPTION;
     }
+    if (pHeader->IncompatibleFeatures & ~QCOW_INCOMPAT_SUPPORTED) {
+        return QCOW_UNSUPPORTED_FEATURE;
+    }
+
+    pQcow->CompressionType = QCOW_COMPRESSION_DEFLATE;
+    if ((pHeader->IncompatibleFeatures & QCOW_INCOMPAT_COMPRESSION_TYPE) &&
+        pHeader->HeaderLength > 104)
+    {
+        pQcow->CompressionType = pHeader->CompressionType;
+    }
+    switch (pQcow->CompressionType) {
+    case QCOW_COMPRESSION_DEFLATE:
+        break;
+#ifdef HAVE_LIBZSTD
+    case QCOW_COMPRESSION_ZSTD:
+        break;
+#endif
+    default:
+        return QCOW_UNSUPPORTED_COMPRESSION;
+    }
 
     return QCOW_OK;
 }
 
 /*
- * QcowRawRead0
+ * QcowResolveCluster - Find out where the cluster containing Address lies in
+ * the qcow file. For compressed clusters, *pHostAddress is the start of the
+ * compressed data and *pCompressedSize its length.
  */
-static int QcowRead0(t_pQcow pQcow, char *pBuffer, uint64_t Seek, uint32_t *pCount)
+static int QcowResolveCluster(t_pQcow pQcow,
+                              uint64_t Address,
+                              int *pType,
+                              uint64_t *pHostAddress,
+                              uint64_t *pCompressedSize)
 {
-    uint64_t L1Offset;
-    uint64_t L2Offset;
-    uint64_t ClusterOffset;
-    uint64_t ClusterBaseAddress;
-    uint64_t L2TableAddress;
-    uint64_t DataAddress;
-    int ClusterIsCompressed = 0;
-    uint64_t CompressedClusterSize = 0;
+    uint64_t *pL2Table;
+    uint64_t L2Entry;
+    uint64_t AddressBits;
 
-    L1Offset = QcowL1OffsetFromAddress(pQcow, Seek);
-    L2Offset = QcowL2OffsetFromAddress(pQcow, Seek);
-    ClusterOffset = QcowClusterOffsetFromAddress(pQcow, Seek);
-    *pCount = GETMIN (*pCount, pQcow->ClusterSize - ClusterOffset);
+    *pType = QCOW_CLUSTER_ZERO;
+    *pHostAddress = 0;
+    *pCompressedSize = 0;
 
-    // Some boundary checks
-    if (L1Offset >= pQcow->Header.L1Size) {
-        return QCOW_BAD_L1_OFFSET;
+    CHK(QcowGetL2Table(pQcow, QcowL1OffsetFromAddress(pQcow, Address), &pL2Table))
+    L2Entry = (pL2Table == NULL) ? 0 : pL2Table[QcowL2OffsetFromAddress(pQcow, Address)];
+    if (QcowL2EntryIsZero(L2Entry)) {
+        // Only a cluster without zero flag shows what lies beneath it
+        if (pQcow->pBacking != NULL && !(L2Entry & 1)) {
+            *pType = QCOW_CLUSTER_UNALLOCATED;
+        }
+        return QCOW_OK;
     }
+    if ((L2Entry >> 62) & 1) {
+        AddressBits = 64 - 2 - (pQcow->Header.ClusterBits - 8);
+        *pType = QCOW_CLUSTER_COMPRESSED;
+        *pCompressedSize = 512 * (1 + ((L2Entry >> AddressBits) & (((size_t)1 << (pQcow->Header.ClusterBits - 8)) - 1)));
+        *pHostAddress = L2Entry & (((size_t)1 << AddressBits) - 1);
+    } else {
+        *pType = QCOW_CLUSTER_DATA;
+        *pHostAddress = L2Entry & UINT64_C(0x00fffffffffffe00);
+    }
+    return QCOW_OK;
+}
 
-    //Bottom 9 bits are reserved, Top byte too
-    L2TableAddress = be64toh(pQcow->pL1Table[L1Offset]) & UINT64_C(0x00fffffffffffe00);
+/*
+ * QcowClusterCacheInit
+ */
+static int QcowClusterCacheInit(t_pQcow pQcow) {
+    uint64_t i;
 
-    if (L2TableAddress == 0) {
-        ClusterBaseAddress = 0;
+    // Every thread needs an entry of its own to decompress into
+    pQcow->ClusterCacheEntries = (pQcow->MaxClusterCache * 1024 * 1024) / pQcow->ClusterSize;
+    pQcow->ClusterCacheEntries = GETMAX(pQcow->ClusterCacheEntries, GETMAX(pQcow->Threads, 1));
+    pQcow->ClusterCacheHashSize = pQcow->ClusterCacheEntries * 2;
+
+    pQcow->pClusterCacheArr = calloc(pQcow->ClusterCacheEntries, sizeof(t_QcowClusterCacheEntry));
+    pQcow->ppClusterCacheHash = calloc(pQcow->ClusterCacheHashSize, sizeof(t_pQcowClusterCacheEntry));
+    pQcow->pJobArr = calloc(pQcow->ClusterCacheEntries, sizeof(t_QcowJob));
+    if (pQcow->pClusterCacheArr == NULL || pQcow->ppClusterCacheHash == NULL || pQcow->pJobArr == NULL) {
+        return QCOW_MEMALLOC_FAILED;
+    }
+    for (i = 0; i < pQcow->ClusterCacheEntries; i++) {
+        pQcow->pClusterCacheArr[i].HostAddress = QCOW_CLUSTERCACHE_UNUSED;
+        pQcow->pClusterCacheArr[i].pPrev = (i > 0) ? &pQcow->pClusterCacheArr[i-1] : NULL;
+        pQcow->pClusterCacheArr[i].pNext = (i+1 < pQcow->ClusterCacheEntries) ? &pQcow->pClusterCacheArr[i+1] : NULL;
+    }
+    pQcow->pClusterCacheHead = &pQcow->pClusterCacheArr[0];
+    pQcow->pClusterCacheTail = &pQcow->pClusterCacheArr[pQcow->ClusterCacheEntries-1];
+    return QCOW_OK;
+}
+
+/*
+ * QcowClusterCacheDeInit
+ */
+static void QcowClusterCacheDeInit(t_pQcow pQcow) {
+    uint64_t i;
+
+    if (pQcow->pClusterCacheArr) {
+        for (i = 0; i < pQcow->ClusterCacheEntries; i++) {
+            free(pQcow->pClusterCacheArr[i].pData);
+        }
+        free(pQcow->pClusterCacheArr);
+        pQcow->pClusterCacheArr = NULL;
+    }
+    free(pQcow->ppClusterCacheHash);
+    pQcow->ppClusterCacheHash = NULL;
+    free(pQcow->pJobArr);
+    pQcow->pJobArr = NULL;
+    pQcow->ClusterCacheEntries = 0;
+    pQcow->ClusterCacheHashSize = 0;
+    pQcow->pClusterCacheHead = NULL;
+    pQcow->pClusterCacheTail = NULL;
+}
+
+static uint64_t QcowClusterCacheHash(t_pQcow pQcow, uint64_t HostAddress) {
+    return (HostAddress >> 9) % pQcow->ClusterCacheHashSize;
+}
+
+/*
+ * QcowClusterCacheMove - Make the given entry the most recently used one
+ * (ToFront != 0) or the next one to be recycled (ToFront == 0)
+ */
+static void QcowClusterCacheMove(t_pQcow pQcow, t_pQcowClusterCacheEntry pEntry, int ToFront) {
+    // Unlink
+    if (pEntry->pPrev) {
+        pEntry->pPrev->pNext = pEntry->pNext;
     } else {
-        CHK(QcowUtilFileSeek(pQcow, L2TableAddress + L2Offset * sizeof(uint64_t)))
-        CHK(QcowUtilFileRead(pQcow, &ClusterBaseAddress, sizeof(uint64_t)))
-        ClusterBaseAddress = be64toh(ClusterBaseAddress);
-        ClusterIsCompressed = (ClusterBaseAddress >> 62) & 1;
-        if (!ClusterIsCompressed) {
-            if (ClusterBaseAddress & 1) { // Zero-Bit Flag
-                ClusterBaseAddress = 0;
-            } else {
-                ClusterBaseAddress = ClusterBaseAddress & UINT64_C(0x00fffffffffffe00);
-            }
+        pQcow->pClusterCacheHead = pEntry->pNext;
+    }
+    if (pEntry->pNext) {
+        pEntry->pNext->pPrev = pEntry->pPrev;
+    } else {
+        pQcow->pClusterCacheTail = pEntry->pPrev;
+    }
+    // Relink
+    if (ToFront) {
+        pEntry->pPrev = NULL;
+        pEntry->pNext = pQcow->pClusterCacheHead;
+        if (pQcow->pClusterCacheHead) {
+            pQcow->pClusterCacheHead->pPrev = pEntry;
+        } else {
+            pQcow->pClusterCacheTail = pEntry;
+        }
+        pQcow->pClusterCacheHead = pEntry;
+    } else {
+        pEntry->pNext = NULL;
+        pEntry->pPrev = pQcow->pClusterCacheTail;
+        if (pQcow->pClusterCacheTail) {
+            pQcow->pClusterCacheTail->pNext = pEntry;
+        } else {
+            pQcow->pClusterCacheHead = pEntry;
         }
+        pQcow->pClusterCacheTail = pEntry;
     }
-    if (ClusterBaseAddress == 0 ) {
-        memset(pBuffer, '\0', *pCount);
-        return QCOW_OK;
+}
+
+/*
+ * QcowClusterCacheLookup - Find the decompressed cluster whose compressed data
+ * starts at HostAddress. Returns NULL if it isn't cached.
+ */
+static t_pQcowClusterCacheEntry QcowClusterCacheLookup(t_pQcow pQcow, uint64_t HostAddress) {
+    t_pQcowClusterCacheEntry pEntry;
+
+    pEntry = pQcow->ppClusterCacheHash[QcowClusterCacheHash(pQcow, HostAddress)];
+    while (pEntry && pEntry->HostAddress != HostAddress) {
+        pEntry = pEntry->pHashNext;
+    }
+    if (pEntry) {
+        QcowClusterCacheMove(pQcow, pEntry, 1);
+    }
+    return pEntry;
+}
+
+/*
+ * QcowClusterCacheDrop - Remove an entry from the hash table and mark it for
+ * immediate reuse
+ */
+static void QcowClusterCacheDrop(t_pQcow pQcow, t_pQcowClusterCacheEntry pEntry) {
+    t_pQcowClusterCacheEntry *ppLink;
+
+    if (pEntry->HostAddress != QCOW_CLUSTERCACHE_UNUSED) {
+        ppLink = &pQcow->ppClusterCacheHash[QcowClusterCacheHash(pQcow, pEntry->HostAddress)];
+        while (*ppLink != pEntry) {
+            ppLink = &(*ppLink)->pHashNext;
+        }
+        *ppLink = pEntry->pHashNext;
+        pEntry->pHashNext = NULL;
+        pEntry->HostAddress = QCOW_CLUSTERCACHE_UNUSED;
     }
-    if (ClusterIsCompressed) {
-        uint64_t AddressBits = 64 - 2 - (pQcow->Header.ClusterBits - 8);
-        CompressedClusterSize = 512 * (1 + ((ClusterBaseAddress >> AddressBits) & (((size_t)1 << (pQcow->Header.ClusterBits - 8)) - 1)));
-        ClusterBaseAddress = ClusterBaseAddress & (((size_t)1 << AddressBits) - 1);
-        char* pCompressedBuffer = malloc(CompressedClusterSize);
-        if(pCompressedBuffer == NULL) {
+    QcowClusterCacheMove(pQcow, pEntry, 0);
+}
+
+/*
+ * QcowClusterCacheAlloc - Recycle the least recently used entry for the
+ * cluster at HostAddress. The entry's data has yet to be filled in.
+ */
+static int QcowClusterCacheAlloc(t_pQcow pQcow, uint64_t HostAddress, t_pQcowClusterCacheEntry *ppEntry) {
+    t_pQcowClusterCacheEntry pEntry;
+    uint64_t Hash;
+
+    pEntry = pQcow->pClusterCacheTail;
+    QcowClusterCacheDrop(pQcow, pEntry);
+    if (pEntry->pData == NULL) {
+        pEntry->pData = malloc(pQcow->ClusterSize);
+        if (pEntry->pData == NULL) {
             return QCOW_MEMALLOC_FAILED;
         }
-        char* pUncompressedBuffer = malloc(pQcow->ClusterSize);
-        if(pUncompressedBuffer == NULL) {
+    }
+    Hash = QcowClusterCacheHash(pQcow, HostAddress);
+    pEntry->HostAddress = HostAddress;
+    pEntry->pHashNext = pQcow->ppClusterCacheHash[Hash];
+    pQcow->ppClusterCacheHash[Hash] = pEntry;
+    QcowClusterCacheMove(pQcow, pEntry, 1);
+
+    *ppEntry = pEntry;
+    return QCOW_OK;
+}
+
+/*
+ * QcowDecompressorInit
+ */
+static int QcowDecompressorInit(t_pQcow pQcow, t_pQcowDecompressor pDecompressor) {
+    XmountInflateInit(&pDecompressor->Inflate);
+    pDecompressor->pCompressedBuffer = malloc(pQcow->MaxCompressedSize);
+    if (pDecompressor->pCompressedBuffer == NULL) {
+        return QCOW_MEMALLOC_FAILED;
+    }
+    return QCOW_OK;
+}
+
+/*
+ * QcowDecompressorDeInit
+ */
+static void QcowDecompressorDeInit(t_pQcowDecompressor pDecompressor) {
+    XmountInflateDeInit(&pDecompressor->Inflate);
+#ifdef HAVE_LIBZSTD
+    ZSTD_freeDCtx((ZSTD_DCtx*)pDecompressor->pZstdCtx);
+#endif
+    pDecompressor->pZstdCtx = NULL;
+    free(pDecompressor->pCompressedBuffer);
+    pDecompressor->pCompressedBuffer = NULL;
+}
+
+#ifdef HAVE_LIBZSTD
+/*
+ * QcowZstdDecompress - Decompress a zstd compressed cluster. As the compressed
+ * size is rounded up to whole sectors, the input may hold garbage behind the
+ * zstd frame, so decompression stops as soon as the cluster is complete.
+ */
+static int QcowZstdDecompress(t_pQcowDecompressor pDecompressor,
+                              char *pDst,
+                              uint64_t DstLen,
+                              uint64_t CompressedSize)
+{
+    ZSTD_inBuffer Input = { pDecompressor->pCompressedBuffer, CompressedSize, 0 };
+    ZSTD_outBuffer Output = { pDst, DstLen, 0 };
+    size_t LastInputPos;
+    size_t LastOutputPos;
+    size_t Ret;
+
+    if (pDecompressor->pZstdCtx == NULL) {
+        pDecompressor->pZstdCtx = ZSTD_createDCtx();
+        if (pDecompressor->pZstdCtx == NULL) {
             return QCOW_MEMALLOC_FAILED;
         }
-        CHK(QcowUtilFileSeek(pQcow, ClusterBaseAddress))
-        CHK(QcowUtilFileRead(pQcow, pCompressedBuffer, CompressedClusterSize))
-        z_stream zlib_stream;
-        memset(&zlib_stream, 0, sizeof( z_stream ) );
-        zlib_stream.next_in   = pCompressedBuffer;
-        zlib_stream.avail_in  = CompressedClusterSize;
-        zlib_stream.next_out  = pUncompressedBuffer;
-        zlib_stream.avail_out = pQcow->ClusterSize;
-        int r = inflateInit2(&zlib_stream, -12);
-        if (r) {
-            free(pCompressedBuffer);
-            free(pUncompressedBuffer);
+    } else {
+        ZSTD_DCtx_reset((ZSTD_DCtx*)pDecompressor->pZstdCtx, ZSTD_reset_session_only);
+    }
+
+    while (Output.pos < Output.size) {
+        LastInputPos = Input.pos;
+        LastOutputPos = Output.pos;
+        Ret = ZSTD_decompressStream((ZSTD_DCtx*)pDecompressor->pZstdCtx, &Output, &Input);
+        if (ZSTD_isError(Ret)) {
             return QCOW_UNABLE_TO_DECOMPRESS_CLUSTER;
         }
-        r = inflate(&zlib_stream, Z_FINISH);
-        if (r < 0) {
-            free(pCompressedBuffer);
-            free(pUncompressedBuffer);
+        if (Input.pos == LastInputPos && Output.pos == LastOutputPos) {
+            // No progress, the data ends before the cluster is complete
             return QCOW_UNABLE_TO_DECOMPRESS_CLUSTER;
         }
-        memcpy(pBuffer, pUncompressedBuffer + ClusterOffset, *pCount);
-        free(pCompressedBuffer);
-        free(pUncompressedBuffer);
+    }
+    return QCOW_OK;
+}
+#endif
+
+/*
+ * QcowDecompressCluster - Read and decompress a whole cluster into pDst.
+ * Only touches pDecompressor and pDst, so it may run in any thread.
+ */
+static int QcowDecompressCluster(t_pQcow pQcow,
+                                 t_pQcowDecompressor pDecompressor,
+                                 uint64_t HostAddress,
+                                 uint64_t CompressedSize,
+                                 char *pDst)
+{
+    uint64_t UncompressedSize = pQcow->ClusterSize;
+    int r;
+
+    if (CompressedSize > pQcow->MaxCompressedSize) {
+        return QCOW_UNABLE_TO_DECOMPRESS_CLUSTER;
+    }
+    CHK(QcowUtilPread(pQcow->Fd, pDecompressor->pCompressedBuffer, CompressedSize, HostAddress))
+#ifdef HAVE_LIBZSTD
+    if (pQcow->CompressionType == QCOW_COMPRESSION_ZSTD) {
+        return QcowZstdDecompress(pDecompressor, pDst, pQcow->ClusterSize, CompressedSize);
+    }
+#endif
+    r = XmountInflate(&pDecompressor->Inflate, XmountInflateFormat_Raw,
+                      pDst, &UncompressedSize,
+                      pDecompressor->pCompressedBuffer, CompressedSize);
+    if (r != Z_OK) {
+        return QCOW_UNABLE_TO_DECOMPRESS_CLUSTER;
+    }
+    return QCOW_OK;
+}
+
+/*
+ * QcowPoolRunJobs - Take jobs from the queue until it is empty. Must be called
+ * with PoolMutex held.
+ */
+static void QcowPoolRunJobs(t_pQcow pQcow, t_pQcowDecompressor pDecompressor) {
+    t_pQcowJob pJob;
+
+    while (pQcow->NextJob < pQcow->JobCount) {
+        pJob = &pQcow->pJobArr[pQcow->NextJob++];
+        pthread_mutex_unlock(&pQcow->PoolMutex);
+        pJob->Rc = QcowDecompressCluster(pQcow, pDecompressor, pJob->HostAddress,
+                                         pJob->CompressedSize, pJob->pEntry->pData);
+        pthread_mutex_lock(&pQcow->PoolMutex);
+        if (++pQcow->JobsDone == pQcow->JobCount) {
+            pthread_cond_signal(&pQcow->PoolCondDone);
+        }
+    }
+}
+
+/*
+ * QcowWorker - Thread function of the decompression pool
+ */
+static void* QcowWorker(void *pArg) {
+    t_pQcowWorker pWorker = (t_pQcowWorker)pArg;
+    t_pQcow pQcow = pWorker->pQcow;
+
+    pthread_mutex_lock(&pQcow->PoolMutex);
+    while (!pQcow->PoolShutdown) {
+        QcowPoolRunJobs(pQcow, &pWorker->Decompressor);
+        pthread_cond_wait(&pQcow->PoolCondJobs, &pQcow->PoolMutex);
+    }
+    pthread_mutex_unlock(&pQcow->PoolMutex);
+    return NULL;
+}
+
+/*
+ * QcowPoolInit - Start Threads-1 workers, the thread calling QcowRead being the
+ * last one
+ */
+static int QcowPoolInit(t_pQcow pQcow) {
+    uint64_t i;
+
+    if (pQcow->Threads < 2) {
+        return QCOW_OK;
+    }
+    pQcow->pWorkerArr = calloc(pQcow->Threads - 1, sizeof(t_QcowWorker));
+    if (pQcow->pWorkerArr == NULL) {
+        return QCOW_MEMALLOC_FAILED;
+    }
+    if (pthread_mutex_init(&pQcow->PoolMutex, NULL) != 0) {
+        return QCOW_CANNOT_CREATE_THREAD;
+    }
+    if (pthread_cond_init(&pQcow->PoolCondJobs, NULL) != 0) {
+        pthread_mutex_destroy(&pQcow->PoolMutex);
+        return QCOW_CANNOT_CREATE_THREAD;
+    }
+    if (pthread_cond_init(&pQcow->PoolCondDone, NULL) != 0) {
+        pthread_cond_destroy(&pQcow->PoolCondJobs);
+        pthread_mutex_destroy(&pQcow->PoolMutex);
+        return QCOW_CANNOT_CREATE_THREAD;
+    }
+    pQcow->PoolInitialised = 1;
+    pQcow->PoolShutdown = 0;
+
+    for (i = 0; i < pQcow->Threads - 1; i++) {
+        pQcow->pWorkerArr[i].pQcow = pQcow;
+        CHK(QcowDecompressorInit(pQcow, &pQcow->pWorkerArr[i].Decompressor))
+        if (pthread_create(&pQcow->pWorkerArr[i].Thread, NULL, QcowWorker, &pQcow->pWorkerArr[i]) != 0) {
+            QcowDecompressorDeInit(&pQcow->pWorkerArr[i].Decompressor);
+            return QCOW_CANNOT_CREATE_THREAD;
+        }
+        pQcow->Workers++;
+    }
+    return QCOW_OK;
+}
+
+/*
+ * QcowPoolDeInit
+ */
+static void QcowPoolDeInit(t_pQcow pQcow) {
+    uint64_t i;
+
+    if (pQcow->PoolInitialised) {
+        pthread_mutex_lock(&pQcow->PoolMutex);
+        pQcow->PoolShutdown = 1;
+        pthread_cond_broadcast(&pQcow->PoolCondJobs);
+        pthread_mutex_unlock(&pQcow->PoolMutex);
+        for (i = 0; i < pQcow->Workers; i++) {
+            pthread_join(pQcow->pWorkerArr[i].Thread, NULL);
+            QcowDecompressorDeInit(&pQcow->pWorkerArr[i].Decompressor);
+        }
+        pthread_cond_destroy(&pQcow->PoolCondDone);
+        pthread_cond_destroy(&pQcow->PoolCondJobs);
+        pthread_mutex_destroy(&pQcow->PoolMutex);
+        pQcow->PoolInitialised = 0;
+    }
+    free(pQcow->pWorkerArr);
+    pQcow->pWorkerArr = NULL;
+    pQcow->Workers = 0;
+}
+
+/*
+ * QcowDecompressRange - Decompress the compressed clusters of a request that
+ * are not cached yet in parallel. Clusters that fail are left out of the
+ * cache, so reading them later reports the error.
+ */
+static int QcowDecompressRange(t_pQcow pQcow, uint64_t Seek, uint64_t Count) {
+    t_pQcowJob pJob;
+    uint64_t Address;
+    uint64_t HostAddress;
+    uint64_t CompressedSize;
+    uint64_t Clusters = 0;
+    uint64_t Jobs = 0;
+    uint64_t i;
+    int Type;
+
+    if (pQcow->Workers == 0 || Count <= pQcow->ClusterSize) {
+        return QCOW_OK;
+    }
+
+    // Never look at more clusters than the cache holds, so no job's entry is
+    // recycled by a later one
+    Address = Seek - QcowClusterOffsetFromAddress(pQcow, Seek);
+    while (Address < Seek + Count && Clusters < pQcow->ClusterCacheEntries) {
+        CHK(QcowResolveCluster(pQcow, Address, &Type, &HostAddress, &CompressedSize))
+        Address += pQcow->ClusterSize;
+        if (Type != QCOW_CLUSTER_COMPRESSED) continue;
+        Clusters++;
+        if (QcowClusterCacheLookup(pQcow, HostAddress) != NULL) continue;
+        pJob = &pQcow->pJobArr[Jobs];
+        pJob->HostAddress = HostAddress;
+        pJob->CompressedSize = CompressedSize;
+        pJob->Rc = QCOW_OK;
+        CHK(QcowClusterCacheAlloc(pQcow, HostAddress, &pJob->pEntry))
+        Jobs++;
+    }
+    if (Jobs == 0) {
         return QCOW_OK;
+    }
+
+    pthread_mutex_lock(&pQcow->PoolMutex);
+    pQcow->JobCount = Jobs;
+    pQcow->NextJob = 0;
+    pQcow->JobsDone = 0;
+    pthread_cond_broadcast(&pQcow->PoolCondJobs);
+    QcowPoolRunJobs(pQcow, &pQcow->Decompressor);
+    while (pQcow->JobsDone < pQcow->JobCount) {
+        pthread_cond_wait(&pQcow->PoolCondDone, &pQcow->PoolMutex);
+    }
+    pQcow->JobCount = 0;
+    pQcow->NextJob = 0;
+    pthread_mutex_unlock(&pQcow->PoolMutex);
+
+    for (i = 0; i < Jobs; i++) {
+        pJob = &pQcow->pJobArr[i];
+        if (pJob->Rc != QCOW_OK) {
+            QcowClusterCacheDrop(pQcow, pJob->pEntry);
+        } else {
+            pQcow->ClustersDecompressed++;
+        }
+        pQcow->FileReads++;
+    }
+    return QCOW_OK;
+}
+
+/*
+ * QcowReadCompressed - Copy Count bytes starting at ClusterOffset out of a
+ * compressed cluster, decompressing it into the cache first if necessary
+ */
+static int QcowReadCompressed(t_pQcow pQcow,
+                              char *pBuffer,
+                              uint64_t HostAddress,
+                              uint64_t CompressedClusterSize,
+                              uint64_t ClusterOffset,
+                              uint64_t Count)
+{
+    t_pQcowClusterCacheEntry pEntry;
+    int rc;
+
+    pEntry = QcowClusterCacheLookup(pQcow, HostAddress);
+    if (pEntry != NULL) {
+        pQcow->ClusterCacheHits++;
     } else {
-        DataAddress = ClusterBaseAddress + ClusterOffset;
-        CHK(QcowUtilFileSeek(pQcow, DataAddress))
-        CHK(QcowUtilFileRead(pQcow, pBuffer, *pCount))
+        pQcow->ClusterCacheMisses++;
+        CHK(QcowClusterCacheAlloc(pQcow, HostAddress, &pEntry))
+        rc = QcowDecompressCluster(pQcow, &pQcow->Decompressor, HostAddress,
+                                   CompressedClusterSize, pEntry->pData);
+        pQcow->FileReads++;
+        if (rc != QCOW_OK) {
+            QcowClusterCacheDrop(pQcow, pEntry);
+            return rc;
+        }
+        pQcow->ClustersDecompressed++;
+    }
+    memcpy(pBuffer, pEntry->pData + ClusterOffset, Count);
+    return QCOW_OK;
+}
+
+/*
+ * QcowReadBacking - Read a range that is unallocated in this file from the
+ * backing file. The backing file may be smaller than this image, everything
+ * beyond its end reads as zeroes.
+ */
+static int QcowReadBacking(t_pQcow pQcow, char *pBuffer, uint64_t Seek, uint64_t Count)
+{
+    t_pQcow pBacking = pQcow->pBacking;
+    uint64_t InBacking = 0;
+
+    if (Seek < pBacking->Header.Size) {
+        InBacking = GETMIN(Count, pBacking->Header.Size - Seek);
+        CHK(QcowReadRange(pBacking, pBuffer, Seek, InBacking))
+        pQcow->BackingReads++;
+    }
+    memset(pBuffer + InBacking, '\0', Count - InBacking);
+    return QCOW_OK;
+}
+
+/*
+ * QcowRead0 - Read as much as possible of *pCount bytes with a single
+ * operation. Consecutive clusters that lie one after another in the qcow file
+ * are read with one pread, consecutive zero or unallocated clusters are filled
+ * without any I/O, or read from the backing file with a single request if there
+ * is one. A compressed cluster is always handled on its own.
+ * *pCount is set to the number of bytes actually read.
+ */
+static int QcowRead0(t_pQcow pQcow, char *pBuffer, uint64_t Seek, uint64_t *pCount)
+{
+    uint64_t ClusterOffset;
+    uint64_t HostAddress;
+    uint64_t CompressedSize;
+    uint64_t NextHostAddress;
+    uint64_t NextCompressedSize;
+    uint64_t Len;
+    uint64_t Step;
+    int Type;
+    int NextType;
+
+    ClusterOffset = QcowClusterOffsetFromAddress(pQcow, Seek);
+    Len = GETMIN(*pCount, pQcow->ClusterSize - ClusterOffset);
+    CHK(QcowResolveCluster(pQcow, Seek, &Type, &HostAddress, &CompressedSize))
+
+    if (Type == QCOW_CLUSTER_COMPRESSED) {
+        CHK(QcowReadCompressed(pQcow, pBuffer, HostAddress, CompressedSize, ClusterOffset, Len))
+        pQcow->ClustersRead++;
+        *pCount = Len;
         return QCOW_OK;
     }
+
+    // Extend the run as far as the following clusters allow it
+    while (Len < *pCount) {
+        CHK(QcowResolveCluster(pQcow, Seek + Len, &NextType, &NextHostAddress, &NextCompressedSize))
+        if (NextType != Type) break;
+        if (Type == QCOW_CLUSTER_DATA && NextHostAddress != HostAddress + ClusterOffset + Len) break;
+        Step = GETMIN(*pCount - Len, pQcow->ClusterSize);
+        Len += Step;
+    }
+
+    if (Type == QCOW_CLUSTER_ZERO) {
+        memset(pBuffer, '\0', Len);
+    } else if (Type == QCOW_CLUSTER_UNALLOCATED) {
+        CHK(QcowReadBacking(pQcow, pBuffer, Seek, Len))
+    } else {
+        CHK(QcowUtilFileReadAt(pQcow, pBuffer, Len, HostAddress + ClusterOffset))
+        pQcow->ClustersRead += (ClusterOffset + Len + pQcow->ClusterSize - 1) >> pQcow->Header.ClusterBits;
+    }
+    *pCount = Len;
+    return QCOW_OK;
+}
+
+/*
+ * QcowGetCPUs
+ */
+static uint64_t QcowGetCPUs(void) {
+    long CPUs = sysconf(_SC_NPROCESSORS_ONLN);
+    if (CPUs < 1) {
+        CPUs = 4;
+    }
+    return (uint64_t)CPUs;
 }
 
 /*
@@ -274,6 +958,9 @@ static int QcowCreateHandle(void **ppHandle,
     if (pQcow == NULL) return QCOW_MEMALLOC_FAILED;
 
     memset(pQcow, 0, sizeof(t_Qcow));
+    pQcow->MaxL2Cache = QCOW_DEFAULT_L2CACHE;
+    pQcow->MaxClusterCache = QCOW_DEFAULT_CLUSTERCACHE;
+    pQcow->Threads = QcowGetCPUs();
     *ppHandle = pQcow;
     return QCOW_OK;
 }
@@ -295,37 +982,144 @@ static int QcowOpen(void *pHandle,
                     uint64_t FilenameArrLen)
 {
     t_pQcow pQcow = (t_pQcow)pHandle;
+    int rc;
+
     if (FilenameArrLen == 0) {
         return QCOW_FILE_OPEN_FAILED;
     }
-    pQcow->pFilename = strdup(ppFilenameArr[0]);
+    rc = QcowOpenFile(pQcow, ppFilenameArr[0], 0);
+    if (rc != QCOW_OK) {
+        QcowClose(pHandle);
+        return rc;
+    }
+
+    return QCOW_OK;
+}
+
+/*
+ * QcowOpenFile - Open one file of the backing chain, Depth being its position
+ * in the chain. Backing files that are not qcow images are read as raw images.
+ * On error, the caller has to call QcowClose.
+ */
+static int QcowOpenFile(t_pQcow pQcow, const char *pFilename, uint32_t Depth)
+{
+    struct stat FileStat;
+    int rc;
+
+    pQcow->pFilename = strdup(pFilename);
+    if (pQcow->pFilename == NULL) {
+        return QCOW_MEMALLOC_FAILED;
+    }
     pQcow->pFile = fopen (pQcow->pFilename, "r");
     if (pQcow->pFile == NULL) {
-        QcowClose(pHandle);
         return QCOW_FILE_OPEN_FAILED;
     }
+    pQcow->Fd = fileno(pQcow->pFile);
 
     //Parse Qcow Header
-    CHK(QcowParseHeader(pQcow))
+    rc = QcowParseHeader(pQcow);
+    if (rc == QCOW_BAD_MAGIC_HEADER && Depth > 0) {
+        if (fstat(pQcow->Fd, &FileStat) != 0) {
+            return QCOW_CANNOT_READ_DATA;
+        }
+        memset(&pQcow->Header, 0, sizeof(t_QcowHeader));
+        pQcow->Header.Size = FileStat.st_size;
+        pQcow->IsRaw = 1;
+        return QCOW_OK;
+    }
+    CHK(rc)
 
     pQcow->L2Bits = pQcow->Header.ClusterBits - 3;
     pQcow->L2Size = (size_t)1 << pQcow->L2Bits;
     pQcow->L1Bits = 64 - pQcow->L2Bits - pQcow->Header.ClusterBits;
     pQcow->ClusterSize = (size_t)1 << pQcow->Header.ClusterBits;
+    // The sector count of a compressed cluster descriptor has ClusterBits-8 bits
+    pQcow->MaxCompressedSize = (uint64_t)512 << (pQcow->Header.ClusterBits - 8);
 
     //Cache L1 Table
     pQcow->pL1Table = malloc(pQcow->Header.L1Size * sizeof(uint64_t));
     if (pQcow->pL1Table == NULL) {
-        QcowClose(pHandle);
         return QCOW_MEMALLOC_FAILED;
     }
+    CHK(QcowUtilFileReadAt(pQcow, pQcow->pL1Table, pQcow->Header.L1Size * sizeof(uint64_t),
+                           pQcow->Header.L1TableOffset))
+
+    //Prepare L2 table cache, decompressed cluster cache and decompression threads
+    CHK(QcowL2CacheInit(pQcow))
+    CHK(QcowClusterCacheInit(pQcow))
+    CHK(QcowDecompressorInit(pQcow, &pQcow->Decompressor))
+    CHK(QcowPoolInit(pQcow))
 
-    CHK(QcowUtilFileSeek(pQcow, pQcow->Header.L1TableOffset))
-    CHK(QcowUtilFileRead(pQcow, pQcow->pL1Table,  pQcow->Header.L1Size * sizeof(uint64_t)))
+    //Open the rest of the chain
+    CHK(QcowOpenBacking(pQcow, Depth))
 
     return QCOW_OK;
 }
 
+/*
+ * QcowOpenBacking - Open the backing file, if any. A relative backing file
+ * name is relative to the directory of the file referring to it.
+ */
+static int QcowOpenBacking(t_pQcow pQcow, uint32_t Depth)
+{
+    t_pQcow pBacking;
+    char *pName;
+    char *pDir;
+    char *pPath;
+    int rc;
+
+    if (pQcow->Header.BackingFileOffset == 0 || pQcow->Header.BackingFileSize == 0) {
+        return QCOW_OK;
+    }
+    if (Depth + 1 >= QCOW_MAX_BACKING_DEPTH) {
+        return QCOW_BACKING_CHAIN_TOO_LONG;
+    }
+    if (pQcow->Header.BackingFileSize > QCOW_MAX_BACKING_NAME) {
+        return QCOW_CANNOT_OPEN_BACKING_FILE;
+    }
+
+    pName = calloc(pQcow->Header.BackingFileSize + 1, 1);
+    if (pName == NULL) {
+        return QCOW_MEMALLOC_FAILED;
+    }
+    rc = QcowUtilFileReadAt(pQcow, pName, pQcow->Header.BackingFileSize,
+                            pQcow->Header.BackingFileOffset);
+    if (rc != QCOW_OK) {
+        free(pName);
+        return rc;
+    }
+    if (pName[0] == '/') {
+        pPath = pName;
+    } else {
+        pDir = strdup(pQcow->pFilename);
+        if (pDir == NULL || asprintf(&pPath, "%s/%s", dirname(pDir), pName) < 0) {
+            free(pDir);
+            free(pName);
+            return QCOW_MEMALLOC_FAILED;
+        }
+        free(pDir);
+        free(pName);
+    }
+
+    rc = QcowCreateHandle((void**)&pBacking, NULL, NULL, 0);
+    if (rc != QCOW_OK) {
+        free(pPath);
+        return rc;
+    }
+    pQcow->pBacking = pBacking;
+    pBacking->MaxL2Cache = pQcow->MaxL2Cache;
+    pBacking->MaxClusterCache = pQcow->MaxClusterCache;
+    pBacking->Threads = 1; // Decompressing backing clusters in parallel isn't worth a pool per layer
+
+    rc = QcowOpenFile(pBacking, pPath, Depth + 1);
+    if (rc == QCOW_FILE_OPEN_FAILED) {
+        LOG_WARNING("Unable to open backing file '%s' of '%s'\n", pPath, pQcow->pFilename)
+        rc = QCOW_CANNOT_OPEN_BACKING_FILE;
+    }
+    free(pPath);
+    return rc;
+}
+
 /*
  * QcowClose
  */
@@ -339,6 +1133,14 @@ static int QcowClose(void *pHandle) {
         free(pQcow->pL1Table);
         pQcow->pL1Table = NULL;
     }
+    QcowPoolDeInit(pQcow);
+    QcowL2CacheDeInit(pQcow);
+    QcowClusterCacheDeInit(pQcow);
+    QcowDecompressorDeInit(&pQcow->Decompressor);
+    if (pQcow->pBacking) {
+        QcowClose(pQcow->pBacking);
+        QcowDestroyHandle((void**)&pQcow->pBacking);
+    }
     if (pQcow->pFile) {
         if (fclose (pQcow->pFile)) return QCOW_CANNOT_CLOSE_FILE;
         pQcow->pFile = NULL;
@@ -367,22 +1169,160 @@ static int QcowRead(void *pHandle,
 {
 
     t_pQcow pQcow = (t_pQcow)pHandle;
-    uint32_t Remaining = Count;
-    uint32_t ToRead;
 
     if ((Seek + Count) > pQcow->Header.Size) {
         return QCOW_READ_BEYOND_END_OF_IMAGE;
     }
-    do {
+    CHK(QcowReadRange(pQcow, pBuf, Seek, Count))
+
+    *pRead = Count;
+
+    return QCOW_OK;
+}
+
+/*
+ * QcowReadRange - Read from one file of the backing chain. The range must lie
+ * within the image.
+ */
+static int QcowReadRange(t_pQcow pQcow,
+                         char *pBuf,
+                         uint64_t Seek,
+                         uint64_t Count)
+{
+    uint64_t Remaining = Count;
+    uint64_t ToRead;
+
+    if (pQcow->IsRaw) {
+        return QcowUtilFileReadAt(pQcow, pBuf, Count, Seek);
+    }
+    CHK(QcowDecompressRange(pQcow, Seek, Count))
+    while (Remaining) {
         ToRead = Remaining;
         CHK(QcowRead0(pQcow, pBuf, Seek, &ToRead))
         Remaining -= ToRead;
         pBuf += ToRead;
         Seek += ToRead;
-    } while (Remaining);
+    }
+    return QCOW_OK;
+}
 
-    *pRead = Count;
+/*
+ * QcowGetExtents
+ */
+static int QcowGetExtents(void *pHandle,
+                          uint64_t Offset,
+                          uint64_t Count,
+                          pts_LibXmountExtent *ppExtents,
+                          uint64_t *pExtentsCount)
+{
+    t_pQcow pQcow = (t_pQcow)pHandle;
+    int rc;
+
+    *ppExtents = NULL;
+    *pExtentsCount = 0;
+    if ((Offset + Count) > pQcow->Header.Size) {
+        return QCOW_READ_BEYOND_END_OF_IMAGE;
+    }
+
+    rc = QcowAddExtents(pQcow, Offset, Count, ppExtents, pExtentsCount);
+    if (rc != QCOW_OK) {
+        free(*ppExtents);
+        *ppExtents = NULL;
+        *pExtentsCount = 0;
+    }
+    return rc;
+}
+
+/*
+ * QcowAddBackingExtents - Add the extents of a range that is unallocated in
+ * this file, as seen through the backing file
+ */
+static int QcowAddBackingExtents(t_pQcow pQcow,
+                                 uint64_t Offset,
+                                 uint64_t Count,
+                                 pts_LibXmountExtent *ppExtents,
+                                 uint64_t *pExtentsCount)
+{
+    t_pQcow pBacking = pQcow->pBacking;
+    uint64_t InBacking = 0;
 
+    if (Offset < pBacking->Header.Size) {
+        InBacking = GETMIN(Count, pBacking->Header.Size - Offset);
+        CHK(QcowAddExtents(pBacking, Offset, InBacking, ppExtents, pExtentsCount))
+    }
+    if (AddExtent(ppExtents, pExtentsCount, Offset + InBacking, Count - InBacking,
+                  LibXmountExtentType_Zero) != 0)
+    {
+        return QCOW_MEMALLOC_FAILED;
+    }
+    return QCOW_OK;
+}
+
+/*
+ * QcowAddExtents - Add the extents of a range of one file of the backing chain
+ * to *ppExtents. Clusters unallocated in this file are reported the way the
+ * backing file maps them.
+ */
+static int QcowAddExtents(t_pQcow pQcow,
+                          uint64_t Offset,
+                          uint64_t Count,
+                          pts_LibXmountExtent *ppExtents,
+                          uint64_t *pExtentsCount)
+{
+    uint64_t L1Offset;
+    uint64_t L2Offset;
+    uint64_t ClusterOffset;
+    uint64_t *pL2Table;
+    uint64_t L2Entry;
+    uint64_t Length;
+    uint64_t BackingOffset = 0;
+    uint64_t BackingCount = 0; /* Pending run of clusters to take from the backing file */
+    uint8_t Type;
+
+    if (pQcow->IsRaw) {
+        if (AddExtent(ppExtents, pExtentsCount, Offset, Count, LibXmountExtentType_Data) != 0) {
+            return QCOW_MEMALLOC_FAILED;
+        }
+        return QCOW_OK;
+    }
+
+    while (Count) {
+        L1Offset = QcowL1OffsetFromAddress(pQcow, Offset);
+        L2Offset = QcowL2OffsetFromAddress(pQcow, Offset);
+        ClusterOffset = QcowClusterOffsetFromAddress(pQcow, Offset);
+        CHK(QcowGetL2Table(pQcow, L1Offset, &pL2Table))
+
+        if (pL2Table == NULL) {
+            // No L2 table, so none of the clusters it would map is allocated
+            L2Entry = 0;
+            Length = ((pQcow->L2Size - L2Offset) << pQcow->Header.ClusterBits) - ClusterOffset;
+        } else {
+            L2Entry = pL2Table[L2Offset];
+            Length = pQcow->ClusterSize - ClusterOffset;
+        }
+        Length = GETMIN(Length, Count);
+
+        if (QcowL2EntryIsZero(L2Entry) && pQcow->pBacking != NULL && !(L2Entry & 1)) {
+            if (BackingCount == 0) {
+                BackingOffset = Offset;
+            }
+            BackingCount += Length;
+        } else {
+            if (BackingCount != 0) {
+                CHK(QcowAddBackingExtents(pQcow, BackingOffset, BackingCount, ppExtents, pExtentsCount))
+                BackingCount = 0;
+            }
+            Type = QcowL2EntryIsZero(L2Entry) ? LibXmountExtentType_Zero : LibXmountExtentType_Data;
+            if (AddExtent(ppExtents, pExtentsCount, Offset, Length, Type) != 0) {
+                return QCOW_MEMALLOC_FAILED;
+            }
+        }
+        Offset += Length;
+        Count -= Length;
+    }
+    if (BackingCount != 0) {
+        CHK(QcowAddBackingExtents(pQcow, BackingOffset, BackingCount, ppExtents, pExtentsCount))
+    }
     return QCOW_OK;
 }
 
@@ -390,7 +1330,27 @@ static int QcowRead(void *pHandle,
  * QcowOptionsHelp
  */
 static int QcowOptionsHelp(const char **ppHelp) {
-    *ppHelp = NULL;
+    int ok;
+    char *pBuf;
+
+    ok = asprintf(&pBuf,
+                  "    " QCOW_OPTION_L2CACHE " : Maximum amount of RAM, in MiB, for "
+                    "caching L2 tables. At least one table is cached. "
+                    "Defaults to %u.\n"
+                  "    " QCOW_OPTION_CLUSTERCACHE " : Maximum amount of RAM, in MiB, for "
+                    "caching decompressed clusters. At least one cluster per "
+                    "thread is cached. Defaults to %u.\n"
+                  "    " QCOW_OPTION_THREADS " : Number of threads decompressing the "
+                    "clusters of a request in parallel. Defaults to the number "
+                    "of CPUs (%" PRIu64 ").\n",
+                  QCOW_DEFAULT_L2CACHE,
+                  QCOW_DEFAULT_CLUSTERCACHE,
+                  QcowGetCPUs());
+    if (ok < 0 || pBuf == NULL) {
+        *ppHelp = NULL;
+        return QCOW_MEMALLOC_FAILED;
+    }
+    *ppHelp = pBuf;
     return QCOW_OK;
 }
 
@@ -402,6 +1362,40 @@ static int QcowOptionsParse(void *pHandle,
                             const pts_LibXmountOptions *ppOptions,
                             const char **ppError)
 {
+    t_pQcow pQcow = (t_pQcow)pHandle;
+    int ok;
+    uint64_t Value;
+    char *pBuf;
+
+    for (uint32_t i = 0; i < OptionsCount; i++) {
+        if (strcmp(ppOptions[i]->p_key, QCOW_OPTION_L2CACHE) == 0 ||
+            strcmp(ppOptions[i]->p_key, QCOW_OPTION_CLUSTERCACHE) == 0 ||
+            strcmp(ppOptions[i]->p_key, QCOW_OPTION_THREADS) == 0)
+        {
+            Value = StrToUint64(ppOptions[i]->p_value, &ok);
+            if (ok == 0) {
+                // Conversion failed, generate error message and return
+                ok = asprintf(&pBuf,
+                              "Unable to parse value '%s' of '%s' as a number",
+                              ppOptions[i]->p_value,
+                              ppOptions[i]->p_key);
+                if (ok < 0 || pBuf == NULL) {
+                    *ppError = NULL;
+                    return QCOW_MEMALLOC_FAILED;
+                }
+                *ppError = pBuf;
+                return QCOW_CANNOT_PARSE_OPTION;
+            }
+            if (strcmp(ppOptions[i]->p_key, QCOW_OPTION_L2CACHE) == 0) {
+                pQcow->MaxL2Cache = Value;
+            } else if (strcmp(ppOptions[i]->p_key, QCOW_OPTION_CLUSTERCACHE) == 0) {
+                pQcow->MaxClusterCache = Value;
+            } else {
+                pQcow->Threads = GETMAX(Value, 1);
+            }
+            ppOptions[i]->valid = 1;
+        }
+    }
     return QCOW_OK;
 }
 
@@ -410,28 +1404,81 @@ static int QcowOptionsParse(void *pHandle,
  */
 static int QcowGetInfofileContent(void *pHandle, const char **ppInfoBuf) {
     t_pQcow pQcow = (t_pQcow)pHandle;
+    t_pQcow pLayer;
     int ret;
     char *p_info_buf;
+    char *p_tmp;
 
     ret = asprintf(&p_info_buf,
                    "Image size               %" PRIu64 " bytes in total (%0.3f GiB)\n"
                    "QCow Version             %u\n"
                    "Cluster Size             %" PRIu64 "\n"
+                   "Compression              %s\n"
                    "L1 Table Size            %u\n"
-                   "L2 Table Size            %" PRIu64 "\n",
+                   "L2 Table Size            %" PRIu64 "\n"
+                   "L2 Table Cache Entries   %" PRIu64 "\n"
+                   "Cluster Cache Entries    %" PRIu64 "\n"
+                   "Decompression Threads    %" PRIu64 "\n",
                    pQcow->Header.Size,
                    pQcow->Header.Size / (1024.0 * 1024.0 * 1024.0),
                    pQcow->Header.Version,
                    pQcow->ClusterSize,
+                   (pQcow->CompressionType == QCOW_COMPRESSION_ZSTD) ? "zstd" : "deflate",
                    pQcow->Header.L1Size,
-                   pQcow->L2Size
+                   pQcow->L2Size,
+                   pQcow->L2CacheEntries,
+                   pQcow->ClusterCacheEntries,
+                   pQcow->Workers + 1
                    );
-    if (ret < 0 || *ppInfoBuf == NULL) return QCOW_MEMALLOC_FAILED;
+    if (ret < 0 || p_info_buf == NULL) return QCOW_MEMALLOC_FAILED;
+
+    for (pLayer = pQcow->pBacking; pLayer != NULL; pLayer = pLayer->pBacking) {
+        ret = asprintf(&p_tmp,
+                       "%sBacking File             %s (%s, %" PRIu64 " bytes)\n",
+                       p_info_buf,
+                       pLayer->pFilename,
+                       pLayer->IsRaw ? "raw" : "qcow",
+                       pLayer->Header.Size);
+        free(p_info_buf);
+        if (ret < 0 || p_tmp == NULL) return QCOW_MEMALLOC_FAILED;
+        p_info_buf = p_tmp;
+    }
 
     *ppInfoBuf = p_info_buf;
     return QCOW_OK;
 }
 
+/*
+ * QcowGetStats
+ */
+static int QcowGetStats(void *pHandle,
+                        pts_LibXmountStat *ppStats,
+                        uint32_t *pStatsCount)
+{
+    t_pQcow pQcow = (t_pQcow)pHandle;
+
+    *ppStats = NULL;
+    *pStatsCount = 0;
+    if (AddStat(ppStats, pStatsCount, "L2 cache hits", pQcow->L2CacheHits) != 0 ||
+        AddStat(ppStats, pStatsCount, "L2 cache misses", pQcow->L2CacheMisses) != 0 ||
+        AddStat(ppStats, pStatsCount, "L2 cache entries", pQcow->L2CacheEntries) != 0 ||
+        AddStat(ppStats, pStatsCount, "Clusters read", pQcow->ClustersRead) != 0 ||
+        AddStat(ppStats, pStatsCount, "File reads", pQcow->FileReads) != 0 ||
+        AddStat(ppStats, pStatsCount, "Cluster cache hits", pQcow->ClusterCacheHits) != 0 ||
+        AddStat(ppStats, pStatsCount, "Cluster cache misses", pQcow->ClusterCacheMisses) != 0 ||
+        AddStat(ppStats, pStatsCount, "Cluster cache entries", pQcow->ClusterCacheEntries) != 0 ||
+        AddStat(ppStats, pStatsCount, "Clusters decompressed", pQcow->ClustersDecompressed) != 0 ||
+        AddStat(ppStats, pStatsCount, "Decompression threads", pQcow->Workers + 1) != 0 ||
+        AddStat(ppStats, pStatsCount, "Backing file reads", pQcow->BackingReads) != 0)
+    {
+        free(*ppStats);
+        *ppStats = NULL;
+        *pStatsCount = 0;
+        return QCOW_MEMALLOC_FAILED;
+    }
+    return QCOW_OK;
+}
+
 /*
  * QcowGetErrorMessage
  */
@@ -456,7 +1503,7 @@ static const char* QcowGetErrorMessage(int ErrNum) {
         return "Got an L1 Index that is bigger than the L1 table size";
         break;
     case QCOW_BAD_VERSION:
-        return "Unsupported qcow file version. Only v2 is supported.";
+        return "Unsupported qcow file version. Only v2 and v3 are supported.";
         break;
     case QCOW_CANNOT_SEEK:
         return "Unable to seek into qcow data";
@@ -470,6 +1517,24 @@ static const char* QcowGetErrorMessage(int ErrNum) {
     case QCOW_UNSUPPORTED_ENCRYPTION:
         return "Encrpyted qcow format is not supported";
         break;
+    case QCOW_CANNOT_PARSE_OPTION:
+        return "Unable to parse library option";
+        break;
+    case QCOW_CANNOT_CREATE_THREAD:
+        return "Unable to start decompression threads";
+        break;
+    case QCOW_UNSUPPORTED_FEATURE:
+        return "The qcow file uses an unsupported incompatible feature";
+        break;
+    case QCOW_UNSUPPORTED_COMPRESSION:
+        return "The qcow file uses an unsupported compression type";
+        break;
+    case QCOW_CANNOT_OPEN_BACKING_FILE:
+        return "Unable to open backing file";
+        break;
+    case QCOW_BACKING_CHAIN_TOO_LONG:
+        return "Backing file chain too long or circular";
+        break;
     default:
         return "Unknown error";
     }
@@ -23,7 +23,9 @@
 
 #include <stdint.h>
 #include <stdio.h>
+#include <pthread.h>
 #include "../libxmount_input.h"
+#include "../../libxmount/libxmount_inflate.h"
 
 /*******************************************************************************
  * Error codes etc...
@@ -41,7 +43,13 @@ enum {
    QCOW_CANNOT_SEEK,
    QCOW_UNABLE_TO_DECOMPRESS_CLUSTER,
    QCOW_READ_BEYOND_END_OF_IMAGE,
-   QCOW_BAD_L1_OFFSET
+   QCOW_BAD_L1_OFFSET,
+   QCOW_CANNOT_PARSE_OPTION,
+   QCOW_CANNOT_CREATE_THREAD,
+   QCOW_UNSUPPORTED_FEATURE,
+   QCOW_UNSUPPORTED_COMPRESSION,
+   QCOW_CANNOT_OPEN_BACKING_FILE,
+   QCOW_BACKING_CHAIN_TOO_LONG
 };
 
 // ----------------------
@@ -51,6 +59,38 @@ enum {
 #define GETMAX(a,b) ((a)>(b)?(a):(b))
 #define GETMIN(a,b) ((a)<(b)?(a):(b))
 
+#define QCOW_OPTION_L2CACHE "qcowl2cache"
+#define QCOW_DEFAULT_L2CACHE 16 // MiB
+#define QCOW_L2CACHE_UNUSED UINT64_MAX
+#define QCOW_OPTION_CLUSTERCACHE "qcowclustercache"
+#define QCOW_DEFAULT_CLUSTERCACHE 8 // MiB
+#define QCOW_CLUSTERCACHE_UNUSED UINT64_MAX
+#define QCOW_OPTION_THREADS "qcowthreads"
+
+#define QCOW_MAX_BACKING_DEPTH 64
+#define QCOW_MAX_BACKING_NAME 1023 // Limit imposed by the qcow2 specification
+
+// Incompatible feature bits of qcow2 v3
+#define QCOW_INCOMPAT_DIRTY            (UINT64_C(1) << 0)
+#define QCOW_INCOMPAT_CORRUPT          (UINT64_C(1) << 1)
+#define QCOW_INCOMPAT_EXTERNAL_DATA    (UINT64_C(1) << 2)
+#define QCOW_INCOMPAT_COMPRESSION_TYPE (UINT64_C(1) << 3)
+#define QCOW_INCOMPAT_EXTENDED_L2      (UINT64_C(1) << 4)
+#define QCOW_INCOMPAT_SUPPORTED (QCOW_INCOMPAT_DIRTY | QCOW_INCOMPAT_CORRUPT | \
+                                 QCOW_INCOMPAT_COMPRESSION_TYPE)
+
+// Compression types of qcow2 v3
+#define QCOW_COMPRESSION_DEFLATE 0
+#define QCOW_COMPRESSION_ZSTD    1
+
+// Cluster types as found by QcowResolveCluster
+enum {
+   QCOW_CLUSTER_ZERO = 0, /* Zero flag set, or unallocated without backing file */
+   QCOW_CLUSTER_UNALLOCATED, /* Unallocated, data comes from the backing file */
+   QCOW_CLUSTER_DATA,
+   QCOW_CLUSTER_COMPRESSED
+};
+
 // ---------------------
 //  Types and strutures
 // ---------------------
@@ -68,17 +108,108 @@ typedef struct {
    uint32_t RefCountTableClusters;
    uint32_t NbSnapshots;
    uint64_t SnapshotsOffset;
+   // Version 3 only
+   uint64_t IncompatibleFeatures;
+   uint64_t CompatibleFeatures;
+   uint64_t AutoclearFeatures;
+   uint32_t RefCountOrder;
+   uint32_t HeaderLength;
+   uint8_t CompressionType; /* Only valid if HeaderLength > 104 */
 } t_QcowHeader, *t_pQcowHeader;
 
+// LRU cache of L2 tables. Each cached table belongs to one L1 entry, so a cached
+// table is found through ppL2CacheMap, which has one slot per L1 entry.
+typedef struct s_QcowL2CacheEntry {
+   uint64_t L1Index; /* QCOW_L2CACHE_UNUSED if the entry is free */
+   uint64_t *pL2Table; /* L2Size entries, already converted to host byte order */
+   struct s_QcowL2CacheEntry *pPrev; /* Towards the most recently used entry */
+   struct s_QcowL2CacheEntry *pNext; /* Towards the least recently used entry */
+} t_QcowL2CacheEntry, *t_pQcowL2CacheEntry;
+
+// LRU cache of decompressed clusters. Entries are keyed by the address of the
+// compressed data in the qcow file and found through a small hash table.
+typedef struct s_QcowClusterCacheEntry {
+   uint64_t HostAddress; /* QCOW_CLUSTERCACHE_UNUSED if the entry is free */
+   char *pData; /* ClusterSize bytes of decompressed data */
+   struct s_QcowClusterCacheEntry *pPrev; /* Towards the most recently used entry */
+   struct s_QcowClusterCacheEntry *pNext; /* Towards the least recently used entry */
+   struct s_QcowClusterCacheEntry *pHashNext;
+} t_QcowClusterCacheEntry, *t_pQcowClusterCacheEntry;
+
+// Everything needed to decompress a cluster. Each thread has its own one.
+typedef struct {
+   ts_XmountInflate Inflate;
+   void *pZstdCtx; /* ZSTD_DCtx, allocated on first use */
+   char *pCompressedBuffer; /* Big enough for the largest compressed cluster */
+} t_QcowDecompressor, *t_pQcowDecompressor;
+
+// A compressed cluster to be decompressed into a cache entry by the pool
 typedef struct {
+   uint64_t HostAddress;
+   uint64_t CompressedSize;
+   t_pQcowClusterCacheEntry pEntry;
+   int Rc;
+} t_QcowJob, *t_pQcowJob;
+
+typedef struct s_QcowWorker {
+   pthread_t Thread;
+   struct s_Qcow *pQcow;
+   t_QcowDecompressor Decompressor;
+} t_QcowWorker, *t_pQcowWorker;
+
+// One t_Qcow per file of a backing chain. Backing files get a handle of their
+// own, so each layer has its own L2 and cluster caches.
+typedef struct s_Qcow {
    char     *pFilename;
    FILE     *pFile;
+   int      Fd; /* File descriptor of pFile, for reading with pread */
+   int      IsRaw; /* Backing file that isn't a qcow image */
    t_QcowHeader Header;
+   uint8_t CompressionType;
+   struct s_Qcow *pBacking; /* NULL for the last file of the chain */
+   uint64_t BackingReads;
    uint64_t* pL1Table;
    uint32_t L2Bits;
    uint64_t L2Size;
    uint32_t L1Bits;
    uint64_t ClusterSize;
+   uint64_t MaxCompressedSize;
+   t_QcowDecompressor Decompressor; /* Used by the thread calling QcowRead */
+   t_pQcowL2CacheEntry pL2CacheArr;
+   t_pQcowL2CacheEntry *ppL2CacheMap;
+   uint64_t L2CacheEntries;
+   t_pQcowL2CacheEntry pL2CacheHead; /* Most recently used */
+   t_pQcowL2CacheEntry pL2CacheTail; /* Least recently used, recycled next */
+   uint64_t L2CacheHits;
+   uint64_t L2CacheMisses;
+   uint64_t ClustersRead;
+   uint64_t FileReads;
+   t_pQcowClusterCacheEntry pClusterCacheArr;
+   t_pQcowClusterCacheEntry *ppClusterCacheHash;
+   uint64_t ClusterCacheEntries;
+   uint64_t ClusterCacheHashSize;
+   t_pQcowClusterCacheEntry pClusterCacheHead; /* Most recently used */
+   t_pQcowClusterCacheEntry pClusterCacheTail; /* Least recently used, recycled next */
+   uint64_t ClusterCacheHits;
+   uint64_t ClusterCacheMisses;
+   uint64_t ClustersDecompressed;
+   // Decompression thread pool. The jobs of one request are shared out between
+   // the workers and the thread calling QcowRead.
+   t_pQcowWorker pWorkerArr;
+   uint64_t Workers; /* Number of started worker threads */
+   pthread_mutex_t PoolMutex;
+   pthread_cond_t PoolCondJobs; /* Signalled when jobs are queued or on shutdown */
+   pthread_cond_t PoolCondDone; /* Signalled when the last job is finished */
+   int PoolInitialised;
+   int PoolShutdown;
+   t_pQcowJob pJobArr; /* ClusterCacheEntries slots */
+   uint64_t JobCount;
+   uint64_t NextJob;
+   uint64_t JobsDone;
+   // Options
+   uint64_t MaxL2Cache; /* in MiB */
+   uint64_t MaxClusterCache; /* in MiB */
+   uint64_t Threads;
 } t_Qcow, *t_pQcow;
 
 // ----------------
@@ -129,6 +260,11 @@ static int QcowRead(void *pHandle,
                     size_t count,
                     size_t *pRead,
                     int *pErrno);
+static int QcowGetExtents(void *pHandle,
+                          uint64_t Offset,
+                          uint64_t Count,
+                          pts_LibXmountExtent *ppExtents,
+                          uint64_t *pExtentsCount);
 static int QcowOptionsHelp(const char **ppHelp);
 static int QcowOptionsParse(void *pHandle,
                             uint32_t OptionsCount,
@@ -136,8 +272,26 @@ static int QcowOptionsParse(void *pHandle,
                             const char **ppError);
 static int QcowGetInfofileContent(void *pHandle,
                                   const char **ppInfoBuf);
+static int QcowGetStats(void *pHandle,
+                        pts_LibXmountStat *ppStats,
+                        uint32_t *pStatsCount);
 static const char* QcowGetErrorMessage(int ErrNum);
 static int QcowFreeBuffer(void *pBuf);
 
+static int QcowOpenFile(t_pQcow pQcow,
+                        const char *pFilename,
+                        uint32_t Depth);
+static int QcowOpenBacking(t_pQcow pQcow,
+                           uint32_t Depth);
+static int QcowReadRange(t_pQcow pQcow,
+                         char *pBuf,
+                         uint64_t Seek,
+                         uint64_t Count);
+static int QcowAddExtents(t_pQcow pQcow,
+                          uint64_t Offset,
+                          uint64_t Count,
+                          pts_LibXmountExtent *ppExtents,
+                          uint64_t *pExtentsCount);
+
 #endif // LIBXMOUNT_INPUT_QCOW_H
 
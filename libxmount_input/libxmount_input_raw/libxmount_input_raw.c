@@ -22,6 +22,11 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/mman.h>
 
 #include "../libxmount_input.h"
 #include "libxmount_input_raw.h"
@@ -59,6 +64,8 @@ void LibXmount_Input_GetFunctions(ts_LibXmountInputFunctions *p_functions) {
   p_functions->Close=&RawClose;
   p_functions->Size=&RawSize;
   p_functions->Read=&RawRead;
+  p_functions->GetExtents=&RawGetExtents;
+  p_functions->IsReentrant=&RawIsReentrant;
   p_functions->OptionsHelp=&RawOptionsHelp;
   p_functions->OptionsParse=&RawOptionsParse;
   p_functions->GetInfofileContent=&RawGetInfofileContent;
@@ -74,43 +81,209 @@ void LibXmount_Input_GetFunctions(ts_LibXmountInputFunctions *p_functions) {
 //  Internal static functions
 // ---------------------------
 
-static inline uint64_t RawGetCurrentSeekPos(t_pPiece pPiece) {
-  return ftello(pPiece->pFile);
+// Binary search for the piece containing Seek. As the pieces' offsets are
+// sorted, this is O(log n) even for split images with thousands of pieces.
+static t_pPiece RawFindPiece(t_praw praw, uint64_t Seek)
+{
+  uint64_t Lo = 0;
+  uint64_t Hi = praw->Pieces;
+  uint64_t Mid;
+
+  while (Hi - Lo > 1)
+  {
+    Mid = Lo + (Hi - Lo) / 2;
+    if (praw->pPieceArr[Mid].Offset <= Seek) Lo = Mid;
+    else                                     Hi = Mid;
+  }
+  return &praw->pPieceArr[Lo];
 }
 
-static inline int RawSetCurrentSeekPos(t_pPiece pPiece,
-                                       uint64_t Val,
-                                       int Whence)
+// Build the hole / data map of a piece using SEEK_DATA and SEEK_HOLE. This is
+// done lazily on first access of the piece as scanning a large, heavily
+// fragmented file may take a while. If the filesystem or platform doesn't
+// support these seek modes, the whole piece is considered to be data.
+static int RawScanPiece(t_praw praw, t_pPiece pPiece)
 {
-  if (fseeko (pPiece->pFile, Val, Whence) != 0) return RAW_CANNOT_SEEK;
-  return RAW_OK;
+  pts_LibXmountExtent pExtentArr = NULL;
+  uint64_t            Extents    = 0;
+  uint64_t            Pos        = 0;
+  off_t               Data;
+  off_t               Hole;
+  int                 rc         = RAW_OK;
+
+  if (__atomic_load_n (&pPiece->ExtentsScanned, __ATOMIC_ACQUIRE)) return RAW_OK;
+
+  pthread_mutex_lock (&praw->ExtentMutex);
+  if (pPiece->ExtentsScanned) goto Leave;
+
+#if defined(SEEK_DATA) && defined(SEEK_HOLE)
+  while (Pos < pPiece->FileSize)
+  {
+    Data = lseek (pPiece->Fd, Pos, SEEK_DATA);
+    if (Data < 0)
+    {
+      if (errno != ENXIO) goto NoHoles;  // Not supported
+      Data = pPiece->FileSize;           // Only a hole follows
+    }
+    if ((uint64_t)Data > pPiece->FileSize) Data = pPiece->FileSize;
+    if (AddExtent (&pExtentArr, &Extents, Pos, Data - Pos, LibXmountExtentType_Zero))
+    {
+      rc = RAW_MEMALLOC_FAILED;
+      goto Leave;
+    }
+    if ((uint64_t)Data >= pPiece->FileSize) break;
+
+    Hole = lseek (pPiece->Fd, Data, SEEK_HOLE);
+    if (Hole < 0) goto NoHoles;
+    if ((uint64_t)Hole > pPiece->FileSize) Hole = pPiece->FileSize;
+    if (AddExtent (&pExtentArr, &Extents, Data, Hole - Data, LibXmountExtentType_Data))
+    {
+      rc = RAW_MEMALLOC_FAILED;
+      goto Leave;
+    }
+    Pos = Hole;
+  }
+  // A piece consisting of data only doesn't need a map
+  if ((Extents == 1) && (pExtentArr[0].type == LibXmountExtentType_Data)) goto NoHoles;
+  goto Done;
+#endif
+
+NoHoles:
+  free (pExtentArr);
+  pExtentArr = NULL;
+  Extents    = 0;
+
+Done:
+  pPiece->pExtentArr = pExtentArr;
+  pPiece->Extents    = Extents;
+  pExtentArr         = NULL;
+  __atomic_store_n (&pPiece->ExtentsScanned, 1, __ATOMIC_RELEASE);
+
+Leave:
+  pthread_mutex_unlock (&praw->ExtentMutex);
+  free (pExtentArr);
+  return rc;
 }
 
-static int RawRead0(t_praw praw, char *pBuffer, uint64_t Seek, uint32_t *pCount)
+// Binary search for the extent containing Seek (relative to the piece)
+static pts_LibXmountExtent RawFindExtent(t_pPiece pPiece, uint64_t Seek)
 {
-  t_pPiece pPiece;
-  uint64_t  i;
+  uint64_t Lo = 0;
+  uint64_t Hi = pPiece->Extents;
+  uint64_t Mid;
 
-  // Find correct piece to read from
-  // -------------------------------
+  while (Hi - Lo > 1)
+  {
+    Mid = Lo + (Hi - Lo) / 2;
+    if (pPiece->pExtentArr[Mid].offset <= Seek) Lo = Mid;
+    else                                        Hi = Mid;
+  }
+  return &pPiece->pExtentArr[Lo];
+}
+
+// Positional read, does not touch any file position and can therefore be
+// called concurrently
+static int RawPread(t_pPiece pPiece, char *pBuffer, uint64_t Seek, uint64_t Count, int *pErrno)
+{
+  ssize_t Ret;
 
-  for (i=0; i<praw->Pieces; i++)
+  while (Count)
   {
-    pPiece = &praw->pPieceArr[i];
-    if (Seek < pPiece->FileSize) break;
-    Seek -= pPiece->FileSize;
+    Ret = pread (pPiece->Fd, pBuffer, Count, Seek);
+    if (Ret < 0)
+    {
+      if (errno == EINTR) continue;
+      *pErrno = errno;
+      return RAW_CANNOT_READ_DATA;
+    }
+    if (Ret == 0)
+    {
+      // Piece was truncated since it was opened
+      *pErrno = EIO;
+      return RAW_CANNOT_READ_DATA;
+    }
+    pBuffer += Ret;
+    Seek    += Ret;
+    Count   -= Ret;
+  }
+
+  return RAW_OK;
+}
+
+// Give the kernel hints about how a mapped piece is accessed. Consecutive reads
+// switch the mapping to sequential mode and prefetch the following window,
+// everything else switches it to random mode to avoid useless readahead.
+// madvise is only called when the access pattern changes or a new window is
+// entered, so hot data is served without any syscall.
+// As this function may be called concurrently, the hint state is accessed
+// atomically. Races only result in superfluous or missing hints.
+static void RawAdvise(t_praw praw, t_pPiece pPiece, uint64_t Seek, uint64_t Count)
+{
+  uint64_t NextSeek;
+  uint64_t Window;
+  uint64_t Len;
+  int      Advice;
+
+  NextSeek = __atomic_exchange_n (&pPiece->NextSeek, Seek + Count, __ATOMIC_RELAXED);
+  Advice   = (Seek == NextSeek) ? RAW_ADVICE_SEQUENTIAL : RAW_ADVICE_RANDOM;
+  if (__atomic_exchange_n (&pPiece->Advice, Advice, __ATOMIC_RELAXED) != Advice)
+  {
+    madvise (pPiece->pMap, pPiece->FileSize,
+             (Advice == RAW_ADVICE_SEQUENTIAL) ? MADV_SEQUENTIAL : MADV_RANDOM);
+  }
+  if (Advice != RAW_ADVICE_SEQUENTIAL) return;
+
+  // Prefetch next window when this read entered a new one
+  Window = (Seek + Count) / RAW_MMAP_READAHEAD;
+  if ((Seek == 0) || (Window != Seek / RAW_MMAP_READAHEAD))
+  {
+    Seek = Window * RAW_MMAP_READAHEAD;
+    if (Seek + RAW_MMAP_READAHEAD < pPiece->FileSize)
+    {
+      Seek += RAW_MMAP_READAHEAD;
+      Len   = GETMIN (RAW_MMAP_READAHEAD, pPiece->FileSize - Seek);
+      Seek -= Seek % praw->PageSize;
+      madvise (pPiece->pMap + Seek, Len, MADV_WILLNEED);
+    }
   }
-  if (i >= praw->Pieces) return RAW_READ_BEYOND_END_OF_IMAGE;
+}
+
+static int RawRead0(t_praw praw, char *pBuffer, uint64_t Seek, uint64_t *pCount, int *pErrno)
+{
+  t_pPiece            pPiece;
+  pts_LibXmountExtent pExtent;
+
+  // Find correct piece to read from
+  // -------------------------------
+  if (Seek >= praw->TotalSize) return RAW_READ_BEYOND_END_OF_IMAGE;
+  pPiece = RawFindPiece (praw, Seek);
+  Seek -= pPiece->Offset;
 
   // Read from this piece
   // --------------------
-  CHK (RawSetCurrentSeekPos (pPiece, Seek, SEEK_SET))
-
   *pCount = GETMIN (*pCount, pPiece->FileSize - Seek);
 
-  if (fread (pBuffer, *pCount, 1, pPiece->pFile) != 1)
+  // Holes of sparse pieces are served without any I/O
+  CHK (RawScanPiece (praw, pPiece))
+  if (pPiece->Extents)
+  {
+    pExtent = RawFindExtent (pPiece, Seek);
+    *pCount = GETMIN (*pCount, pExtent->offset + pExtent->length - Seek);
+    if (pExtent->type == LibXmountExtentType_Zero)
+    {
+      memset (pBuffer, 0, *pCount);
+      return RAW_OK;
+    }
+  }
+
+  if (pPiece->pMap)
   {
-    return RAW_CANNOT_READ_DATA;
+    RawAdvise (praw, pPiece, Seek, *pCount);
+    memcpy (pBuffer, pPiece->pMap + Seek, *pCount);
+  }
+  else
+  {
+    CHK (RawPread (pPiece, pBuffer, Seek, *pCount, pErrno))
   }
 
   return RAW_OK;
@@ -153,6 +326,7 @@ static int RawCreateHandle(void **pp_handle,
   if(p_raw==NULL) return RAW_MEMALLOC_FAILED;
 
   memset(p_raw,0,sizeof(t_raw));
+  pthread_mutex_init(&(p_raw->ExtentMutex),NULL);
 
   if(strcmp(p_format,"dd")==0) {
     LOG_WARNING("Using '--in dd' is deprecated and will be removed in the next "
@@ -167,6 +341,9 @@ static int RawCreateHandle(void **pp_handle,
  * RawDestroyHandle
  */
 static int RawDestroyHandle(void **pp_handle) {
+  t_praw p_raw=(t_praw)*pp_handle;
+
+  pthread_mutex_destroy(&(p_raw->ExtentMutex));
   free(*pp_handle);
   *pp_handle=NULL;
   return RAW_OK;
@@ -188,6 +365,7 @@ static int RawOpen(void *p_handle,
   // Need to set everything to 0 in case an error occurs later and RawClose is
   // called
   memset(praw->pPieceArr,0,praw->Pieces * sizeof(t_Piece));
+  for (uint64_t i=0; i < praw->Pieces; i++) praw->pPieceArr[i].Fd = -1;
 
   praw->TotalSize = 0;
   for (uint64_t i=0; i < praw->Pieces; i++) 
@@ -199,16 +377,36 @@ static int RawOpen(void *p_handle,
       RawClose(p_handle);
       return RAW_MEMALLOC_FAILED;
     }
-    pPiece->pFile = fopen (pPiece->pFilename, "r");
-    if (pPiece->pFile == NULL)
+    pPiece->Fd = open (pPiece->pFilename, O_RDONLY);
+    if (pPiece->Fd < 0)
     {
       RawClose(p_handle);
       return RAW_FILE_OPEN_FAILED;
     }
-    CHK(RawSetCurrentSeekPos(pPiece, 0, SEEK_END))
-    pPiece->FileSize = RawGetCurrentSeekPos (pPiece);
+    // Use lseek rather than fstat as st_size is 0 for block devices
+    off_t FileSize = lseek (pPiece->Fd, 0, SEEK_END);
+    if (FileSize < 0)
+    {
+      RawClose(p_handle);
+      return RAW_CANNOT_SEEK;
+    }
+    pPiece->FileSize  = FileSize;
+    pPiece->Offset    = praw->TotalSize;
     praw->TotalSize  += pPiece->FileSize;
+
+    // In mmap mode, map the whole piece. If this fails (for ex. because of
+    // insufficient address space), fall back to pread for this piece.
+    if (praw->UseMmap && pPiece->FileSize)
+    {
+      pPiece->pMap = mmap (NULL, pPiece->FileSize, PROT_READ, MAP_SHARED, pPiece->Fd, 0);
+      if (pPiece->pMap == MAP_FAILED)
+      {
+        LOG_WARNING ("Unable to map '%s', falling back to normal reads\n", pPiece->pFilename);
+        pPiece->pMap = NULL;
+      }
+    }
   }
+  praw->PageSize = sysconf (_SC_PAGESIZE);
 
   return RAW_OK;
 }
@@ -226,10 +424,14 @@ static int RawClose(void *p_handle) {
     for (uint64_t i=0; i < praw->Pieces; i++)
     {
       pPiece = &praw->pPieceArr[i];
-      if (pPiece->pFile) {
-        if (fclose (pPiece->pFile)) CloseErrors=1;
+      if (pPiece->pMap) {
+        if (munmap (pPiece->pMap, pPiece->FileSize)) CloseErrors=1;
+      }
+      if (pPiece->Fd >= 0) {
+        if (close (pPiece->Fd)) CloseErrors=1;
       }
       if (pPiece->pFilename) free (pPiece->pFilename);
+      if (pPiece->pExtentArr) free (pPiece->pExtentArr);
     }
     free (praw->pPieceArr);
   }
@@ -260,30 +462,121 @@ static int RawRead(void *p_handle,
                    int *p_errno)
 {
   t_praw p_raw_handle=(t_praw)p_handle;
-  uint32_t remaining=count;
-  uint32_t to_read;
+  uint64_t remaining=count;
+  uint64_t to_read;
 
   if((seek+count)>p_raw_handle->TotalSize) {
     return RAW_READ_BEYOND_END_OF_IMAGE;
   }
 
-  do {
+  while(remaining) {
     to_read=remaining;
-    CHK(RawRead0(p_raw_handle,p_buf,seek,&to_read))
+    CHK(RawRead0(p_raw_handle,p_buf,seek,&to_read,p_errno))
     remaining-=to_read;
     p_buf+=to_read;
     seek+=to_read;
-  } while(remaining);
+  }
 
   *p_read=count;
   return RAW_OK;
 }
 
+/*
+ * RawGetExtents
+ */
+static int RawGetExtents(void *p_handle,
+                         uint64_t offset,
+                         uint64_t count,
+                         pts_LibXmountExtent *pp_extents,
+                         uint64_t *p_extents_count)
+{
+  t_praw p_raw_handle=(t_praw)p_handle;
+  pts_LibXmountExtent p_extents=NULL;
+  uint64_t extents_count=0;
+  pts_LibXmountExtent p_extent;
+  t_pPiece p_piece;
+  uint64_t piece_offset;
+  uint64_t piece_count;
+  uint64_t len;
+  int ret;
+
+  if(offset>=p_raw_handle->TotalSize) count=0;
+  else count=GETMIN(count,p_raw_handle->TotalSize-offset);
+
+  while(count!=0) {
+    p_piece=RawFindPiece(p_raw_handle,offset);
+    piece_offset=offset-p_piece->Offset;
+    piece_count=GETMIN(count,p_piece->FileSize-piece_offset);
+    ret=RawScanPiece(p_raw_handle,p_piece);
+    if(ret!=RAW_OK) {
+      free(p_extents);
+      return ret;
+    }
+
+    if(p_piece->Extents==0) {
+      // Piece has no holes
+      ret=AddExtent(&p_extents,
+                    &extents_count,
+                    offset,
+                    piece_count,
+                    LibXmountExtentType_Data);
+    } else {
+      // Copy the piece's extents overlapping the requested range
+      p_extent=RawFindExtent(p_piece,piece_offset);
+      for(uint64_t i=0;i<piece_count;i+=len) {
+        len=GETMIN(piece_count-i,
+                   p_extent->offset+p_extent->length-(piece_offset+i));
+        ret=AddExtent(&p_extents,
+                      &extents_count,
+                      offset+i,
+                      len,
+                      p_extent->type);
+        if(ret!=0) break;
+        p_extent++;
+      }
+    }
+    if(ret!=0) {
+      free(p_extents);
+      return RAW_MEMALLOC_FAILED;
+    }
+
+    offset+=piece_count;
+    count-=piece_count;
+  }
+
+  *pp_extents=p_extents;
+  *p_extents_count=extents_count;
+  return RAW_OK;
+}
+
+/*
+ * RawIsReentrant
+ */
+static uint8_t RawIsReentrant(void *p_handle) {
+  (void)p_handle;
+  // All reads are done using pread and the piece table isn't modified after
+  // RawOpen
+  return 1;
+}
+
 /*
  * RawOptionsHelp
  */
 static int RawOptionsHelp(const char **pp_help) {
-  *pp_help=NULL;
+  int ok;
+  char *p_buf;
+
+  ok=asprintf(&p_buf,
+              "    " RAW_OPTION_MMAP " : Set to 1 to memory map the raw file(s) "
+                "and serve reads from the mappings. Fastest on local storage, "
+                "but the files must not be truncated while mounted. "
+                "Defaults to 0.\n");
+  if(ok<0 || p_buf==NULL) {
+    *pp_help=NULL;
+    return RAW_MEMALLOC_FAILED;
+  }
+
+  *pp_help=p_buf;
   return RAW_OK;
 }
 
@@ -295,6 +588,32 @@ static int RawOptionsParse(void *p_handle,
                            const pts_LibXmountOptions *pp_options,
                            const char **pp_error)
 {
+  t_praw p_raw_handle=(t_praw)p_handle;
+  int ok;
+  uint32_t uint32value;
+  char *p_buf;
+
+  for(uint32_t i=0;i<options_count;i++) {
+    if(strcmp(pp_options[i]->p_key,RAW_OPTION_MMAP)==0) {
+      uint32value=StrToUint32(pp_options[i]->p_value,&ok);
+      if(ok==0 || uint32value>1) {
+        // Conversion failed, generate error message and return
+        ok=asprintf(&p_buf,
+                    "Unable to parse value '%s' of '%s' as 0 or 1",
+                    pp_options[i]->p_value,
+                    pp_options[i]->p_key);
+        if(ok<0 || p_buf==NULL) {
+          *pp_error=NULL;
+          return RAW_MEMALLOC_FAILED;
+        }
+        *pp_error=p_buf;
+        return RAW_CANNOT_PARSE_OPTION;
+      }
+      p_raw_handle->UseMmap=(uint8_t)uint32value;
+      pp_options[i]->valid=1;
+    }
+  }
+
   return RAW_OK;
 }
 
@@ -341,6 +660,9 @@ static const char* RawGetErrorMessage(int err_num) {
     case RAW_READ_BEYOND_END_OF_IMAGE:
       return "Unable to read raw data: Attempt to read past EOF";
       break;
+    case RAW_CANNOT_PARSE_OPTION:
+      return "Unable to parse library option";
+      break;
     default:
       return "Unknown error";
   }
@@ -32,7 +32,8 @@ enum {
   RAW_CANNOT_READ_DATA,
   RAW_CANNOT_CLOSE_FILE,
   RAW_CANNOT_SEEK,
-  RAW_READ_BEYOND_END_OF_IMAGE
+  RAW_READ_BEYOND_END_OF_IMAGE,
+  RAW_CANNOT_PARSE_OPTION
 };
 
 // ----------------------
@@ -42,20 +43,42 @@ enum {
 #define GETMAX(a,b) ((a)>(b)?(a):(b))
 #define GETMIN(a,b) ((a)<(b)?(a):(b))
 
+#define RAW_OPTION_MMAP "rawmmap"
+
+// Size of the window that is prefetched ahead of sequential reads in mmap mode
+#define RAW_MMAP_READAHEAD (8*1024*1024)
+
 // ---------------------
 //  Types and strutures
 // ---------------------
 
+typedef enum {
+  RAW_ADVICE_NORMAL=0,
+  RAW_ADVICE_SEQUENTIAL,
+  RAW_ADVICE_RANDOM
+} t_RawAdvice;
+
 typedef struct {
   char     *pFilename;
   uint64_t   FileSize;
-  FILE     *pFile;
+  uint64_t   Offset;    // Offset of this piece's first byte in the image
+  int        Fd;
+  char     *pMap;       // Mapping of the whole piece (mmap mode only, NULL otherwise)
+  uint64_t   NextSeek;  // Piece offset following the last read, used to detect sequential access
+  int        Advice;    // Last madvise hint given for pMap (t_RawAdvice)
+
+  pts_LibXmountExtent pExtentArr;  // Hole / data map of a sparse piece (NULL if the piece has no holes)
+  uint64_t            Extents;
+  int                 ExtentsScanned;  // Set once pExtentArr is valid, accessed atomically
 } t_Piece, *t_pPiece;
 
 typedef struct {
   t_pPiece  pPieceArr;
   uint64_t   Pieces;
   uint64_t   TotalSize;
+  uint8_t    UseMmap;   // Option: Serve reads from memory mappings of the pieces
+  uint64_t   PageSize;
+  pthread_mutex_t ExtentMutex;  // Serializes the lazy scanning of the pieces' extents
 } t_raw, *t_praw;
 
 // ----------------
@@ -106,6 +129,12 @@ static int RawRead(void *p_handle,
                    size_t count,
                    size_t *p_read,
                    int *p_errno);
+static int RawGetExtents(void *p_handle,
+                         uint64_t offset,
+                         uint64_t count,
+                         pts_LibXmountExtent *pp_extents,
+                         uint64_t *p_extents_count);
+static uint8_t RawIsReentrant(void *p_handle);
 static int RawOptionsHelp(const char **pp_help);
 static int RawOptionsParse(void *p_handle,
                            uint32_t options_count,
@@ -24,6 +24,7 @@
 #include <stdarg.h>
 #include <time.h>
 #include <unistd.h>
+#include <errno.h>
 
 #include "../libxmount_input.h"
 #include "libxmount_input_vdi.h"
@@ -61,6 +62,8 @@ void LibXmount_Input_GetFunctions(ts_LibXmountInputFunctions *pFunctions) {
     pFunctions->Close = &VdiClose;
     pFunctions->Size = &VdiSize;
     pFunctions->Read = &VdiRead;
+    pFunctions->GetExtents = &VdiGetExtents;
+    pFunctions->IsReentrant = &VdiIsReentrant;
     pFunctions->OptionsHelp = &VdiOptionsHelp;
     pFunctions->OptionsParse = &VdiOptionsParse;
     pFunctions->GetInfofileContent = &VdiGetInfofileContent;
@@ -97,6 +100,26 @@ static int VdiUtilFileRead(t_pVdi pVdi, void* pBuf, size_t Size) {
     return VDI_OK;
 }
 
+/*
+ * VdiUtilPread - Read Size bytes at Offset without touching the stream position
+ */
+static int VdiUtilPread(t_pVdi pVdi, void* pBuf, size_t Size, uint64_t Offset) {
+    char *pDst = (char*)pBuf;
+    ssize_t Read;
+
+    while (Size) {
+        Read = pread(pVdi->Fd, pDst, Size, (off_t)Offset);
+        if (Read < 0 && errno == EINTR) continue;
+        if (Read <= 0) {
+            return VDI_CANNOT_READ_DATA;
+        }
+        pDst += Read;
+        Offset += Read;
+        Size -= Read;
+    }
+    return VDI_OK;
+}
+
 /*
  * VdiUtilMalloc
  */
@@ -209,29 +232,89 @@ int LogEntry(const char *pLogPath, uint8_t LogStdout, const char *pFileName,
     __LINE__, __VA_ARGS__);
 
 /*
- * VdiRawRead0
+ * VdiBuildRuns - Condense the block map into runs of blocks that can be read
+ * with a single pread or that are all zero
  */
-static int VdiRead0(t_pVdi pVdi, char *pBuffer, uint64_t Seek, uint32_t *pCount)
+static int VdiBuildRuns(t_pVdi pVdi) {
+    uint32_t FileBlock;
+    t_pVdiRun pRun = NULL;
+
+    // There can't be more runs than blocks
+    CHK(VdiUtilMalloc((void**)&pVdi->pRuns,
+                      GETMAX(pVdi->Header.BlocksInImage, 1) * sizeof(t_VdiRun)))
+    pVdi->RunCount = 0;
+    for (uint64_t i = 0; i < pVdi->Header.BlocksInImage; i++) {
+        FileBlock = pVdi->Bmap[i];
+        if (FileBlock == VDI_BLOCK_DISCARDED) {
+            FileBlock = VDI_BLOCK_UNALLOCATED;
+        }
+        if (pRun != NULL) {
+            if (FileBlock == VDI_BLOCK_UNALLOCATED && pRun->FileBlock == VDI_BLOCK_UNALLOCATED) {
+                pRun->Blocks++;
+                continue;
+            }
+            if (FileBlock != VDI_BLOCK_UNALLOCATED && pRun->FileBlock != VDI_BLOCK_UNALLOCATED &&
+                (uint64_t)FileBlock == pRun->FileBlock + pRun->Blocks)
+            {
+                pRun->Blocks++;
+                continue;
+            }
+        }
+        pRun = &pVdi->pRuns[pVdi->RunCount++];
+        pRun->FirstBlock = i;
+        pRun->Blocks = 1;
+        pRun->FileBlock = FileBlock;
+    }
+    return VDI_OK;
+}
+
+/*
+ * VdiFindRun - Binary search for the run containing the given virtual block
+ */
+static t_pVdiRun VdiFindRun(t_pVdi pVdi, uint64_t Block) {
+    uint64_t Lo = 0;
+    uint64_t Hi = pVdi->RunCount;
+    uint64_t Mid;
+
+    while (Lo < Hi) {
+        Mid = Lo + (Hi - Lo) / 2;
+        if (Block < pVdi->pRuns[Mid].FirstBlock) {
+            Hi = Mid;
+        } else if (Block >= pVdi->pRuns[Mid].FirstBlock + pVdi->pRuns[Mid].Blocks) {
+            Lo = Mid + 1;
+        } else {
+            return &pVdi->pRuns[Mid];
+        }
+    }
+    return NULL;
+}
+
+/*
+ * VdiRead0 - Read as much as possible of *pCount bytes from the run containing
+ * Seek. *pCount is set to the number of bytes read.
+ */
+static int VdiRead0(t_pVdi pVdi, char *pBuffer, uint64_t Seek, uint64_t *pCount)
 {
-    uint64_t SeekBlock  = Seek / pVdi->Header.BlockSize;
-    uint64_t SeekOffset = Seek % pVdi->Header.BlockSize;
-    if(SeekBlock >= pVdi->Header.BlocksInImage) {
+    uint64_t SeekBlock = Seek / pVdi->Header.BlockSize;
+    t_pVdiRun pRun = VdiFindRun(pVdi, SeekBlock);
+    uint64_t RunOffset;
+
+    if (pRun == NULL) {
         return VDI_BAD_BLOCK_MAP_OFFSET;
     }
-    uint64_t FileBlock = pVdi->Bmap[SeekBlock];
-    *pCount = GETMIN(*pCount, pVdi->Header.BlockSize - SeekOffset);
+    RunOffset = Seek - pRun->FirstBlock * pVdi->Header.BlockSize;
+    *pCount = GETMIN(*pCount, pRun->Blocks * pVdi->Header.BlockSize - RunOffset);
 
-    if (FileBlock == VDI_BLOCK_DISCARDED || FileBlock == VDI_BLOCK_UNALLOCATED) {
+    if (pRun->FileBlock == VDI_BLOCK_UNALLOCATED) {
         memset(pBuffer, 0, *pCount);
         LOG("NULL BLOCK");
         return VDI_OK;
     }
 
     uint64_t FilePosition = pVdi->Header.OffsetData +
-                            (FileBlock * pVdi->Header.BlockSize) + SeekOffset;
+                            ((uint64_t)pRun->FileBlock * pVdi->Header.BlockSize) + RunOffset;
 
-    CHK(VdiUtilFileSeek(pVdi, FilePosition))
-    CHK(VdiUtilFileRead(pVdi, pBuffer, *pCount))
+    CHK(VdiUtilPread(pVdi, pBuffer, *pCount, FilePosition))
 
     return VDI_OK;
 }
@@ -328,6 +411,7 @@ static int VdiOpen(void *pHandle,
         VdiClose(pHandle);
         return VDI_FILE_OPEN_FAILED;
     }
+    pVdi->Fd = fileno(pVdi->pFile);
 
     //Parse Vdi Header
     CHK(VdiParseHeader(pVdi))
@@ -337,6 +421,7 @@ static int VdiOpen(void *pHandle,
     CHK(VdiUtilMalloc((void**) & (pVdi->Bmap), BmapSize))
     CHK(VdiUtilFileSeek(pVdi, pVdi->Header.OffsetBmap))
     CHK(VdiUtilFileRead(pVdi, pVdi->Bmap, BmapSize))
+    CHK(VdiBuildRuns(pVdi))
 
     return VDI_OK;
 }
@@ -346,10 +431,26 @@ static int VdiOpen(void *pHandle,
  */
 static int VdiClose(void *pHandle) {
     t_pVdi pVdi = (t_pVdi)pHandle;
-    if (pVdi != NULL && pVdi->Bmap != NULL) {
+    if (pVdi == NULL) {
+        return VDI_OK;
+    }
+    if (pVdi->Bmap != NULL) {
         free(pVdi->Bmap);
         pVdi->Bmap = NULL;
     }
+    if (pVdi->pRuns != NULL) {
+        free(pVdi->pRuns);
+        pVdi->pRuns = NULL;
+        pVdi->RunCount = 0;
+    }
+    if (pVdi->pFile != NULL) {
+        if (fclose(pVdi->pFile)) return VDI_CANNOT_CLOSE_FILE;
+        pVdi->pFile = NULL;
+    }
+    if (pVdi->pFilename != NULL) {
+        free(pVdi->pFilename);
+        pVdi->pFilename = NULL;
+    }
 
     return VDI_OK;
 }
@@ -374,26 +475,83 @@ static int VdiRead(void *pHandle,
                    int *pErrno)
 {
     t_pVdi pVdi = (t_pVdi)pHandle;
-    uint32_t Remaining = Count;
-    uint32_t ToRead;
+    uint64_t Remaining = Count;
+    uint64_t ToRead;
 
     LOG("Reading %"PRIu64" from offset %"PRIu64, Count, Seek)
     if ((Seek + Count) > pVdi->Header.DiskSize) {
         return VDI_READ_BEYOND_END_OF_IMAGE;
     }
-    do {
+    while (Remaining) {
         ToRead = Remaining;
         CHK(VdiRead0(pVdi, pBuffer, Seek, &ToRead))
         Remaining -= ToRead;
         pBuffer += ToRead;
         Seek += ToRead;
-    } while (Remaining);
+    }
 
     *pRead = Count;
 
     return VDI_OK;
 }
 
+/*
+ * VdiIsReentrant
+ */
+static uint8_t VdiIsReentrant(void *pHandle) {
+    (void)pHandle;
+    // Data is read using pread and the runs aren't modified after VdiOpen
+    return 1;
+}
+
+/*
+ * VdiGetExtents
+ */
+static int VdiGetExtents(void *pHandle,
+                         uint64_t Offset,
+                         uint64_t Count,
+                         pts_LibXmountExtent *ppExtents,
+                         uint64_t *pExtentsCount)
+{
+    t_pVdi pVdi = (t_pVdi)pHandle;
+    t_pVdiRun pRun;
+    uint64_t Length;
+    uint8_t Type;
+
+    *ppExtents = NULL;
+    *pExtentsCount = 0;
+    if ((Offset + Count) > pVdi->Header.DiskSize) {
+        return VDI_READ_BEYOND_END_OF_IMAGE;
+    }
+
+    while (Count) {
+        pRun = VdiFindRun(pVdi, Offset / pVdi->Header.BlockSize);
+        if (pRun == NULL) {
+            free(*ppExtents);
+            *ppExtents = NULL;
+            *pExtentsCount = 0;
+            return VDI_BAD_BLOCK_MAP_OFFSET;
+        }
+        if (pRun->FileBlock == VDI_BLOCK_UNALLOCATED) {
+            Type = LibXmountExtentType_Zero;
+        } else {
+            Type = LibXmountExtentType_Data;
+        }
+        Length = GETMIN(Count, (pRun->FirstBlock + pRun->Blocks) * pVdi->Header.BlockSize - Offset);
+
+        if (AddExtent(ppExtents, pExtentsCount, Offset, Length, Type) != 0) {
+            free(*ppExtents);
+            *ppExtents = NULL;
+            *pExtentsCount = 0;
+            return VDI_MEMALLOC_FAILED;
+        }
+        Offset += Length;
+        Count -= Length;
+    }
+
+    return VDI_OK;
+}
+
 /*
  * VdiOptionsHelp
  */
@@ -468,10 +626,16 @@ static int VdiGetInfofileContent(void *pHandle, const char **ppInfoBuffer) {
     char *pInfoBuf;
 
     ret = asprintf(&pInfoBuf,
-                   "VDI image assembled of %" PRIu64 " bytes in total(%0.3f GiB)\n",
-                   pVdi->FileSize,
-                   pVdi->FileSize / (1024.0 * 1024.0 * 1024.0));
-    if (ret < 0 || *ppInfoBuffer == NULL) return VDI_MEMALLOC_FAILED;
+                   "VDI image assembled of %" PRIu64 " bytes in total(%0.3f GiB)\n"
+                   "Block size %" PRIu32 ", %" PRIu32 " of %" PRIu32 " blocks allocated, "
+                   "%" PRIu64 " contiguous runs\n",
+                   pVdi->Header.DiskSize,
+                   pVdi->Header.DiskSize / (1024.0 * 1024.0 * 1024.0),
+                   pVdi->Header.BlockSize,
+                   pVdi->Header.BlocksAllocated,
+                   pVdi->Header.BlocksInImage,
+                   pVdi->RunCount);
+    if (ret < 0 || pInfoBuf == NULL) return VDI_MEMALLOC_FAILED;
 
     *ppInfoBuffer = pInfoBuf;
     return VDI_OK;
@@ -99,12 +99,23 @@ typedef struct {
    char UUIDParent[16];
 } t_VdiHeader, *t_pVdiHeader;
 
+// A run of consecutive virtual blocks stored in consecutive file blocks, or a
+// run of unallocated / discarded blocks (FileBlock == VDI_BLOCK_UNALLOCATED)
+typedef struct {
+   uint64_t FirstBlock;
+   uint64_t Blocks;
+   uint32_t FileBlock;
+} t_VdiRun, *t_pVdiRun;
+
 typedef struct {
    char *pFilename;
    FILE *pFile;
+   int Fd; // File descriptor of pFile, data is read with pread
    uint64_t FileSize;
    t_VdiHeader Header;
    uint32_t *Bmap; //Contains Block Map
+   t_pVdiRun pRuns; //Block Map condensed into runs, sorted by FirstBlock
+   uint64_t RunCount;
    char* pLogPath;
    uint8_t LogStdout;
    uint64_t CachedBlockIndex;
@@ -162,6 +173,12 @@ static int VdiRead(void *pHandle,
                    size_t Count,
                    size_t *pRead,
                    int *pErrno);
+static uint8_t VdiIsReentrant(void *pHandle);
+static int VdiGetExtents(void *pHandle,
+                         uint64_t Offset,
+                         uint64_t Count,
+                         pts_LibXmountExtent *ppExtents,
+                         uint64_t *pExtentsCount);
 static int VdiOptionsHelp(const char **ppHelp);
 static int VdiOptionsParse(void *pHandle,
                            uint32_t OptionsCount,
@@ -68,6 +68,26 @@ typedef struct s_LibXmountMorphingInputFunctions {
               off_t offset,
               size_t count,
               size_t *p_read);
+
+  //! Function to get the allocation map of a range of an input image
+  /*!
+   * Describes the range of count bytes starting at offset as a sorted,
+   * gap-free array of extents. If the input lib can't tell, a single data
+   * extent covering the whole range is returned. The returned array must be
+   * freed using free().
+   *
+   * \param image Image number
+   * \param offset Position of the range to describe
+   * \param count Length of the range to describe
+   * \param pp_extents Pointer to store extent array to
+   * \param p_extents_count Pointer to store amount of extents to
+   * \return 0 on success or negated error code on error
+   */
+  int (*GetExtents)(uint64_t image,
+                    uint64_t offset,
+                    uint64_t count,
+                    pts_LibXmountExtent *pp_extents,
+                    uint64_t *p_extents_count);
 } ts_LibXmountMorphingInputFunctions, *pts_LibXmountMorphingInputFunctions;
 
 //! Structure containing pointers to the lib's functions
@@ -207,6 +227,63 @@ typedef struct s_LibXmountMorphingFunctions {
    * \param p_buf Buffer to free
    */
   void (*FreeBuffer)(void *p_buf);
+
+  //! Function to get the allocation map of a range of the morphed image
+  /*!
+   * Describes the range of count bytes starting at offset as a sorted,
+   * gap-free array of extents. Extents of type LibXmountExtentType_Zero are
+   * known to read as zeroes and can be skipped by the caller without calling
+   * Read(). The returned array will be freed by the caller using FreeBuffer().
+   *
+   * This function is optional and may be set to NULL. In this case, the whole
+   * morphed image is considered to contain data.
+   *
+   * \param p_handle Handle to the opened image
+   * \param offset Position of the range to describe
+   * \param count Length of the range to describe
+   * \param pp_extents Pointer to store extent array to
+   * \param p_extents_count Pointer to store amount of extents to
+   * \return 0 on success or error code
+   */
+  int (*GetExtents)(void *p_handle,
+                    uint64_t offset,
+                    uint64_t count,
+                    pts_LibXmountExtent *pp_extents,
+                    uint64_t *p_extents_count);
+
+  //! Function to get statistics counters
+  /*!
+   * Returns an array of named counters. Unlike GetInfofileContent, this
+   * function may be called at any time after Morph. The returned array will be
+   * freed by the caller using FreeBuffer(). The counter names are not freed and
+   * must stay valid as long as the handle.
+   *
+   * This function is optional and may be set to NULL if the lib doesn't keep
+   * any statistics.
+   *
+   * \param p_handle Handle to the opened image
+   * \param pp_stats Pointer to store counter array to
+   * \param p_stats_count Pointer to store amount of counters to
+   * \return 0 on success or error code
+   */
+  int (*GetStats)(void *p_handle,
+                  pts_LibXmountStat *pp_stats,
+                  uint32_t *p_stats_count);
+
+  //! Function to check whether Read may be called concurrently
+  /*!
+   * If this function returns 1, xmount may call Read, GetExtents and GetStats
+   * on the same opened handle from multiple threads at the same time. The
+   * input image functions will only be called concurrently if all input images
+   * allow it, so a lib only has to protect its own state.
+   *
+   * This function is optional and may be set to NULL, in which case all calls
+   * are serialized.
+   *
+   * \param p_handle Handle to the opened image
+   * \return 1 if Read is reentrant, 0 otherwise
+   */
+  uint8_t (*IsReentrant)(void *p_handle);
 } ts_LibXmountMorphingFunctions, *pts_LibXmountMorphingFunctions;
 
 /*******************************************************************************
@@ -240,7 +317,7 @@ typedef const char* (*t_LibXmount_Morphing_GetSupportedTypes)();
 /*!
  * This function should set the members of the given
  * s_LibXmountMorphingFunctions structure to the internal lib functions. All
- * members have to be set.
+ * members except GetExtents, IsReentrant and GetStats have to be set.
  *
  * \param p_functions s_LibXmountMorphingFunctions structure to fill
  */
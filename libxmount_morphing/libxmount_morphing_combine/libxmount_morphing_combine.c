@@ -56,6 +56,8 @@ void LibXmount_Morphing_GetFunctions(ts_LibXmountMorphingFunctions *p_functions)
   p_functions->Morph=&CombineMorph;
   p_functions->Size=&CombineSize;
   p_functions->Read=&CombineRead;
+  p_functions->GetExtents=&CombineGetExtents;
+  p_functions->IsReentrant=&CombineIsReentrant;
   p_functions->OptionsHelp=&CombineOptionsHelp;
   p_functions->OptionsParse=&CombineOptionsParse;
   p_functions->GetInfofileContent=&CombineGetInfofileContent;
@@ -237,6 +239,117 @@ static int CombineRead(void *p_handle,
   return COMBINE_OK;
 }
 
+/*
+ * CombineGetExtents
+ */
+static int CombineGetExtents(void *p_handle,
+                             uint64_t offset,
+                             uint64_t count,
+                             pts_LibXmountExtent *pp_extents,
+                             uint64_t *p_extents_count)
+{
+  pts_CombineHandle p_combine_handle=(pts_CombineHandle)p_handle;
+  uint64_t cur_input_image=0;
+  uint64_t cur_input_image_size=0;
+  uint64_t cur_input_image_start=0;
+  uint64_t cur_offset=offset;
+  uint64_t cur_count;
+  pts_LibXmountExtent p_input_extents;
+  uint64_t input_extents_count;
+  int ret;
+
+  LOG_DEBUG("Getting extents of %" PRIu64 " bytes at offset %" PRIu64
+              " from morphed image\n",
+            count,
+            offset);
+
+  *pp_extents=NULL;
+  *p_extents_count=0;
+
+  // Make sure parameters are within morphed image bounds
+  if(offset>=p_combine_handle->morphed_image_size ||
+     offset+count>p_combine_handle->morphed_image_size)
+  {
+    return COMBINE_READ_BEYOND_END_OF_IMAGE;
+  }
+
+  // Search starting image
+  ret=p_combine_handle->p_input_functions->Size(cur_input_image,
+                                                &cur_input_image_size);
+  while(ret==0 && cur_offset>=cur_input_image_size) {
+    cur_offset-=cur_input_image_size;
+    cur_input_image_start+=cur_input_image_size;
+    cur_input_image++;
+    ret=p_combine_handle->p_input_functions->Size(cur_input_image,
+                                                  &cur_input_image_size);
+  }
+  if(ret!=0) return COMBINE_CANNOT_GET_IMAGESIZE;
+
+  // Collect extents of all touched input images
+  while(cur_input_image<p_combine_handle->input_images_count && count!=0) {
+    ret=p_combine_handle->p_input_functions->Size(cur_input_image,
+                                                  &cur_input_image_size);
+    if(ret!=0) {
+      ret=COMBINE_CANNOT_GET_IMAGESIZE;
+      break;
+    }
+
+    if(cur_offset+count>cur_input_image_size) {
+      cur_count=cur_input_image_size-cur_offset;
+    } else {
+      cur_count=count;
+    }
+
+    ret=p_combine_handle->p_input_functions->
+          GetExtents(cur_input_image,
+                     cur_offset,
+                     cur_count,
+                     &p_input_extents,
+                     &input_extents_count);
+    if(ret!=0) {
+      ret=COMBINE_CANNOT_GET_EXTENTS;
+      break;
+    }
+    for(uint64_t i=0;i<input_extents_count;i++) {
+      ret=AddExtent(pp_extents,
+                    p_extents_count,
+                    cur_input_image_start+p_input_extents[i].offset,
+                    p_input_extents[i].length,
+                    p_input_extents[i].type);
+      if(ret!=0) {
+        ret=COMBINE_MEMALLOC_FAILED;
+        break;
+      }
+    }
+    free(p_input_extents);
+    if(ret!=0) break;
+
+    cur_input_image_start+=cur_input_image_size;
+    cur_offset=0;
+    count-=cur_count;
+    cur_input_image++;
+  }
+  if(ret==0 && count!=0) ret=COMBINE_CANNOT_GET_EXTENTS;
+
+  if(ret!=0) {
+    free(*pp_extents);
+    *pp_extents=NULL;
+    *p_extents_count=0;
+    return ret;
+  }
+
+  return COMBINE_OK;
+}
+
+/*
+ * CombineIsReentrant
+ */
+static uint8_t CombineIsReentrant(void *p_handle) {
+  (void)p_handle;
+  // Read only uses data that isn't modified after Morph was called
+  return 1;
+}
+
 /*
  * CombineOptionsHelp
  */
@@ -286,6 +399,9 @@ static const char* CombineGetErrorMessage(int err_num) {
     case COMBINE_CANNOT_READ_DATA:
       return "Unable to read data";
       break;
+    case COMBINE_CANNOT_GET_EXTENTS:
+      return "Unable to get allocation map of input image";
+      break;
     default:
       return "Unknown error";
   }
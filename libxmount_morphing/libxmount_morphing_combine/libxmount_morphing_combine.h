@@ -30,7 +30,8 @@ enum {
   COMBINE_CANNOT_GET_IMAGECOUNT,
   COMBINE_CANNOT_GET_IMAGESIZE,
   COMBINE_READ_BEYOND_END_OF_IMAGE,
-  COMBINE_CANNOT_READ_DATA
+  COMBINE_CANNOT_READ_DATA,
+  COMBINE_CANNOT_GET_EXTENTS
 };
 
 typedef struct s_CombineHandle {
@@ -56,6 +57,12 @@ static int CombineRead(void *p_handle,
                        off_t offset,
                        size_t count,
                        size_t *p_read);
+static int CombineGetExtents(void *p_handle,
+                             uint64_t offset,
+                             uint64_t count,
+                             pts_LibXmountExtent *pp_extents,
+                             uint64_t *p_extents_count);
+static uint8_t CombineIsReentrant(void *p_handle);
 static int CombineOptionsHelp(const char **pp_help);
 static int CombineOptionsParse(void *p_handle,
                                uint32_t options_count,
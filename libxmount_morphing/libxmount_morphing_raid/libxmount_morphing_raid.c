@@ -56,6 +56,7 @@ void LibXmount_Morphing_GetFunctions(ts_LibXmountMorphingFunctions *p_functions)
   p_functions->Morph=&RaidMorph;
   p_functions->Size=&RaidSize;
   p_functions->Read=&RaidRead;
+  p_functions->IsReentrant=&RaidIsReentrant;
   p_functions->OptionsHelp=&RaidOptionsHelp;
   p_functions->OptionsParse=&RaidOptionsParse;
   p_functions->GetInfofileContent=&RaidGetInfofileContent;
@@ -252,6 +253,15 @@ static int RaidRead(void *p_handle,
   return RAID_OK;
 }
 
+/*
+ * RaidIsReentrant
+ */
+static uint8_t RaidIsReentrant(void *p_handle) {
+  (void)p_handle;
+  // Read only uses data that isn't modified after Morph was called
+  return 1;
+}
+
 /*
  * RaidOptionsHelp
  */
@@ -60,6 +60,7 @@ static int RaidRead(void *p_handle,
                     off_t offset,
                     size_t count,
                     size_t *p_read);
+static uint8_t RaidIsReentrant(void *p_handle);
 static int RaidOptionsHelp(const char **pp_help);
 static int RaidOptionsParse(void *p_handle,
                             uint32_t options_count,
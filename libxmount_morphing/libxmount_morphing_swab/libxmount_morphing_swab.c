@@ -57,6 +57,7 @@ void LibXmount_Morphing_GetFunctions(ts_LibXmountMorphingFunctions *p_functions)
   p_functions->Morph=&SwabMorph;
   p_functions->Size=&SwabSize;
   p_functions->Read=&SwabRead;
+  p_functions->IsReentrant=&SwabIsReentrant;
   p_functions->OptionsHelp=&SwabOptionsHelp;
   p_functions->OptionsParse=&SwabOptionsParse;
   p_functions->GetInfofileContent=&SwabGetInfofileContent;
@@ -219,6 +220,15 @@ static int SwabRead(void *p_handle,
   return SWAB_OK;
 }
 
+/*
+ * SwabIsReentrant
+ */
+static uint8_t SwabIsReentrant(void *p_handle) {
+  (void)p_handle;
+  // Read only uses data that isn't modified after Morph was called
+  return 1;
+}
+
 /*
  * SwabOptionsHelp
  */
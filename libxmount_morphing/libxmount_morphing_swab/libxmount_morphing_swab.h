@@ -57,6 +57,7 @@ static int SwabRead(void *p_handle,
                        off_t offset,
                        size_t count,
                        size_t *p_read);
+static uint8_t SwabIsReentrant(void *p_handle);
 static int SwabOptionsHelp(const char **pp_help);
 static int SwabOptionsParse(void *p_handle,
                                uint32_t options_count,
@@ -56,6 +56,8 @@ void LibXmount_Morphing_GetFunctions(ts_LibXmountMorphingFunctions *p_functions)
   p_functions->Morph=&UnallocatedMorph;
   p_functions->Size=&UnallocatedSize;
   p_functions->Read=&UnallocatedRead;
+  p_functions->GetExtents=&UnallocatedGetExtents;
+  p_functions->IsReentrant=&UnallocatedIsReentrant;
   p_functions->OptionsHelp=&UnallocatedOptionsHelp;
   p_functions->OptionsParse=&UnallocatedOptionsParse;
   p_functions->GetInfofileContent=&UnallocatedGetInfofileContent;
@@ -300,14 +302,14 @@ static int UnallocatedRead(void *p_handle,
 
     LOG_DEBUG("Reading %zu bytes at offset %zu (block %" PRIu64 ")\n",
               cur_count,
-              cur_image_offset+cur_block_offset,
+              cur_image_offset,
               cur_block);
 
     // Read bytes
     ret=p_unallocated_handle->p_input_functions->
           Read(0,
                p_buf,
-               cur_image_offset+cur_block_offset,
+               cur_image_offset,
                cur_count,
                &bytes_read);
     if(ret!=0 || bytes_read!=cur_count) return UNALLOCATED_CANNOT_READ_DATA;
@@ -322,6 +324,113 @@ static int UnallocatedRead(void *p_handle,
   return UNALLOCATED_OK;
 }
 
+/*
+ * UnallocatedGetExtents
+ */
+static int UnallocatedGetExtents(void *p_handle,
+                                 uint64_t offset,
+                                 uint64_t count,
+                                 pts_LibXmountExtent *pp_extents,
+                                 uint64_t *p_extents_count)
+{
+  pts_UnallocatedHandle p_unallocated_handle=(pts_UnallocatedHandle)p_handle;
+  uint64_t block_size=p_unallocated_handle->block_size;
+  uint64_t cur_block;
+  uint64_t cur_block_offset;
+  uint64_t cur_image_offset;
+  uint64_t cur_count;
+  pts_LibXmountExtent p_input_extents;
+  uint64_t input_extents_count;
+  int ret=UNALLOCATED_OK;
+
+  LOG_DEBUG("Getting extents of %" PRIu64 " bytes at offset %" PRIu64
+              " from morphed image\n",
+            count,
+            offset);
+
+  *pp_extents=NULL;
+  *p_extents_count=0;
+
+  // Make sure parameters are within morphed image bounds
+  if(offset>=p_unallocated_handle->morphed_image_size ||
+     offset+count>p_unallocated_handle->morphed_image_size)
+  {
+    return UNALLOCATED_READ_BEYOND_END_OF_IMAGE;
+  }
+
+  // Calculate starting block and block offset
+  cur_block=offset/block_size;
+  cur_block_offset=offset-(cur_block*block_size);
+
+  while(count!=0) {
+    // Calculate input image offset and how many bytes are in this block
+    cur_image_offset=
+      p_unallocated_handle->p_free_block_map[cur_block]+cur_block_offset;
+    if(cur_block_offset+count>block_size) {
+      cur_count=block_size-cur_block_offset;
+    } else {
+      cur_count=count;
+    }
+
+    // Free blocks that are also consecutive in the input image can be looked
+    // up at once
+    while(cur_count<count &&
+          p_unallocated_handle->p_free_block_map[cur_block+1]==
+            p_unallocated_handle->p_free_block_map[cur_block]+block_size)
+    {
+      cur_block++;
+      if(cur_count+block_size>count) cur_count=count;
+      else cur_count+=block_size;
+    }
+
+    // Get extents from input image and map them back into morphed image
+    ret=p_unallocated_handle->p_input_functions->
+          GetExtents(0,
+                     cur_image_offset,
+                     cur_count,
+                     &p_input_extents,
+                     &input_extents_count);
+    if(ret!=0) {
+      ret=UNALLOCATED_CANNOT_GET_EXTENTS;
+      break;
+    }
+    for(uint64_t i=0;i<input_extents_count;i++) {
+      ret=AddExtent(pp_extents,
+                    p_extents_count,
+                    offset+(p_input_extents[i].offset-cur_image_offset),
+                    p_input_extents[i].length,
+                    p_input_extents[i].type);
+      if(ret!=0) {
+        ret=UNALLOCATED_MEMALLOC_FAILED;
+        break;
+      }
+    }
+    free(p_input_extents);
+    if(ret!=0) break;
+
+    offset+=cur_count;
+    count-=cur_count;
+    cur_block_offset=0;
+    cur_block++;
+  }
+
+  if(ret!=UNALLOCATED_OK) {
+    free(*pp_extents);
+    *pp_extents=NULL;
+    *p_extents_count=0;
+  }
+  return ret;
+}
+
+/*
+ * UnallocatedIsReentrant
+ */
+static uint8_t UnallocatedIsReentrant(void *p_handle) {
+  (void)p_handle;
+  // Read only uses data that isn't modified after Morph was called
+  return 1;
+}
+
 /*
  * UnallocatedOptionsHelp
  */
@@ -500,6 +609,10 @@ static const char* UnallocatedGetErrorMessage(int err_num) {
     case UNALLOCATED_FAT_CANNOT_READ_FAT:
       return "Unable to read FAT";
       break;
+    // Allocation map errors
+    case UNALLOCATED_CANNOT_GET_EXTENTS:
+      return "Unable to get allocation map of input image";
+      break;
     default:
       return "Unknown error";
   }
@@ -72,6 +72,12 @@ static int UnallocatedRead(void *p_handle,
                          off_t offset,
                          size_t count,
                          size_t *p_read);
+static int UnallocatedGetExtents(void *p_handle,
+                                 uint64_t offset,
+                                 uint64_t count,
+                                 pts_LibXmountExtent *pp_extents,
+                                 uint64_t *p_extents_count);
+static uint8_t UnallocatedIsReentrant(void *p_handle);
 static int UnallocatedOptionsHelp(const char **pp_help);
 static int UnallocatedOptionsParse(void *p_handle,
                                  uint32_t options_count,
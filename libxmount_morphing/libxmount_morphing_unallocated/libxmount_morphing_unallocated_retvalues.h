@@ -43,7 +43,9 @@ enum {
   UNALLOCATED_FAT_CANNOT_READ_HEADER,
   UNALLOCATED_FAT_INVALID_HEADER,
   UNALLOCATED_FAT_UNSUPPORTED_FS_TYPE,
-  UNALLOCATED_FAT_CANNOT_READ_FAT
+  UNALLOCATED_FAT_CANNOT_READ_FAT,
+  // Allocation map return values
+  UNALLOCATED_CANNOT_GET_EXTENTS
 };
 
 #endif // LIBXMOUNT_MORPHING_UNALLOCATED_RETVALUES_H
@@ -68,5 +68,10 @@
   strncpy((var1)+strlen(var1),var2,size); \
 }
 
+/*
+ * Macro to update counters that might be modified by concurrent reads
+ */
+#define XMOUNT_COUNTER_ADD(var,val) __sync_fetch_and_add(&(var),(val))
+
 #endif // MACROS_H
 
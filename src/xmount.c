@@ -49,6 +49,11 @@
 #endif
 #include <fuse.h>
 
+// FUSE's lseek operation (needed for SEEK_DATA / SEEK_HOLE) exists since 3.8
+#if defined(HAVE_FUSE3) && FUSE_VERSION>=FUSE_MAKE_VERSION(3,8)
+  #define HAVE_FUSE_LSEEK
+#endif
+
 #include "xmount.h"
 #include "md5.h"
 #include "macros.h"
@@ -86,6 +91,18 @@ static int GetVirtImageSize(uint64_t*);
 static int GetInputImageData(pts_InputImage, char*, off_t, size_t, size_t*);
 static int GetMorphedImageData(char*, off_t, size_t, size_t*);
 static int GetVirtImageData(char*, off_t, size_t);
+static int GetInputImageExtents(pts_InputImage,
+                                uint64_t,
+                                uint64_t,
+                                pts_LibXmountExtent*,
+                                uint64_t*);
+static int GetMorphedImageExtents(uint64_t,
+                                  uint64_t,
+                                  pts_LibXmountExtent*,
+                                  uint64_t*);
+static int GetVirtImageExtents(uint64_t,
+                               pts_LibXmountExtent*,
+                               uint64_t*);
 static int SetVdiFileHeaderData(char*, off_t, size_t);
 static int SetVhdFileHeaderData(char*, off_t, size_t);
 static int SetVirtImageData(const char*, off_t, size_t);
@@ -94,6 +111,8 @@ static int InitVirtVdiHeader();
 static int InitVirtVhdHeader();
 static int InitVirtualVmdkFile();
 static int InitVirtImageInfoFile();
+static void AppendVirtImageStatsLine(const char*, uint64_t);
+static int UpdateVirtImageStatsFile();
 static int InitCacheFile();
 static int LoadLibs();
 static int FindInputLib(pts_InputImage);
@@ -105,6 +124,11 @@ static int SplitLibraryParameters(char*, uint32_t*, pts_LibXmountOptions**);
 static int LibXmount_Morphing_ImageCount(uint64_t*);
 static int LibXmount_Morphing_Size(uint64_t, uint64_t*);
 static int LibXmount_Morphing_Read(uint64_t, char*, off_t, size_t, size_t*);
+static int LibXmount_Morphing_GetExtents(uint64_t,
+                                         uint64_t,
+                                         uint64_t,
+                                         pts_LibXmountExtent*,
+                                         uint64_t*);
 // Functions implementing FUSE functions
 #ifdef HAVE_FUSE3
   static int FuseGetAttr(const char*, struct stat*, struct fuse_file_info*);
@@ -128,6 +152,9 @@ static int FuseMkDir(const char*, mode_t);
 static int FuseMkNod(const char*, mode_t, dev_t);
 static int FuseOpen(const char*, struct fuse_file_info*);
 static int FuseRead(const char*, char*, size_t, off_t, struct fuse_file_info*);
+#ifdef HAVE_FUSE_LSEEK
+  static off_t FuseLseek(const char*, off_t, int, struct fuse_file_info*);
+#endif
 static int FuseRmDir(const char*);
 static int FuseUnlink(const char*);
 //static int FuseStatFs(const char*, struct statvfs*);
@@ -496,6 +523,8 @@ static int ParseCmdLine(const int argc, char **pp_argv) {
           p_input_image->pp_files=NULL;
           p_input_image->p_functions=NULL;
           p_input_image->p_handle=NULL;
+          p_input_image->stats.reads=0;
+          p_input_image->stats.bytes_read=0;
           // Parse input image filename(s) and add to p_input_image->pp_files
           i++;
           p_input_image->files_count=0;
@@ -835,6 +864,7 @@ static int ExtractVirtFileNames(char *p_orig_name) {
   // Set leading '/'
   XMOUNT_STRSET(glob_xmount.output.p_virtual_image_path,"/");
   XMOUNT_STRSET(glob_xmount.output.p_info_path,"/");
+  XMOUNT_STRSET(glob_xmount.output.p_stats_path,"/");
   if(glob_xmount.output.VirtImageType==VirtImageType_VMDK ||
      glob_xmount.output.VirtImageType==VirtImageType_VMDKS)
   {
@@ -851,7 +881,9 @@ static int ExtractVirtFileNames(char *p_orig_name) {
     {
       XMOUNT_STRAPP(glob_xmount.output.vmdk.p_virtual_vmdk_path,p_orig_name);
     }
+    XMOUNT_STRAPP(glob_xmount.output.p_stats_path,p_orig_name);
     XMOUNT_STRAPP(glob_xmount.output.p_info_path,".info");
+    XMOUNT_STRAPP(glob_xmount.output.p_stats_path,".stats");
   } else {
     XMOUNT_STRNAPP(glob_xmount.output.p_virtual_image_path,p_orig_name,
                    strlen(p_orig_name)-strlen(tmp));
@@ -863,7 +895,10 @@ static int ExtractVirtFileNames(char *p_orig_name) {
       XMOUNT_STRNAPP(glob_xmount.output.vmdk.p_virtual_vmdk_path,p_orig_name,
                      strlen(p_orig_name)-strlen(tmp));
     }
+    XMOUNT_STRNAPP(glob_xmount.output.p_stats_path,p_orig_name,
+                   strlen(p_orig_name)-strlen(tmp));
     XMOUNT_STRAPP(glob_xmount.output.p_info_path,".info");
+    XMOUNT_STRAPP(glob_xmount.output.p_stats_path,".stats");
   }
 
   // Add virtual file extensions
@@ -894,6 +929,8 @@ static int ExtractVirtFileNames(char *p_orig_name) {
             glob_xmount.output.p_virtual_image_path);
   LOG_DEBUG("Set virtual image info name to \"%s\"\n",
             glob_xmount.output.p_info_path);
+  LOG_DEBUG("Set virtual image stats name to \"%s\"\n",
+            glob_xmount.output.p_stats_path);
   if(glob_xmount.output.VirtImageType==VirtImageType_VMDK ||
      glob_xmount.output.VirtImageType==VirtImageType_VMDKS)
   {
@@ -1034,6 +1071,8 @@ static int GetInputImageData(pts_InputImage p_image,
     else return (read_errno*(-1));
   }
 
+  XMOUNT_COUNTER_ADD(p_image->stats.reads,1);
+  XMOUNT_COUNTER_ADD(p_image->stats.bytes_read,*p_read);
   return 0;
 }
 
@@ -1089,6 +1128,8 @@ static int GetMorphedImageData(char *p_buf,
     return -EIO;
   }
 
+  XMOUNT_COUNTER_ADD(glob_xmount.morphing.stats.reads,1);
+  XMOUNT_COUNTER_ADD(glob_xmount.morphing.stats.bytes_read,to_read);
   *p_read=to_read;
   return TRUE;
 }
@@ -1229,6 +1270,8 @@ static int GetVirtImageData(char *p_buf, off_t offset, size_t size) {
         LOG_ERROR("Couldn't read data from cache file!\n")
         return -EIO;
       }
+      glob_xmount.output.cache_stats.reads++;
+      glob_xmount.output.cache_stats.bytes_read+=cur_to_read;
       LOG_DEBUG("Read %zd bytes at offset %" PRIu64
                 " from cache file\n",cur_to_read,file_off)
     } else {
@@ -1304,9 +1347,295 @@ static int GetVirtImageData(char *p_buf, off_t offset, size_t size) {
     }
   }
 
+  XMOUNT_COUNTER_ADD(glob_xmount.output.stats.reads,1);
+  XMOUNT_COUNTER_ADD(glob_xmount.output.stats.bytes_read,size);
   return size;
 }
 
+//! Get allocation map of input image
+/*!
+ * If the input lib doesn't implement GetExtents, the whole range is reported
+ * as data. The returned array must be freed using free().
+ *
+ * \param p_image Image from which to get extents
+ * \param offset Offset of range to describe
+ * \param size Length of range to describe
+ * \param pp_extents Pointer to store extent array to
+ * \param p_extents_count Pointer to store amount of extents to
+ * \return 0 on success, negated error code on error
+ */
+static int GetInputImageExtents(pts_InputImage p_image,
+                                uint64_t offset,
+                                uint64_t size,
+                                pts_LibXmountExtent *pp_extents,
+                                uint64_t *p_extents_count)
+{
+  pts_LibXmountExtent p_lib_extents=NULL;
+  uint64_t lib_extents_count=0;
+  int ret;
+
+  *pp_extents=NULL;
+  *p_extents_count=0;
+
+  // Make sure we aren't describing data past EOF of image file
+  if(offset>=p_image->size) return 0;
+  if(offset+size>p_image->size) size=p_image->size-offset;
+
+  if(p_image->p_functions->GetExtents==NULL) {
+    // Lib can't tell what is allocated, so everything is data
+    if(AddExtent(pp_extents,
+                 p_extents_count,
+                 offset,
+                 size,
+                 LibXmountExtentType_Data)!=0)
+    {
+      return -ENOMEM;
+    }
+    return 0;
+  }
+
+  // Get extents from input lib (adding input image offset if one was
+  // specified)
+  ret=p_image->p_functions->GetExtents(p_image->p_handle,
+                                       offset+glob_xmount.input.image_offset,
+                                       size,
+                                       &p_lib_extents,
+                                       &lib_extents_count);
+  if(ret!=0) {
+    LOG_ERROR("Couldn't get extents of %" PRIu64 " bytes at offset %" PRIu64
+                " from input image '%s': %s!\n",
+              size,
+              offset,
+              p_image->pp_files[0],
+              p_image->p_functions->GetErrorMessage(ret));
+    return -EIO;
+  }
+
+  // Copy extents, removing input image offset again
+  for(uint64_t i=0;i<lib_extents_count;i++) {
+    if(AddExtent(pp_extents,
+                 p_extents_count,
+                 p_lib_extents[i].offset-glob_xmount.input.image_offset,
+                 p_lib_extents[i].length,
+                 p_lib_extents[i].type)!=0)
+    {
+      p_image->p_functions->FreeBuffer(p_lib_extents);
+      free(*pp_extents);
+      *pp_extents=NULL;
+      *p_extents_count=0;
+      return -ENOMEM;
+    }
+  }
+  p_image->p_functions->FreeBuffer(p_lib_extents);
+
+  return 0;
+}
+
+//! Get allocation map of morphed image
+/*!
+ * If the morphing lib doesn't implement GetExtents, the whole range is
+ * reported as data. The returned array must be freed using free().
+ *
+ * \param offset Offset of range to describe
+ * \param size Length of range to describe
+ * \param pp_extents Pointer to store extent array to
+ * \param p_extents_count Pointer to store amount of extents to
+ * \return 0 on success, negated error code on error
+ */
+static int GetMorphedImageExtents(uint64_t offset,
+                                  uint64_t size,
+                                  pts_LibXmountExtent *pp_extents,
+                                  uint64_t *p_extents_count)
+{
+  pts_LibXmountExtent p_lib_extents=NULL;
+  uint64_t lib_extents_count=0;
+  uint64_t image_size=0;
+  int ret;
+
+  *pp_extents=NULL;
+  *p_extents_count=0;
+
+  // Make sure we aren't describing data past EOF of image file
+  if(GetMorphedImageSize(&image_size)!=TRUE) {
+    LOG_ERROR("Couldn't get size of morphed image!\n");
+    return -EIO;
+  }
+  if(offset>=image_size) return 0;
+  if(offset+size>image_size) size=image_size-offset;
+
+  if(glob_xmount.morphing.p_functions->GetExtents==NULL) {
+    // Lib can't tell what is allocated, so everything is data
+    if(AddExtent(pp_extents,
+                 p_extents_count,
+                 offset,
+                 size,
+                 LibXmountExtentType_Data)!=0)
+    {
+      return -ENOMEM;
+    }
+    return 0;
+  }
+
+  // Get extents from morphing lib
+  ret=glob_xmount.morphing.p_functions->
+        GetExtents(glob_xmount.morphing.p_handle,
+                   offset,
+                   size,
+                   &p_lib_extents,
+                   &lib_extents_count);
+  if(ret!=0) {
+    LOG_ERROR("Couldn't get extents of %" PRIu64 " bytes at offset %" PRIu64
+                " from morphed image: %s!\n",
+              size,
+              offset,
+              glob_xmount.morphing.p_functions->GetErrorMessage(ret));
+    return -EIO;
+  }
+
+  // Copy extents
+  for(uint64_t i=0;i<lib_extents_count;i++) {
+    if(AddExtent(pp_extents,
+                 p_extents_count,
+                 p_lib_extents[i].offset,
+                 p_lib_extents[i].length,
+                 p_lib_extents[i].type)!=0)
+    {
+      glob_xmount.morphing.p_functions->FreeBuffer(p_lib_extents);
+      free(*pp_extents);
+      *pp_extents=NULL;
+      *p_extents_count=0;
+      return -ENOMEM;
+    }
+  }
+  glob_xmount.morphing.p_functions->FreeBuffer(p_lib_extents);
+
+  return 0;
+}
+
+//! Get the allocation map of the virtual image starting at the given offset
+/*!
+ * Describes a range of the virtual image starting at offset as a sorted,
+ * gap-free array of extents. Virtual image headers / footers and blocks present
+ * in the cache file are always reported as data. Everything else is described
+ * by the morphed image's allocation map. The range ends at the next boundary
+ * between those, or after EXTENT_QUERY_SIZE bytes, so callers have to call
+ * this function again for the offset following the last returned extent to
+ * continue. The returned array must be freed using free().
+ *
+ * \param offset Offset to start at
+ * \param pp_extents Pointer to store extent array to
+ * \param p_extents_count Pointer to store amount of extents to
+ * \return TRUE on success, negated error code on error
+ */
+static int GetVirtImageExtents(uint64_t offset,
+                               pts_LibXmountExtent *pp_extents,
+                               uint64_t *p_extents_count)
+{
+  uint64_t morphed_image_size, virt_image_size;
+  uint64_t file_off=offset;
+  uint64_t morphed_off=0;
+  uint64_t length;
+  uint64_t block_end;
+  uint32_t assigned;
+  int ret;
+
+  *pp_extents=NULL;
+  *p_extents_count=0;
+
+  // Get virtual and morphed image size
+  if(GetVirtImageSize(&virt_image_size)!=TRUE) {
+    LOG_ERROR("Couldn't get size of virtual image!\n")
+    return -EIO;
+  }
+  if(offset>=virt_image_size) return -ENXIO;
+  if(GetMorphedImageSize(&morphed_image_size)!=TRUE) {
+    LOG_ERROR("Couldn't get morphed image size!")
+    return -EIO;
+  }
+
+  // Handle virtual image type specific data
+  switch(glob_xmount.output.VirtImageType) {
+    case VirtImageType_DD:
+    case VirtImageType_DMG:
+    case VirtImageType_VMDK:
+    case VirtImageType_VMDKS:
+      break;
+    case VirtImageType_VDI:
+      if(file_off<glob_xmount.output.vdi.vdi_header_size) {
+        if(AddExtent(pp_extents,
+                     p_extents_count,
+                     offset,
+                     glob_xmount.output.vdi.vdi_header_size-file_off,
+                     LibXmountExtentType_Data)!=0)
+        {
+          return -ENOMEM;
+        }
+        return TRUE;
+      }
+      file_off-=glob_xmount.output.vdi.vdi_header_size;
+      morphed_off=glob_xmount.output.vdi.vdi_header_size;
+      break;
+    case VirtImageType_VHD:
+      if(file_off>=morphed_image_size) {
+        if(AddExtent(pp_extents,
+                     p_extents_count,
+                     offset,
+                     virt_image_size-file_off,
+                     LibXmountExtentType_Data)!=0)
+        {
+          return -ENOMEM;
+        }
+        return TRUE;
+      }
+      break;
+  }
+
+  // Limit range to describe. When a cache file is used, blocks written to it
+  // are data. The range is limited to the run of blocks that all are or all
+  // aren't in the cache file, and only the latter are looked up in the morphed
+  // image.
+  length=morphed_image_size-file_off;
+  if(length>EXTENT_QUERY_SIZE) length=EXTENT_QUERY_SIZE;
+  if(glob_xmount.cache.h_cache_file!=NULL) {
+    assigned=
+      glob_xmount.cache.p_cache_blkidx[file_off/CACHE_BLOCK_SIZE].Assigned;
+    block_end=(file_off/CACHE_BLOCK_SIZE+1)*CACHE_BLOCK_SIZE;
+    while(block_end<file_off+length &&
+          glob_xmount.cache.p_cache_blkidx[block_end/CACHE_BLOCK_SIZE].
+            Assigned==assigned)
+    {
+      block_end+=CACHE_BLOCK_SIZE;
+    }
+    if(block_end<file_off+length) length=block_end-file_off;
+    if(assigned==TRUE) {
+      if(AddExtent(pp_extents,
+                   p_extents_count,
+                   offset,
+                   length,
+                   LibXmountExtentType_Data)!=0)
+      {
+        return -ENOMEM;
+      }
+      return TRUE;
+    }
+  }
+
+  // Get allocation map of morphed image and move it to where the morphed image
+  // lies in the virtual image
+  ret=GetMorphedImageExtents(file_off,length,pp_extents,p_extents_count);
+  if(ret!=0) return ret;
+  if(*p_extents_count==0) {
+    LOG_ERROR("Got no extents for offset %" PRIu64 " of morphed image!\n",
+              file_off);
+    return -EIO;
+  }
+  for(uint64_t i=0;i<*p_extents_count;i++) {
+    (*pp_extents)[i].offset+=morphed_off;
+  }
+
+  return TRUE;
+}
+
 //! Write data to virtual VDI file header
 /*!
  * \param p_buf Buffer containing data to write
@@ -2154,6 +2483,117 @@ static int InitVirtImageInfoFile() {
   return TRUE;
 }
 
+//! Append a "key : value" line to the virtual image stats file
+/*!
+ * \param p_key Name of counter
+ * \param value Value of counter
+ */
+static void AppendVirtImageStatsLine(const char *p_key, uint64_t value) {
+  char buf[256];
+
+  snprintf(buf,sizeof(buf),"%-40s : %" PRIu64 "\n",p_key,value);
+  XMOUNT_STRAPP(glob_xmount.output.p_stats_file,buf);
+}
+
+//! Create / update virtual image stats file
+/*!
+ * Unlike the info file, the stats file is regenerated every time it is opened
+ * as it contains xmount's read counters as well as the counters supplied by
+ * the input and morphing libs. Comparing the bytes delivered by a layer with
+ * the bytes read from the layer below shows its read amplification.
+ *
+ * Must be called with glob_xmount.mutex_image_rw locked!
+ *
+ * \return TRUE on success, FALSE on error
+ */
+static int UpdateVirtImageStatsFile() {
+  pts_LibXmountStat p_stats;
+  uint32_t stats_count;
+  pts_InputImage p_image;
+  int ret;
+
+  // Start with counters maintained by xmount itself
+  if(glob_xmount.output.p_stats_file!=NULL) {
+    free(glob_xmount.output.p_stats_file);
+    glob_xmount.output.p_stats_file=NULL;
+  }
+  XMOUNT_STRSET(glob_xmount.output.p_stats_file,IMAGE_STATS_XMOUNT_HEADER);
+  AppendVirtImageStatsLine("Virtual image read requests",
+                           glob_xmount.output.stats.reads);
+  AppendVirtImageStatsLine("Virtual image bytes read",
+                           glob_xmount.output.stats.bytes_read);
+  AppendVirtImageStatsLine("Cache file read requests",
+                           glob_xmount.output.cache_stats.reads);
+  AppendVirtImageStatsLine("Cache file bytes read",
+                           glob_xmount.output.cache_stats.bytes_read);
+  AppendVirtImageStatsLine("Morphed image read requests",
+                           glob_xmount.morphing.stats.reads);
+  AppendVirtImageStatsLine("Morphed image bytes read",
+                           glob_xmount.morphing.stats.bytes_read);
+  for(uint64_t i=0;i<glob_xmount.input.images_count;i++) {
+    p_image=glob_xmount.input.pp_images[i];
+    XMOUNT_STRAPP(glob_xmount.output.p_stats_file,"\n--> ");
+    XMOUNT_STRAPP(glob_xmount.output.p_stats_file,p_image->pp_files[0]);
+    XMOUNT_STRAPP(glob_xmount.output.p_stats_file," <--\n");
+    AppendVirtImageStatsLine("Input image read requests",p_image->stats.reads);
+    AppendVirtImageStatsLine("Input image bytes read",
+                             p_image->stats.bytes_read);
+  }
+
+  // Add static input header
+  XMOUNT_STRAPP(glob_xmount.output.p_stats_file,"\n");
+  XMOUNT_STRAPP(glob_xmount.output.p_stats_file,IMAGE_INFO_INPUT_HEADER);
+
+  // Get and add counters from input lib(s)
+  for(uint64_t i=0;i<glob_xmount.input.images_count;i++) {
+    p_image=glob_xmount.input.pp_images[i];
+    XMOUNT_STRAPP(glob_xmount.output.p_stats_file,"\n--> ");
+    XMOUNT_STRAPP(glob_xmount.output.p_stats_file,p_image->pp_files[0]);
+    XMOUNT_STRAPP(glob_xmount.output.p_stats_file," <--\n");
+    p_stats=NULL;
+    stats_count=0;
+    if(p_image->p_functions->GetStats!=NULL) {
+      ret=p_image->p_functions->GetStats(p_image->p_handle,
+                                         &p_stats,
+                                         &stats_count);
+      if(ret!=0) {
+        LOG_ERROR("Unable to get statistics for image '%s': %s!\n",
+                  p_image->pp_files[0],
+                  p_image->p_functions->GetErrorMessage(ret));
+        return FALSE;
+      }
+    }
+    for(uint32_t ii=0;ii<stats_count;ii++) {
+      AppendVirtImageStatsLine(p_stats[ii].p_key,p_stats[ii].value);
+    }
+    if(stats_count==0) XMOUNT_STRAPP(glob_xmount.output.p_stats_file,"None\n");
+    if(p_stats!=NULL) p_image->p_functions->FreeBuffer(p_stats);
+  }
+
+  // Add static morphing header
+  XMOUNT_STRAPP(glob_xmount.output.p_stats_file,IMAGE_INFO_MORPHING_HEADER);
+
+  // Get and add counters from morphing lib
+  p_stats=NULL;
+  stats_count=0;
+  if(glob_xmount.morphing.p_functions->GetStats!=NULL) {
+    ret=glob_xmount.morphing.p_functions->
+          GetStats(glob_xmount.morphing.p_handle,&p_stats,&stats_count);
+    if(ret!=0) {
+      LOG_ERROR("Unable to get statistics from morphing lib: %s!\n",
+                glob_xmount.morphing.p_functions->GetErrorMessage(ret));
+      return FALSE;
+    }
+  }
+  for(uint32_t i=0;i<stats_count;i++) {
+    AppendVirtImageStatsLine(p_stats[i].p_key,p_stats[i].value);
+  }
+  if(stats_count==0) XMOUNT_STRAPP(glob_xmount.output.p_stats_file,"None\n");
+  if(p_stats!=NULL) glob_xmount.morphing.p_functions->FreeBuffer(p_stats);
+
+  return TRUE;
+}
+
 //! Create / load cache file to enable virtual write support
 /*!
  * \return TRUE on success, FALSE on error
@@ -2669,6 +3109,10 @@ static void InitResources() {
     &LibXmount_Morphing_ImageCount;
   glob_xmount.morphing.input_image_functions.Size=&LibXmount_Morphing_Size;
   glob_xmount.morphing.input_image_functions.Read=&LibXmount_Morphing_Read;
+  glob_xmount.morphing.input_image_functions.GetExtents=
+    &LibXmount_Morphing_GetExtents;
+  glob_xmount.morphing.stats.reads=0;
+  glob_xmount.morphing.stats.bytes_read=0;
 
   // Cache
   glob_xmount.cache.p_cache_file=NULL;
@@ -2688,6 +3132,12 @@ static void InitResources() {
   glob_xmount.output.p_virtual_image_path=NULL;
   glob_xmount.output.p_info_path=NULL;
   glob_xmount.output.p_info_file=NULL;
+  glob_xmount.output.p_stats_path=NULL;
+  glob_xmount.output.p_stats_file=NULL;
+  glob_xmount.output.stats.reads=0;
+  glob_xmount.output.stats.bytes_read=0;
+  glob_xmount.output.cache_stats.reads=0;
+  glob_xmount.output.cache_stats.bytes_read=0;
   glob_xmount.output.vdi.vdi_header_size=0;
   glob_xmount.output.vdi.p_vdi_header=NULL;
   glob_xmount.output.vdi.vdi_block_map_size=0;
@@ -2705,6 +3155,7 @@ static void InitResources() {
   // Misc data
   glob_xmount.debug=FALSE;
   glob_xmount.may_set_fuse_allow_other=FALSE;
+  glob_xmount.concurrent_image_reads=FALSE;
   glob_xmount.fuse_argc=0;
   glob_xmount.pp_fuse_argv=NULL;
   glob_xmount.p_mountpoint=NULL;
@@ -2742,6 +3193,10 @@ static void FreeResources() {
     free(glob_xmount.output.p_info_path);
   if(glob_xmount.output.p_info_file!=NULL)
     free(glob_xmount.output.p_info_file);
+  if(glob_xmount.output.p_stats_path!=NULL)
+    free(glob_xmount.output.p_stats_path);
+  if(glob_xmount.output.p_stats_file!=NULL)
+    free(glob_xmount.output.p_stats_file);
   if(glob_xmount.output.vhd.p_vhd_header!=NULL)
     free(glob_xmount.output.vhd.p_vhd_header);
   if(glob_xmount.output.vdi.p_vdi_header!=NULL)
@@ -2998,6 +3453,29 @@ static int LibXmount_Morphing_Read(uint64_t image,
                            p_read);
 }
 
+//! Function to get the allocation map of a range of an input image
+/*!
+ * \param image Image number
+ * \param offset Position of the range to describe
+ * \param count Length of the range to describe
+ * \param pp_extents Pointer to store extent array to
+ * \param p_extents_count Pointer to store amount of extents to
+ * \return 0 on success or negated error code on error
+ */
+static int LibXmount_Morphing_GetExtents(uint64_t image,
+                                         uint64_t offset,
+                                         uint64_t count,
+                                         pts_LibXmountExtent *pp_extents,
+                                         uint64_t *p_extents_count)
+{
+  if(image>=glob_xmount.input.images_count) return -EIO;
+  return GetInputImageExtents(glob_xmount.input.pp_images[image],
+                              offset,
+                              count,
+                              pp_extents,
+                              p_extents_count);
+}
+
 /*******************************************************************************
  * FUSE function implementation
  ******************************************************************************/
@@ -3064,6 +3542,17 @@ static int FuseGetAttr(const char *p_path, struct stat *p_stat)
     if(glob_xmount.output.p_info_file!=NULL) {
       p_stat->st_size=strlen(glob_xmount.output.p_info_file);
     } else p_stat->st_size=0;
+  } else if(strcmp(p_path,glob_xmount.output.p_stats_path)==0) {
+    // Attributes of virtual image stats file
+    p_stat->st_mode=S_IFREG | 0444;
+    p_stat->st_nlink=1;
+    // The stats file is regenerated on open, so this is only the size it had
+    // when it was opened the last time. Reads are done using direct_io.
+    pthread_mutex_lock(&(glob_xmount.mutex_image_rw));
+    if(glob_xmount.output.p_stats_file!=NULL) {
+      p_stat->st_size=strlen(glob_xmount.output.p_stats_file);
+    } else p_stat->st_size=0;
+    pthread_mutex_unlock(&(glob_xmount.mutex_image_rw));
   } else if(glob_xmount.output.VirtImageType==VirtImageType_VMDK ||
             glob_xmount.output.VirtImageType==VirtImageType_VMDKS)
   {
@@ -3201,6 +3690,7 @@ static int FuseReadDir(const char *p_path,
     // Add our virtual files (p+1 to ignore starting "/")
     filler(p_buf,glob_xmount.output.p_virtual_image_path+1,NULL,0,0);
     filler(p_buf,glob_xmount.output.p_info_path+1,NULL,0,0);
+    filler(p_buf,glob_xmount.output.p_stats_path+1,NULL,0,0);
     if(glob_xmount.output.VirtImageType==VirtImageType_VMDK ||
        glob_xmount.output.VirtImageType==VirtImageType_VMDKS)
     {
@@ -3255,6 +3745,7 @@ static int FuseReadDir(const char *p_path,
     // Add our virtual files (p+1 to ignore starting "/")
     filler(p_buf,glob_xmount.output.p_virtual_image_path+1,NULL,0);
     filler(p_buf,glob_xmount.output.p_info_path+1,NULL,0);
+    filler(p_buf,glob_xmount.output.p_stats_path+1,NULL,0);
     if(glob_xmount.output.VirtImageType==VirtImageType_VMDK ||
        glob_xmount.output.VirtImageType==VirtImageType_VMDKS)
     {
@@ -3300,6 +3791,7 @@ static int FuseReadDir(const char *p_path,
  * \return 0 on success, negated error code on error
  */
 static int FuseOpen(const char *p_path, struct fuse_file_info *p_fi) {
+  int ret;
 
 #define CHECK_OPEN_PERMS() {                                              \
   if(!glob_xmount.output.writable && (p_fi->flags & 3)!=O_RDONLY) {       \
@@ -3314,6 +3806,20 @@ static int FuseOpen(const char *p_path, struct fuse_file_info *p_fi) {
      strcmp(p_path,glob_xmount.output.p_info_path)==0)
   {
     CHECK_OPEN_PERMS();
+  } else if(strcmp(p_path,glob_xmount.output.p_stats_path)==0) {
+    if((p_fi->flags & 3)!=O_RDONLY) {
+      LOG_DEBUG("Attempt to open the read-only file \"%s\" for writing.\n",
+                p_path)
+      return -EACCES;
+    }
+    // Regenerate stats file to reflect current counters. As its size changes,
+    // the kernel must not cache its content.
+    pthread_mutex_lock(&(glob_xmount.mutex_image_rw));
+    ret=UpdateVirtImageStatsFile();
+    pthread_mutex_unlock(&(glob_xmount.mutex_image_rw));
+    if(ret!=TRUE) return -EIO;
+    p_fi->direct_io=1;
+    return 0;
   } else if(glob_xmount.output.VirtImageType==VirtImageType_VMDK ||
             glob_xmount.output.VirtImageType==VirtImageType_VMDKS)
   {
@@ -3373,20 +3879,38 @@ static int FuseRead(const char *p_path,
 
   if(strcmp(p_path,glob_xmount.output.p_virtual_image_path)==0) {
     // Read data from virtual output file
-    // Wait for other threads to end reading/writing data
-    pthread_mutex_lock(&(glob_xmount.mutex_image_rw));
+    // Wait for other threads to end reading/writing data (Not needed if all
+    // libs are reentrant and no cache file is used)
+    if(!glob_xmount.concurrent_image_reads) {
+      pthread_mutex_lock(&(glob_xmount.mutex_image_rw));
+    }
     // Get requested data
     if((ret=GetVirtImageData(p_buf,offset,size))<0) {
       LOG_ERROR("Couldn't read data from virtual image file!\n")
     }
     // Allow other threads to read/write data again
-    pthread_mutex_unlock(&(glob_xmount.mutex_image_rw));
+    if(!glob_xmount.concurrent_image_reads) {
+      pthread_mutex_unlock(&(glob_xmount.mutex_image_rw));
+    }
   } else if(strcmp(p_path,glob_xmount.output.p_info_path)==0) {
     // Read data from virtual info file
     READ_MEM_FILE(glob_xmount.output.p_info_file,
                   strlen(glob_xmount.output.p_info_file),
                   "info",
                   glob_xmount.mutex_info_read);
+  } else if(strcmp(p_path,glob_xmount.output.p_stats_path)==0) {
+    // Read data from virtual stats file. As it is regenerated on open, its
+    // length must be determined while holding the lock.
+    pthread_mutex_lock(&(glob_xmount.mutex_image_rw));
+    if(glob_xmount.output.p_stats_file!=NULL) {
+      len=strlen(glob_xmount.output.p_stats_file);
+    } else len=0;
+    if(offset<len) {
+      if(offset+size>len) size=len-offset;
+      memcpy(p_buf,glob_xmount.output.p_stats_file+offset,size);
+      ret=size;
+    } else ret=0;
+    pthread_mutex_unlock(&(glob_xmount.mutex_image_rw));
   } else if(strcmp(p_path,glob_xmount.output.vmdk.p_virtual_vmdk_path)==0) {
     // Read data from virtual vmdk file
     READ_MEM_FILE(glob_xmount.output.vmdk.p_vmdk_file,
@@ -3413,6 +3937,110 @@ static int FuseRead(const char *p_path,
   return ret;
 }
 
+#ifdef HAVE_FUSE_LSEEK
+//! FUSE lseek implementation
+/*!
+ * Only SEEK_DATA and SEEK_HOLE are passed to us by FUSE. Holes of the virtual
+ * image are determined using the allocation maps of the input and morphing
+ * libs. All other files are considered to be fully allocated.
+ *
+ * \param p_path Path (relative to mount folder) of file to seek in
+ * \param offset Offset to start searching at
+ * \param whence SEEK_DATA or SEEK_HOLE
+ * \param p_fi: File info struct
+ * \return Found offset on success, negated error code on error
+ */
+static off_t FuseLseek(const char *p_path,
+                       off_t offset,
+                       int whence,
+                       struct fuse_file_info *p_fi)
+{
+  (void)p_fi;
+
+  struct stat file_stat;
+  uint64_t virt_image_size;
+  pts_LibXmountExtent p_extents;
+  uint64_t extents_count;
+  uint64_t next_offset;
+  int found;
+  int ret_ext;
+  off_t ret;
+
+  if(whence!=SEEK_DATA && whence!=SEEK_HOLE) return -EINVAL;
+  if(offset<0) return -ENXIO;
+
+  if(strcmp(p_path,glob_xmount.output.p_virtual_image_path)!=0) {
+    // Info and VMDK files are kept in memory and have no holes
+    ret=FuseGetAttr(p_path,&file_stat,NULL);
+    if(ret!=0) return ret;
+    if(offset>=file_stat.st_size) return -ENXIO;
+    if(whence==SEEK_DATA) return offset;
+    return file_stat.st_size;
+  }
+
+  if(GetVirtImageSize(&virt_image_size)!=TRUE) {
+    LOG_ERROR("Couldn't get size of virtual image!\n")
+    return -EIO;
+  }
+  if((uint64_t)offset>=virt_image_size) return -ENXIO;
+
+  LOG_DEBUG("Searching for %s starting at offset %" PRIu64
+              " of virtual image\n",
+            whence==SEEK_DATA ? "data" : "hole",
+            offset);
+
+  // Walk extents until one of the requested type is found. There always is an
+  // implicit hole at EOF.
+  ret=(whence==SEEK_DATA) ? -ENXIO : (off_t)virt_image_size;
+  found=FALSE;
+  while(!found && (uint64_t)offset<virt_image_size) {
+    // A single seek may need many queries, so only hold the lock while one of
+    // them is done to not block readers and writers for the whole walk (Not
+    // needed if all libs are reentrant and no cache file is used).
+    if(!glob_xmount.concurrent_image_reads) {
+      pthread_mutex_lock(&(glob_xmount.mutex_image_rw));
+    }
+    ret_ext=GetVirtImageExtents(offset,&p_extents,&extents_count);
+    if(!glob_xmount.concurrent_image_reads) {
+      pthread_mutex_unlock(&(glob_xmount.mutex_image_rw));
+    }
+    if(ret_ext!=TRUE) {
+      LOG_ERROR("Couldn't get extents at offset %" PRIu64
+                  " of virtual image!\n",
+                offset)
+      free(p_extents);
+      ret=-EIO;
+      break;
+    }
+
+    // Look at all returned extents before asking for more
+    for(uint64_t i=0;i<extents_count;i++) {
+      if((whence==SEEK_DATA && p_extents[i].type==LibXmountExtentType_Data) ||
+         (whence==SEEK_HOLE && p_extents[i].type==LibXmountExtentType_Zero))
+      {
+        ret=(p_extents[i].offset>(uint64_t)offset) ?
+              (off_t)p_extents[i].offset : offset;
+        found=TRUE;
+        break;
+      }
+    }
+    next_offset=p_extents[extents_count-1].offset+
+                  p_extents[extents_count-1].length;
+    free(p_extents);
+    if(!found && next_offset<=(uint64_t)offset) {
+      LOG_ERROR("Extents at offset %" PRIu64 " of virtual image don't "
+                  "advance!\n",
+                offset)
+      ret=-EIO;
+      break;
+    }
+    offset=next_offset;
+  }
+
+  return ret;
+}
+#endif
+
 //! FUSE rename implementation
 /*!
  * \param p_path File to rename
@@ -3620,6 +4248,10 @@ static int FuseWrite(const char *p_path,
     // Attempt to write data to read only image info file
     LOG_DEBUG("Attempt to write data to virtual info file\n");
     return -ENOENT;
+  } else if(strcmp(p_path,glob_xmount.output.p_stats_path)==0) {
+    // Attempt to write data to read only image stats file
+    LOG_DEBUG("Attempt to write data to virtual stats file\n");
+    return -ENOENT;
   } else {
     // Attempt to write to non existant file
     LOG_DEBUG("Attempt to write to the non existant file \"%s\"\n",p_path)
@@ -3642,6 +4274,9 @@ int main(int argc, char *argv[]) {
   struct fuse_operations xmount_operations = {
     //.access=FuseAccess,
     .getattr=FuseGetAttr,
+#ifdef HAVE_FUSE_LSEEK
+    .lseek=FuseLseek,
+#endif
     .mkdir=FuseMkDir,
     .mknod=FuseMkNod,
     .open=FuseOpen,
@@ -4007,6 +4642,24 @@ int main(int argc, char *argv[]) {
     LOG_DEBUG("Cache file initialized successfully\n")
   }
 
+  // Virtual image reads only need to be serialized if a cache file is used or
+  // any of the used libs isn't reentrant
+  glob_xmount.concurrent_image_reads=
+    (glob_xmount.cache.h_cache_file==NULL &&
+     glob_xmount.morphing.p_functions->IsReentrant!=NULL &&
+     glob_xmount.morphing.p_functions->
+       IsReentrant(glob_xmount.morphing.p_handle)==1);
+  for(uint64_t i=0;i<glob_xmount.input.images_count;i++) {
+    if(glob_xmount.input.pp_images[i]->p_functions->IsReentrant==NULL ||
+       glob_xmount.input.pp_images[i]->p_functions->
+         IsReentrant(glob_xmount.input.pp_images[i]->p_handle)!=1)
+    {
+      glob_xmount.concurrent_image_reads=FALSE;
+    }
+  }
+  LOG_DEBUG("Concurrent virtual image reads are %s\n",
+            glob_xmount.concurrent_image_reads ? "enabled" : "disabled")
+
   // Call fuse_main to do the fuse magic
   fuse_ret=fuse_main(glob_xmount.fuse_argc,
                      glob_xmount.pp_fuse_argv,
@@ -35,6 +35,8 @@
 #define IMAGE_INFO_MORPHING_HEADER \
   "\n------> The following values are supplied by the used morphing library " \
     "<------\n\n"
+#define IMAGE_STATS_XMOUNT_HEADER \
+  "------> The following values are counted by xmount <------\n\n"
 
 /*******************************************************************************
  * Structures of output images
@@ -194,6 +196,9 @@ typedef struct s_CacheFileBlockIndex {
 } __attribute__ ((packed)) ts_CacheFileBlockIndex, *pts_CacheFileBlockIndex;
 
 #define CACHE_BLOCK_SIZE (1024*1024) // 1 megabyte
+#define EXTENT_QUERY_SIZE (1024*1024*1024) // Max. amount of data to query
+                                           // allocation maps for at once
+                                           // (1 gigabyte)
 #ifdef __LP64__
   #define CACHE_FILE_SIGNATURE 0xFFFF746E756F6D78 // "xmount\xFF\xFF"
 #else
@@ -266,6 +271,14 @@ typedef enum e_VirtImageType {
   VirtImageType_VHD
 } te_VirtImageType;
 
+//! Read counters kept by xmount for every layer
+typedef struct s_ReadStats {
+  //! Amount of read requests
+  uint64_t reads;
+  //! Amount of bytes delivered
+  uint64_t bytes_read;
+} ts_ReadStats;
+
 //! Structure containing infos about input libs
 typedef struct s_InputLib {
   //! Filename of lib (without path)
@@ -292,6 +305,8 @@ typedef struct s_InputImage {
   void *p_handle;
   //! Image size
   uint64_t size;
+  //! Data read from this image by xmount
+  ts_ReadStats stats;
 } ts_InputImage, *pts_InputImage;
 
 typedef struct s_InputData {
@@ -347,6 +362,8 @@ typedef struct s_MorphingData {
   pts_LibXmountMorphingFunctions p_functions;
   //! Input image functions passed to morphing lib
   ts_LibXmountMorphingInputFunctions input_image_functions;
+  //! Data read from morphed image by xmount
+  ts_ReadStats stats;
 } ts_MorphingData;
 
 //! Structures and vars needed for write access
@@ -415,6 +432,14 @@ typedef struct s_OutputData {
   char *p_info_path;
   //! Pointer to virtual info file
   char *p_info_file;
+  //! Path of virtual image stats file
+  char *p_stats_path;
+  //! Pointer to virtual stats file (Regenerated every time it is opened)
+  char *p_stats_file;
+  //! Data read from virtual image
+  ts_ReadStats stats;
+  //! Data read from cache file instead of morphed image
+  ts_ReadStats cache_stats;
   //! VDI related data
   ts_OutputImageVdiData vdi;
   //! VHD related data
@@ -445,6 +470,8 @@ typedef struct s_XmountData {
   char *p_mountpoint;
   //! Mutex to control concurrent read & write access on output image
   pthread_mutex_t mutex_image_rw;
+  //! Set if virtual image reads don't need to be serialized using above mutex
+  uint8_t concurrent_image_reads;
   //! Mutex to control concurrent read access on info file
   pthread_mutex_t mutex_info_read;
 } ts_XmountData;